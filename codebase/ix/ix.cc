@@ -7,6 +7,8 @@
 #include<string.h>
 
 IndexManager* IndexManager::_index_manager = 0;
+PagedFileManager* IndexManager::_pf_manager = 0;
+BufferManager* IndexManager::_buffer_manager = 0;
 
 IndexManager* IndexManager::instance()
 {
@@ -18,68 +20,62 @@ IndexManager* IndexManager::instance()
 
 IndexManager::IndexManager()
 {
+    // Index files are paged files whose pages are cached in the shared buffer pool
+    _pf_manager = PagedFileManager::instance();
+    _buffer_manager = BufferManager::instance();
 }
 
 IndexManager::~IndexManager()
 {
 }
 
-RC IndexManager::createFile(const string &fileName)
+RC IndexManager::createFile(const string &fileName, unsigned pageSize)
 {
     string ixfile = fileName;
     // If the file already exists, error
     if (fileExists(ixfile))
         return IX_FILE_EXISTS;
 
-    // Attempt to open the file for writing
-    FILE *pFile = fopen(ixfile.c_str(), "wb");
-    // Return an error if we fail
-    if (pFile == NULL)
+    // Let the paged file manager create it, return an error if we fail
+    if (_pf_manager->createFile(ixfile, pageSize))
         return IX_OPEN_FAILED;
-    
-    fclose (pFile);
+
     return SUCCESS;
 }
 
 RC IndexManager::destroyFile(const string &fileName)
 {
     string ixfile = fileName;
-    if (remove(ixfile.c_str()) != 0)
+    // Also drops the file's pages from the buffer pool
+    if (_pf_manager->destroyFile(ixfile) != SUCCESS)
         return IX_REMOVE_FAILED;
     return SUCCESS;
 }
 
-RC IndexManager::openFile(const string &fileName, IXFileHandle &ixfileHandle)
+RC IndexManager::openFile(const string &fileName, IXFileHandle &ixfileHandle, unsigned flags)
 {
-    // If this handle already has an open file, error
-    if (ixfileHandle.getfd() != NULL)
-        return IX_HANDLE_IN_USE;
-
     string ixfile = fileName;
 
     // If the file doesn't exist, error
     if (!fileExists(ixfile.c_str()))
         return PFM_FILE_DN_EXIST;
     
-    // Open the file for reading/writing in binary mode
-    FILE *pFile;
-    pFile = fopen(ixfile.c_str(), "rb+");
+    // Open the file for reading/writing through the paged file manager
+    RC rc = _pf_manager->openFile(ixfile, ixfileHandle.fileHandle, flags);
+    // If this handle already has an open file, error
+    if (rc == PFM_HANDLE_IN_USE) return IX_HANDLE_IN_USE;
     // If we fail, error
-    if (pFile == NULL) return IX_OPEN_FAILED;
-
-    ixfileHandle.setfd(pFile);
+    if (rc) return IX_OPEN_FAILED;
 
-    return SUCCESS;
+    // Index pages are written out in batches instead of one at a time
+    return ixfileHandle.fileHandle.setWritePolicy(FH_WRITE_BACK);
 
 }
 
 RC IndexManager::closeFile(IXFileHandle &ixfileHandle)
 {
-    FILE *pFile = ixfileHandle.getfd();
-    if (pFile == NULL) return 1;
-    fclose(pFile);
-    ixfileHandle.setfd(NULL);
-    return SUCCESS;
+    // Writes back the index's dirty pages if this was the last handle
+    return _pf_manager->closeFile(ixfileHandle.fileHandle);
 }
 
 RC IndexManager::insertEntry(IXFileHandle &ixfileHandle, const Attribute &attribute, const void *key, const RID &rid)
@@ -93,9 +89,10 @@ RC IndexManager::insertEntry(IXFileHandle &ixfileHandle, const Attribute &attrib
         // check attribute
         if (checkIXAttribute(attribute, ixfileHandle)) return IX_ATTR_MISMATCH;
     }
-    void * page = malloc(PAGE_SIZE);
+    unsigned pageSize = ixfileHandle.fileHandle.getPageSize();
+    void * page = malloc(pageSize);
     int targetPage = findPosition(attribute, key, page);
-    int FSSzie = getPageFreeSpaceSize(page);
+    int FSSzie = getPageFreeSpaceSize(page, pageSize);
     int attrSize = getAttrSize(attribute, key);
     if (attrSize + (int)sizeof(Entry) <= FSSzie) { // can be fit in
 
@@ -114,7 +111,8 @@ void IndexManager::initIXfile(const Attribute& attr, IXFileHandle &ixfileHandle)
     // header page format:
     // |rootPageNum(4B)|ixAttribute(variable length)|
     // assume ixAttribute can be fit in a page
-    void * page = malloc(PAGE_SIZE);
+    unsigned pageSize = ixfileHandle.fileHandle.getPageSize();
+    void * page = malloc(pageSize);
     int offset = 0;
 
     unsigned rootPageNum = 1;
@@ -134,7 +132,7 @@ void IndexManager::initIXfile(const Attribute& attr, IXFileHandle &ixfileHandle)
     memcpy((char *)page + offset, &attr.length, sizeof(AttrLength));
 
     // flush it to file
-    ixfileHandle.appendPage(page);
+    _buffer_manager->appendPage(ixfileHandle.fileHandle, page);
 
     // empty root page
     // root is a leaf at the beginning
@@ -147,17 +145,19 @@ void IndexManager::initIXfile(const Attribute& attr, IXFileHandle &ixfileHandle)
     header.N = 0;
     header.leaf = 1; // yes it's a leaf
     header.next = LEAF_END;
-    offset = PAGE_SIZE - sizeof(IX_SlotDirectoryHeader);
+    offset = pageSize - sizeof(IX_SlotDirectoryHeader);
     memcpy((char *)page + offset, &header, sizeof(IX_SlotDirectoryHeader));
-    ixfileHandle.appendPage(page);
+    _buffer_manager->appendPage(ixfileHandle.fileHandle, page);
     free(page);
 }
 
 bool IndexManager::checkIXAttribute(const Attribute& attr, IXFileHandle &ixfileHandle)
 {
     // obain the header page
-    void * page = malloc(PAGE_SIZE);
-    ixfileHandle.readPage(0, page);
+    PageHandle headerPage;
+    if (_buffer_manager->pinPage(ixfileHandle.fileHandle, 0, headerPage))
+        return false;
+    void * page = headerPage.getData();
     int offset = 4;
     int namelen;
     memcpy(&namelen, (char *)page + offset, sizeof(int));
@@ -175,16 +175,14 @@ bool IndexManager::checkIXAttribute(const Attribute& attr, IXFileHandle &ixfileH
     AttrLength length;
     memcpy(&length, (char *)page + offset, sizeof(AttrLength));
 
-    free(page);
-
     return string(name) == attr.name && type == attr.type && length == attr.length;
 }
 
-int IndexManager::getPageFreeSpaceSize(const void * page)
+int IndexManager::getPageFreeSpaceSize(const void * page, unsigned pageSize)
 {
     IX_SlotDirectoryHeader header;
-    memcpy(&header, (char *)page + PAGE_SIZE - sizeof(IX_SlotDirectoryHeader), sizeof(IX_SlotDirectoryHeader));
-    return (PAGE_SIZE - header.FS - header.N * sizeof(Entry) - sizeof(IX_SlotDirectoryHeader));
+    memcpy(&header, (char *)page + pageSize - sizeof(IX_SlotDirectoryHeader), sizeof(IX_SlotDirectoryHeader));
+    return (pageSize - header.FS - header.N * sizeof(Entry) - sizeof(IX_SlotDirectoryHeader));
 }
 
 int IndexManager::getAttrSize(const Attribute &attribute, const void *key)
@@ -211,7 +209,7 @@ int IndexManager::findPosition(const Attribute &attribute, const void *key, void
 
 RC IndexManager::deleteEntry(IXFileHandle &ixfileHandle, const Attribute &attribute, const void *key, const RID &rid)
 {
-    void * page = malloc(PAGE_SIZE);
+    void * page = malloc(ixfileHandle.fileHandle.getPageSize());
     int pageNum = findPosition(attribute, key, page);
 
     if(ixfileHandle.readPage(pageNum, page)){
@@ -303,7 +301,6 @@ IXFileHandle::IXFileHandle()
     ixReadPageCounter = 0;
     ixWritePageCounter = 0;
     ixAppendPageCounter = 0;
-    _fd = nullptr;
 }
 
 IXFileHandle::~IXFileHandle()
@@ -313,6 +310,7 @@ IXFileHandle::~IXFileHandle()
 
 RC IXFileHandle::collectCounterValues(unsigned &readPageCount, unsigned &writePageCount, unsigned &appendPageCount)
 {
+    syncCounters();
     readPageCount = ixReadPageCounter;
     writePageCount = ixWritePageCounter;
     appendPageCount = ixAppendPageCounter;
@@ -321,80 +319,44 @@ RC IXFileHandle::collectCounterValues(unsigned &readPageCount, unsigned &writePa
 
 RC IXFileHandle::readPage(PageNum pageNum, void *data)
 {
-    // If pageNum doesn't exist, error
-    if (getNumberOfPages() <= pageNum)
-        return FH_PAGE_DN_EXIST;
-
-    // Try to seek to the specified page
-    if (fseek(_fd, PAGE_SIZE * pageNum, SEEK_SET))
-        return FH_SEEK_FAILED;
+    RC rc = fileHandle.readPage(pageNum, data);
+    syncCounters();
+    return rc;
+}
 
-    // Try to read the specified page
-    if (fread(data, 1, PAGE_SIZE, _fd) != PAGE_SIZE)
-        return FH_READ_FAILED;
 
-    ixReadPageCounter++;
-    return SUCCESS;
+RC IXFileHandle::borrowPage(PageNum pageNum, const void *&data)
+{
+    RC rc = fileHandle.borrowPage(pageNum, data);
+    syncCounters();
+    return rc;
 }
 
 
 RC IXFileHandle::writePage(PageNum pageNum, const void *data)
 {
-    // Check if the page exists
-    if (getNumberOfPages() <= pageNum)
-        return FH_PAGE_DN_EXIST;
-
-    // Seek to the start of the page
-    if (fseek(_fd, PAGE_SIZE * pageNum, SEEK_SET))
-        return FH_SEEK_FAILED;
-
-    // Write the page
-    if (fwrite(data, 1, PAGE_SIZE, _fd) == PAGE_SIZE)
-    {
-        // Immediately commit changes to disk
-        fflush(_fd);
-        ixWritePageCounter++;
-        return SUCCESS;
-    }
-    
-    return FH_WRITE_FAILED;
+    RC rc = fileHandle.writePage(pageNum, data);
+    syncCounters();
+    return rc;
 }
 
 
 RC IXFileHandle::appendPage(const void *data)
 {
-    // Seek to the end of the file
-    if (fseek(_fd, 0, SEEK_END))
-        return FH_SEEK_FAILED;
-
-    // Write the new page
-    if (fwrite(data, 1, PAGE_SIZE, _fd) == PAGE_SIZE)
-    {
-        fflush(_fd);
-        ixAppendPageCounter++;
-        return SUCCESS;
-    }
-    return FH_WRITE_FAILED;
+    RC rc = fileHandle.appendPage(data);
+    syncCounters();
+    return rc;
 }
 
 
-unsigned IXFileHandle::getNumberOfPages() // +4 doesn't change anything
-{
-    // Use stat to get the file size
-    struct stat sb;
-    if (fstat(fileno(_fd), &sb) != 0)
-        // On error, return 0
-        return 0;
-    // Filesize is always PAGE_SIZE * number of pages
-    return sb.st_size / PAGE_SIZE;
-}
-
-void IXFileHandle::setfd(FILE *fd)
+unsigned IXFileHandle::getNumberOfPages()
 {
-    _fd = fd;
+    return fileHandle.getNumberOfPages();
 }
 
-FILE *IXFileHandle::getfd()
+// The underlying FileHandle only counts real disk I/O, including pages
+// the buffer pool read or wrote back on our behalf
+void IXFileHandle::syncCounters()
 {
-    return _fd;
+    fileHandle.collectCounterValues(ixReadPageCounter, ixWritePageCounter, ixAppendPageCounter);
 }
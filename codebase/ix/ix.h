@@ -23,8 +23,8 @@
 
 typedef struct
 {
-    uint16_t FS; // free space pointer
-    uint16_t N; // number of k-v pairs
+    uint32_t FS; // free space pointer, pages can be up to PFM_MAX_PAGE_SIZE bytes
+    uint32_t N; // number of k-v pairs
     uint8_t leaf; // is this page a leaf page? 0 = no
     int32_t next; // if it's a leaf page, what's the next leaf?
 } IX_SlotDirectoryHeader;
@@ -46,13 +46,13 @@ class IndexManager {
         static IndexManager* instance();
 
         // Create an index file.
-        RC createFile(const string &fileName);
+        RC createFile(const string &fileName, unsigned pageSize = PAGE_SIZE);
 
         // Delete an index file.
         RC destroyFile(const string &fileName);
 
-        // Open an index and return an ixfileHandle.
-        RC openFile(const string &fileName, IXFileHandle &ixfileHandle);
+        // Open an index and return an ixfileHandle. Takes the PagedFileManager::openFile flags.
+        RC openFile(const string &fileName, IXFileHandle &ixfileHandle, unsigned flags = PFM_OPEN_DEFAULT);
 
         // Close an ixfileHandle for an index.
         RC closeFile(IXFileHandle &ixfileHandle);
@@ -81,12 +81,14 @@ class IndexManager {
 
     private:
         static IndexManager *_index_manager;
+        static PagedFileManager *_pf_manager;
+        static BufferManager *_buffer_manager;
         // Private helper methods
         bool fileExists(const string &fileName);
         void initIXfile(const Attribute& attr, IXFileHandle &ixfileHandle);
         bool checkIXAttribute(const Attribute& attr, IXFileHandle &ixfileHandle);
         int findPosition(const Attribute &attribute, const void *key, void *page);
-        int getPageFreeSpaceSize(const void * page);
+        int getPageFreeSpaceSize(const void * page, unsigned pageSize);
         int getAttrSize(const Attribute &attribute, const void *key);
 };
 
@@ -113,15 +115,17 @@ class IXFileHandle {
     RC writePage(PageNum pageNum, const void *data);                    // Write a specific page
     RC appendPage(const void *data);                                    // Append a specific page
     unsigned getNumberOfPages();                                        // Get the number of pages in the file
+    RC borrowPage(PageNum pageNum, const void *&data);                  // Point into a PFM_OPEN_MMAP index without copying
 
 	// Put the current counter values of associated PF FileHandles into variables
 	RC collectCounterValues(unsigned &readPageCount, unsigned &writePageCount, unsigned &appendPageCount);
 
     private:
-        FILE *_fd;
+        // Index pages are cached in the buffer pool through this handle
+        FileHandle fileHandle;
+
         // Private helper methods
-        void setfd(FILE *fd);
-        FILE *getfd();
+        void syncCounters();
 
 };
 
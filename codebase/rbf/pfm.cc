@@ -1,8 +1,20 @@
+#include <algorithm>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <string>
 
+#include <cerrno>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
 
 #include "pfm.h"
 
@@ -27,25 +39,90 @@ PagedFileManager::~PagedFileManager()
 }
 
 
-RC PagedFileManager::createFile(const string &fileName)
+// Builds the identity of an open file from its device and inode numbers
+static FileId getFileId(struct stat &sb)
+{
+    FileId fileId;
+    fileId.dev = sb.st_dev;
+    fileId.ino = sb.st_ino;
+    return fileId;
+}
+
+// Page sizes are powers of two from PAGE_SIZE to PFM_MAX_PAGE_SIZE
+static bool isValidPageSize(unsigned pageSize)
+{
+    return pageSize >= PAGE_SIZE && pageSize <= PFM_MAX_PAGE_SIZE && (pageSize & (pageSize - 1)) == 0;
+}
+
+// Reads or writes the header page of a file. The page goes through an aligned
+// buffer, so this also works for files opened with PFM_OPEN_DIRECT.
+static bool transferHeader(int fd, FileHeader &header, bool write)
+{
+    void *page;
+    if (posix_memalign(&page, PAGE_SIZE, PAGE_SIZE) != 0)
+        return false;
+    memset(page, 0, PAGE_SIZE);
+    if (write)
+        memcpy(page, &header, sizeof(FileHeader));
+
+    ssize_t n;
+    do
+        n = write ? pwrite(fd, page, PAGE_SIZE, 0) : pread(fd, page, PAGE_SIZE, 0);
+    while (n < 0 && errno == EINTR);
+
+    if (!write && n == PAGE_SIZE)
+        memcpy(&header, page, sizeof(FileHeader));
+    free(page);
+    return n == PAGE_SIZE;
+}
+
+RC PagedFileManager::createFile(const string &fileName, unsigned pageSize)
 {
     // If the file already exists, error
     if (fileExists(fileName))
         return PFM_FILE_EXISTS;
 
+    if (!isValidPageSize(pageSize))
+        return PFM_BAD_PAGE_SIZE;
+
     // Attempt to open the file for writing
-    FILE *pFile = fopen(fileName.c_str(), "wb");
+    int fd = open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
     // Return an error if we fail
-    if (pFile == NULL)
+    if (fd < 0)
         return PFM_OPEN_FAILED;
 
-    fclose (pFile);
+    // The inode may have belonged to a file removed behind our back, so make
+    // sure no stale pages of it survive in the buffer pool
+    struct stat sb;
+    if (fstat(fd, &sb) == 0)
+        BufferManager::instance()->discardFile(getFileId(sb));
+
+    // A new file is just its header
+    FileHeader header;
+    header.magic = PFM_MAGIC;
+    header.numPages = 0;
+    header.extentPages = PFM_DEFAULT_EXTENT_PAGES;
+    header.pageSize = pageSize;
+    header.fillFactor = PFM_DEFAULT_FILL_FACTOR;
+    bool written = transferHeader(fd, header, true);
+
+    close(fd);
+    if (!written)
+    {
+        remove(fileName.c_str());
+        return PFM_OPEN_FAILED;
+    }
     return SUCCESS;
 }
 
 
 RC PagedFileManager::destroyFile(const string &fileName)
 {
+    // Drop the file's cached pages before its inode can be reused
+    struct stat sb;
+    if (stat(fileName.c_str(), &sb) == 0)
+        BufferManager::instance()->discardFile(getFileId(sb));
+
     // If file cannot be successfully removed, error
     if (remove(fileName.c_str()) != 0)
         return PFM_REMOVE_FAILED;
@@ -54,24 +131,69 @@ RC PagedFileManager::destroyFile(const string &fileName)
 }
 
 
-RC PagedFileManager::openFile(const string &fileName, FileHandle &fileHandle)
+RC PagedFileManager::openFile(const string &fileName, FileHandle &fileHandle, unsigned flags)
 {
     // If this handle already has an open file, error
-    if (fileHandle.getfd() != NULL)
+    if (fileHandle.getfd() >= 0)
         return PFM_HANDLE_IN_USE;
 
     // If the file doesn't exist, error
     if (!fileExists(fileName.c_str()))
         return PFM_FILE_DN_EXIST;
 
-    // Open the file for reading/writing in binary mode
-    FILE *pFile;
-    pFile = fopen(fileName.c_str(), "rb+");
+    // Open the file for reading/writing. Pages are transferred with pread/pwrite,
+    // so there is no shared file position and no stdio buffer in between.
+    bool direct = (flags & PFM_OPEN_DIRECT) != 0;
+    int fd = open(fileName.c_str(), O_RDWR | (direct ? O_DIRECT : 0));
+    // Some file systems (e.g. tmpfs) refuse O_DIRECT, fall back to buffered I/O there
+    if (fd < 0 && direct && errno == EINVAL)
+    {
+        direct = false;
+        fd = open(fileName.c_str(), O_RDWR);
+    }
     // If we fail, error
-    if (pFile == NULL)
+    if (fd < 0)
+        return PFM_OPEN_FAILED;
+
+    struct stat sb;
+    if (fstat(fd, &sb) != 0)
+    {
+        close(fd);
         return PFM_OPEN_FAILED;
+    }
+
+    // Only files we created ourselves can be opened
+    FileHeader header;
+    if (!transferHeader(fd, header, false) || header.magic != PFM_MAGIC || !isValidPageSize(header.pageSize))
+    {
+        close(fd);
+        return PFM_BAD_HEADER;
+    }
+
+    fileHandle.setfd(fd);
+    fileHandle._direct = direct;
+    fileHandle._fileId = getFileId(sb);
+    // From here on the handle keeps track of its size itself
+    fileHandle._pageSize = header.pageSize;
+    fileHandle._numPages = header.numPages;
+    fileHandle._headerPages = header.numPages;
+    fileHandle._extentPages = header.extentPages > 0 ? header.extentPages : PFM_DEFAULT_EXTENT_PAGES;
+    fileHandle._fillFactor = header.fillFactor > 0 ? header.fillFactor : PFM_DEFAULT_FILL_FACTOR;
+    off_t filePages = sb.st_size / header.pageSize;
+    fileHandle._allocatedPages = max((unsigned) max(filePages - PFM_HEADER_PAGES, (off_t) 0), header.numPages);
 
-    fileHandle.setfd(pFile);
+    // Reserve address space for the whole file up front. The file is mapped into it
+    // as it grows, so borrowed page pointers never move. Without it we simply pread.
+    if (flags & PFM_OPEN_MMAP)
+    {
+        void *map = mmap(NULL, PFM_MMAP_MAX_SIZE, PROT_NONE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (map != MAP_FAILED)
+            fileHandle._map = (char*) map;
+    }
+
+    // The buffer pool writes dirty pages back through open handles
+    BufferManager::instance()->registerHandle(fileHandle);
 
     return SUCCESS;
 }
@@ -79,18 +201,33 @@ RC PagedFileManager::openFile(const string &fileName, FileHandle &fileHandle)
 
 RC PagedFileManager::closeFile(FileHandle &fileHandle)
 {
-    FILE *pFile = fileHandle.getfd();
+    int fd = fileHandle.getfd();
 
     // If not an open file, error
-    if (pFile == NULL)
+    if (fd < 0)
         return 1;
 
-    // Flush and close the file
-    fclose(pFile);
+    // Write back cached pages if this is the last handle on the file
+    RC rc = BufferManager::instance()->unregisterHandle(fileHandle);
 
-    fileHandle.setfd(NULL);
+    // Record how many pages the file really has
+    RC headerRc = fileHandle.updateHeader();
+    if (rc == SUCCESS)
+        rc = headerRc;
 
-    return SUCCESS;
+    // Close the file
+    close(fd);
+    if (fileHandle._map != NULL)
+        munmap(fileHandle._map, PFM_MMAP_MAX_SIZE);
+
+    fileHandle.setfd(-1);
+    fileHandle._map = NULL;
+    fileHandle._mappedPages = 0;
+    fileHandle._numPages = 0;
+    fileHandle._headerPages = 0;
+    fileHandle._allocatedPages = 0;
+
+    return rc;
 }
 
 // Check if a file already exists
@@ -108,83 +245,543 @@ FileHandle::FileHandle()
     writePageCounter = 0;
     appendPageCounter = 0;
 
-    _fd = NULL;
+    _fd = -1;
+    _direct = false;
+    _pageSize = PAGE_SIZE;
+    _map = NULL;
+    _mappedPages = 0;
+    _numPages = 0;
+    _headerPages = 0;
+    _allocatedPages = 0;
+    _extentPages = PFM_DEFAULT_EXTENT_PAGES;
+    _fillFactor = PFM_DEFAULT_FILL_FACTOR;
+    _writePolicy = FH_SYNC_EVERY_WRITE;
+    _dirtyThreshold = FH_DEFAULT_DIRTY_THRESHOLD;
+    _fileId.dev = 0;
+    _fileId.ino = 0;
 }
 
 
 FileHandle::~FileHandle()
 {
+    // A handle that was never closed must not be left behind in the buffer pool
+    if (_fd >= 0)
+        BufferManager::instance()->unregisterHandle(*this);
 }
 
 
 RC FileHandle::readPage(PageNum pageNum, void *data)
+{
+    // A newer version of the page may still be sitting dirty in the buffer pool
+    RC rc = BufferManager::instance()->writeBackPage(*this, pageNum);
+    if (rc)
+        return rc;
+
+    return readPageFromDisk(pageNum, data);
+}
+
+
+RC FileHandle::readPages(const vector<PageNum> &pageNums, const vector<void *> &data)
+{
+    // Newer versions of the pages may still be sitting dirty in the buffer pool
+    for (PageNum pageNum : pageNums)
+    {
+        RC rc = BufferManager::instance()->writeBackPage(*this, pageNum);
+        if (rc)
+            return rc;
+    }
+
+    return readPagesFromDisk(pageNums, data);
+}
+
+
+RC FileHandle::writePage(PageNum pageNum, const void *data)
+{
+    if (_writePolicy == FH_WRITE_BACK)
+    {
+        // If pageNum doesn't exist, error
+        if (!pageExists(pageNum))
+            return FH_PAGE_DN_EXIST;
+        // Queued pages go out later, unless the pool has no frame to hold them
+        if (BufferManager::instance()->queuePage(*this, pageNum, data) == SUCCESS)
+            return SUCCESS;
+    }
+
+    RC rc = writePageToDisk(pageNum, data);
+    if (rc)
+        return rc;
+
+    // Keep any cached copy of the page in sync with what is on disk
+    BufferManager::instance()->refreshPage(*this, pageNum, data);
+    return SUCCESS;
+}
+
+
+RC FileHandle::readPageFromDisk(PageNum pageNum, void *data)
 {
     // If pageNum doesn't exist, error
-    if (getNumberOfPages() < pageNum)
+    if (!pageExists(pageNum))
         return FH_PAGE_DN_EXIST;
 
-    // Try to seek to the specified page
-    if (fseek(_fd, PAGE_SIZE * pageNum, SEEK_SET))
-        return FH_SEEK_FAILED;
+    // A mapped file only costs a copy, everything else is read from the file
+    if (mapPage(pageNum))
+        memcpy(data, _map + (size_t) (pageNum + PFM_HEADER_PAGES) * _pageSize, _pageSize);
+    else if (!transferPage(pageNum, data, false))
+        return FH_READ_FAILED;
+
+    // Counters may be bumped by concurrent readers of the same handle
+    __atomic_fetch_add(&readPageCounter, 1, __ATOMIC_RELAXED);
+    return SUCCESS;
+}
+
 
-    // Try to read the specified page
-    if (fread(data, 1, PAGE_SIZE, _fd) != PAGE_SIZE)
+RC FileHandle::readPagesFromDisk(const vector<PageNum> &pageNums, const vector<void *> &data)
+{
+    if (pageNums.size() != data.size())
         return FH_READ_FAILED;
 
-    readPageCounter++;
+    // A mapped file or a single page gains nothing from a batch
+    if (_map != NULL || pageNums.size() == 1)
+    {
+        for (size_t i = 0; i < pageNums.size(); i++)
+        {
+            RC rc = readPageFromDisk(pageNums[i], data[i]);
+            if (rc)
+                return rc;
+        }
+        return SUCCESS;
+    }
+
+    // If any pageNum doesn't exist, error
+    for (PageNum pageNum : pageNums)
+    {
+        if (!pageExists(pageNum))
+            return FH_PAGE_DN_EXIST;
+    }
+
+    // The page reader deals in blocks of the file, which start with the header
+    vector<PageNum> blocks;
+    for (PageNum pageNum : pageNums)
+        blocks.push_back(pageNum + PFM_HEADER_PAGES);
+    vector<char> done(pageNums.size(), 0);
+    PageReader::instance()->readPages(_fd, _pageSize, blocks, data, done);
+
+    // Whatever the batch couldn't read (e.g. unaligned buffers under O_DIRECT)
+    // is read one page at a time
+    for (size_t i = 0; i < pageNums.size(); i++)
+    {
+        if (!done[i] && !transferPage(pageNums[i], data[i], false))
+            return FH_READ_FAILED;
+    }
+
+    __atomic_fetch_add(&readPageCounter, (unsigned) pageNums.size(), __ATOMIC_RELAXED);
     return SUCCESS;
 }
 
 
-RC FileHandle::writePage(PageNum pageNum, const void *data)
+RC FileHandle::writePageToDisk(PageNum pageNum, const void *data)
 {
     // Check if the page exists
-    if (getNumberOfPages() < pageNum)
+    if (!pageExists(pageNum))
         return FH_PAGE_DN_EXIST;
 
-    // Seek to the start of the page
-    if (fseek(_fd, PAGE_SIZE * pageNum, SEEK_SET))
-        return FH_SEEK_FAILED;
+    // Write the page, it goes straight to the kernel
+    if (!transferPage(pageNum, (void*) data, true))
+        return FH_WRITE_FAILED;
+
+    __atomic_fetch_add(&writePageCounter, 1, __ATOMIC_RELAXED);
+    return SUCCESS;
+}
+
+
+RC FileHandle::appendPage(const void *data)
+{
+    // Make room for the page first, it may be written out much later
+    RC rc = allocatePage(_numPages);
+    if (rc)
+        return rc;
 
-    // Write the page
-    if (fwrite(data, 1, PAGE_SIZE, _fd) == PAGE_SIZE)
+    // A queued page only extends the file once it is written out. Until then
+    // readers find it in the buffer pool, but it already counts as a page.
+    bool queued = false;
+    if (_writePolicy == FH_WRITE_BACK)
     {
-        // Immediately commit changes to disk
-        fflush(_fd);
-        writePageCounter++;
-        return SUCCESS;
+        _numPages++;
+        queued = BufferManager::instance()->queuePage(*this, _numPages - 1, data) == SUCCESS;
+        if (!queued)
+            _numPages--;
+    }
+
+    // Otherwise write the new page right after the last one
+    if (!queued)
+    {
+        if (!transferPage(_numPages, (void*) data, true))
+            return FH_WRITE_FAILED;
+        _numPages++;
     }
-    
-    return FH_WRITE_FAILED;
+    __atomic_fetch_add(&appendPageCounter, 1, __ATOMIC_RELAXED);
+
+    // Other open handles on the file learn about the new page without a syscall
+    BufferManager::instance()->pageAppended(*this);
+    return SUCCESS;
 }
 
 
-RC FileHandle::appendPage(const void *data)
+// Appends consecutive pages with one vectored write. They never go through the
+// buffer pool, whatever the write policy.
+RC FileHandle::appendPages(const vector<void *> &data)
 {
-    // Seek to the end of the file
-    if (fseek(_fd, 0, SEEK_END))
-        return FH_SEEK_FAILED;
+    if (data.empty())
+        return SUCCESS;
+    PageNum first = _numPages;
+    RC rc = allocatePage(first + data.size() - 1);
+    if (rc)
+        return rc;
 
-    // Write the new page
-    if (fwrite(data, 1, PAGE_SIZE, _fd) == PAGE_SIZE)
+    // The pages have to count before they can be written
+    _numPages += data.size();
+    rc = writePagesToDisk(first, data);
+    if (rc)
     {
-        fflush(_fd);
-        appendPageCounter++;
+        _numPages = first;
+        return rc;
+    }
+    __atomic_fetch_add(&appendPageCounter, (unsigned) data.size(), __ATOMIC_RELAXED);
+
+    BufferManager::instance()->pageAppended(*this);
+    return SUCCESS;
+}
+
+
+RC FileHandle::borrowPage(PageNum pageNum, const void *&data)
+{
+    if (_map == NULL)
+        return FH_NOT_MAPPED;
+
+    // A newer version of the page may still be sitting dirty in the buffer pool
+    RC rc = BufferManager::instance()->writeBackPage(*this, pageNum);
+    if (rc)
+        return rc;
+
+    // If pageNum doesn't exist, error
+    if (!pageExists(pageNum))
+        return FH_PAGE_DN_EXIST;
+    if (!mapPage(pageNum))
+        return FH_NOT_MAPPED;
+
+    data = _map + (size_t) (pageNum + PFM_HEADER_PAGES) * _pageSize;
+    __atomic_fetch_add(&readPageCounter, 1, __ATOMIC_RELAXED);
+    return SUCCESS;
+}
+
+
+bool FileHandle::isMapped()
+{
+    return _map != NULL;
+}
+
+
+// Pages past the reserved address range stay unmapped, borrowPage doesn't lend those
+RC FileHandle::extendMapping()
+{
+    if (_map == NULL)
+        return FH_NOT_MAPPED;
+    if (_numPages == 0)
+        return SUCCESS;
+
+    size_t lastPage = min((size_t) _numPages, PFM_MMAP_MAX_SIZE / _pageSize - PFM_HEADER_PAGES) - 1;
+    if (!mapPage(lastPage))
+        return FH_NOT_MAPPED;
+    return SUCCESS;
+}
+
+
+RC FileHandle::readAhead(PageNum pageNum, unsigned count)
+{
+    if (_fd < 0)
+        return FH_READ_FAILED;
+
+    // The kernel reads the range into its page cache in the background
+    if (posix_fadvise(_fd, (off_t) (pageNum + PFM_HEADER_PAGES) * _pageSize, (off_t) count * _pageSize, POSIX_FADV_WILLNEED) != 0)
+        return FH_READ_FAILED;
+    return SUCCESS;
+}
+
+
+// Writes a run of consecutive pages with a single pwritev. Whatever the kernel
+// doesn't take in one go is finished a page at a time.
+RC FileHandle::writePagesToDisk(PageNum pageNum, const vector<void *> &pages)
+{
+    if (pages.empty())
         return SUCCESS;
+    // Check if the last page of the run exists
+    if (!pageExists(pageNum + pages.size() - 1))
+        return FH_PAGE_DN_EXIST;
+
+    vector<struct iovec> iov(pages.size());
+    for (size_t i = 0; i < pages.size(); i++)
+    {
+        iov[i].iov_base = pages[i];
+        iov[i].iov_len = _pageSize;
+    }
+
+    ssize_t n;
+    do
+        n = pwritev(_fd, iov.data(), iov.size(), (off_t) (pageNum + PFM_HEADER_PAGES) * _pageSize);
+    while (n < 0 && errno == EINTR);
+
+    // A torn last page is simply written again in full
+    size_t done = n > 0 ? n / _pageSize : 0;
+    for (size_t i = done; i < pages.size(); i++)
+    {
+        if (!transferPage(pageNum + i, pages[i], true))
+            return FH_WRITE_FAILED;
+    }
+
+    __atomic_fetch_add(&writePageCounter, (unsigned) pages.size(), __ATOMIC_RELAXED);
+    return SUCCESS;
+}
+
+
+// Reads or writes one whole page at its position in the file with pread/pwrite.
+// O_DIRECT transfers need an aligned buffer, so unaligned ones bounce through one.
+bool FileHandle::transferPage(PageNum pageNum, void *data, bool write)
+{
+    char *buffer = (char*) data;
+    void *bounce = NULL;
+    if (_direct && ((uintptr_t) data % PAGE_SIZE) != 0)
+    {
+        if (posix_memalign(&bounce, PAGE_SIZE, _pageSize) != 0)
+            return false;
+        if (write)
+            memcpy(bounce, data, _pageSize);
+        buffer = (char*) bounce;
     }
-    return FH_WRITE_FAILED;
+
+    off_t offset = (off_t) (pageNum + PFM_HEADER_PAGES) * _pageSize;
+    size_t done = 0;
+    while (done < _pageSize)
+    {
+        ssize_t n = write ? pwrite(_fd, buffer + done, _pageSize - done, offset + done)
+                          : pread(_fd, buffer + done, _pageSize - done, offset + done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        // A short read past the end of the file is an error, not a partial page
+        if (n <= 0)
+            break;
+        done += n;
+    }
+
+    if (bounce != NULL)
+    {
+        if (!write && done == _pageSize)
+            memcpy(data, bounce, _pageSize);
+        free(bounce);
+    }
+    return done == _pageSize;
+}
+
+
+unsigned FileHandle::getPageSize()
+{
+    return _pageSize;
 }
 
 
 unsigned FileHandle::getNumberOfPages()
 {
-    // Use stat to get the file size
+    // Kept up to date by openFile() and appendPage(), no need to ask the file system
+    return _numPages;
+}
+
+
+// Re-reads the file size, for files that were grown through handles we don't know about.
+// Open handles may not have recorded their pages in the header yet, so ask them too.
+RC FileHandle::refreshNumberOfPages()
+{
+    FileHeader header;
+    if (!transferHeader(_fd, header, false))
+        return FH_READ_FAILED;
+    _numPages = max(_numPages, header.numPages);
+    _numPages = max(_numPages, BufferManager::instance()->getOpenFileSize(_fileId));
+    return SUCCESS;
+}
+
+
+RC FileHandle::setExtentSize(unsigned numPages)
+{
+    if (_fd < 0 || numPages == 0)
+        return FH_WRITE_FAILED;
+
+    FileHeader header;
+    if (!transferHeader(_fd, header, false))
+        return FH_READ_FAILED;
+    header.numPages = max(header.numPages, _numPages);
+    header.extentPages = numPages;
+    if (!transferHeader(_fd, header, true))
+        return FH_WRITE_FAILED;
+
+    _headerPages = header.numPages;
+    _extentPages = numPages;
+    return SUCCESS;
+}
+
+
+unsigned FileHandle::getFillFactor()
+{
+    return _fillFactor;
+}
+
+
+RC FileHandle::setFillFactor(unsigned percent)
+{
+    if (_fd < 0 || percent == 0 || percent > 100)
+        return FH_WRITE_FAILED;
+
+    FileHeader header;
+    if (!transferHeader(_fd, header, false))
+        return FH_READ_FAILED;
+    header.numPages = max(header.numPages, _numPages);
+    header.fillFactor = percent;
+    if (!transferHeader(_fd, header, true))
+        return FH_WRITE_FAILED;
+
+    _headerPages = header.numPages;
+    _fillFactor = percent;
+    return SUCCESS;
+}
+
+
+// Makes sure the file has room for pageNum, growing it to the end of the extent the
+// page falls in. fallocate reserves the blocks without writing them, file systems
+// that can't do that get a sparse extent instead.
+RC FileHandle::allocatePage(PageNum pageNum)
+{
+    if (pageNum < _allocatedPages)
+        return SUCCESS;
+
+    unsigned allocated = (pageNum / _extentPages + 1) * _extentPages;
+    off_t start = (off_t) (_allocatedPages + PFM_HEADER_PAGES) * _pageSize;
+    off_t end = (off_t) (allocated + PFM_HEADER_PAGES) * _pageSize;
+    if (fallocate(_fd, 0, start, end - start) != 0)
+    {
+        // Another handle may have grown the file further already, never shrink it
+        struct stat sb;
+        if (fstat(_fd, &sb) != 0)
+            return FH_WRITE_FAILED;
+        if (sb.st_size < end && ftruncate(_fd, end) != 0)
+            return FH_WRITE_FAILED;
+    }
+
+    _allocatedPages = allocated;
+    return SUCCESS;
+}
+
+
+// Records the logical size in the header once the file has grown. Another handle
+// may have recorded a larger size already, so the header never shrinks.
+RC FileHandle::updateHeader()
+{
+    if (_numPages <= _headerPages)
+        return SUCCESS;
+
+    FileHeader header;
+    if (!transferHeader(_fd, header, false))
+        return FH_READ_FAILED;
+    if (header.numPages < _numPages)
+    {
+        header.numPages = _numPages;
+        if (!transferHeader(_fd, header, true))
+            return FH_WRITE_FAILED;
+    }
+
+    _headerPages = header.numPages;
+    return SUCCESS;
+}
+
+
+// Bounds check against the cached size. Only a page that looks out of range costs
+// an fstat, in case another handle (or a copy of this one) appended it.
+bool FileHandle::pageExists(PageNum pageNum)
+{
+    if (pageNum < _numPages)
+        return true;
+    return refreshNumberOfPages() == SUCCESS && pageNum < _numPages;
+}
+
+
+// Makes sure the mapping covers pageNum, extending it over pages the file gained
+// since. Only pages that are really on disk are mapped, touching anything past the
+// end of the file would raise SIGBUS. Writes go through pwrite, and a shared
+// mapping sees them without any further work.
+bool FileHandle::mapPage(PageNum pageNum)
+{
+    // The mapping covers the whole file, header included
+    size_t block = (size_t) pageNum + PFM_HEADER_PAGES;
+    if (block < _mappedPages)
+        return true;
+    size_t maxBlocks = PFM_MMAP_MAX_SIZE / _pageSize;
+    if (_map == NULL || block >= maxBlocks)
+        return false;
+
     struct stat sb;
-    if (fstat(fileno(_fd), &sb) != 0)
-        // On error, return 0
-        return 0;
-    // Filesize is always PAGE_SIZE * number of pages
-    return sb.st_size / PAGE_SIZE;
+    if (fstat(_fd, &sb) != 0)
+        return false;
+    unsigned onDisk = min((size_t) (sb.st_size / _pageSize), maxBlocks);
+    if (block >= onDisk)
+        return false;
+
+    // MAP_FIXED replaces just the reserved pages past what is already mapped
+    void *map = mmap(_map + (size_t) _mappedPages * _pageSize, (size_t) (onDisk - _mappedPages) * _pageSize,
+                     PROT_READ, MAP_SHARED | MAP_FIXED, _fd, (off_t) _mappedPages * _pageSize);
+    if (map == MAP_FAILED)
+        return false;
+    _mappedPages = onDisk;
+    return true;
+}
+
+
+RC FileHandle::setWritePolicy(unsigned policy, unsigned dirtyThreshold)
+{
+    if (policy != FH_SYNC_EVERY_WRITE && policy != FH_WRITE_BACK)
+        return FH_WRITE_FAILED;
+
+    // Pages queued so far must not outlive the switch to writing through
+    if (_writePolicy == FH_WRITE_BACK && policy == FH_SYNC_EVERY_WRITE && _fd >= 0)
+    {
+        RC rc = flush();
+        if (rc)
+            return rc;
+    }
+
+    _writePolicy = policy;
+    _dirtyThreshold = max(dirtyThreshold, 1u);
+    return SUCCESS;
+}
+
+
+RC FileHandle::flush()
+{
+    if (_fd < 0)
+        return PFM_FILE_NOT_OPEN;
+
+    RC rc = BufferManager::instance()->flushFile(*this);
+    if (rc)
+        return rc;
+    return updateHeader();
+}
+
+
+RC FileHandle::sync()
+{
+    RC rc = flush();
+    if (rc)
+        return rc;
+
+    // Only the data has to be durable, the file's metadata can follow lazily
+    if (fdatasync(_fd) != 0)
+        return FH_WRITE_FAILED;
+    return SUCCESS;
 }
 
 
@@ -196,12 +793,950 @@ RC FileHandle::collectCounterValues(unsigned &readPageCount, unsigned &writePage
     return SUCCESS;
 }
 
-void FileHandle::setfd(FILE *fd)
+void FileHandle::setfd(int fd)
 {
     _fd = fd;
 }
 
-FILE *FileHandle::getfd()
+int FileHandle::getfd()
 {
     return _fd;
-}
\ No newline at end of file
+}
+
+
+bool operator< (const FileId &a, const FileId &b)
+{
+    if (a.dev != b.dev)
+        return a.dev < b.dev;
+    return a.ino < b.ino;
+}
+
+bool operator== (const FileId &a, const FileId &b)
+{
+    return a.dev == b.dev && a.ino == b.ino;
+}
+
+
+PageHandle::PageHandle()
+: _frame(-1), _pageNum(0), _data(NULL), _fileHandle(NULL)
+{
+}
+
+PageHandle::~PageHandle()
+{
+    unpin();
+}
+
+void *PageHandle::getData()
+{
+    return _data;
+}
+
+PageNum PageHandle::getPageNum()
+{
+    return _pageNum;
+}
+
+RC PageHandle::markDirty()
+{
+    if (_frame < 0)
+        return SUCCESS;
+    return BufferManager::instance()->markFrameDirty(_frame, *_fileHandle);
+}
+
+void PageHandle::unpin()
+{
+    if (_frame < 0)
+        return;
+
+    BufferManager::instance()->unpinFrame(_frame);
+    _frame = -1;
+    _data = NULL;
+    _fileHandle = NULL;
+}
+
+
+BufferManager* BufferManager::_buffer_manager = NULL;
+
+BufferManager* BufferManager::instance()
+{
+    if(!_buffer_manager)
+        _buffer_manager = new BufferManager();
+
+    return _buffer_manager;
+}
+
+
+BufferManager::BufferManager()
+: _numFrames(0), _clockHand(0)
+{
+    setNumberOfFrames(BM_DEFAULT_NUM_FRAMES);
+}
+
+
+BufferManager::~BufferManager()
+{
+    freeFrames();
+}
+
+
+RC BufferManager::setNumberOfFrames(unsigned numFrames)
+{
+    lock_guard<recursive_mutex> lock(_mutex);
+    if (numFrames == 0)
+        return BM_NO_FREE_FRAME;
+
+    // Pinned frames would be left dangling by the resize
+    for (unsigned i = 0; i < _numFrames; i++)
+    {
+        if (_frames[i].pinCount > 0)
+            return BM_FRAMES_PINNED;
+    }
+
+    // Write back everything before dropping the old frames
+    for (unsigned i = 0; i < _numFrames; i++)
+    {
+        if (!_frames[i].valid || !_frames[i].dirty)
+            continue;
+        RC rc = writeBackFrame(i, NULL);
+        if (rc)
+            return rc;
+    }
+
+    freeFrames();
+    Frame empty;
+    memset(&empty, 0, sizeof(Frame));
+    _frames.assign(numFrames, empty);
+    _pageTable.clear();
+    _dirtyPages.clear();
+    _numFrames = numFrames;
+    _clockHand = 0;
+    return SUCCESS;
+}
+
+
+unsigned BufferManager::getNumberOfFrames()
+{
+    lock_guard<recursive_mutex> lock(_mutex);
+    return _numFrames;
+}
+
+
+RC BufferManager::pinPage(FileHandle &fileHandle, PageNum pageNum, PageHandle &pageHandle)
+{
+    // Release whatever page this handle was holding before
+    pageHandle.unpin();
+
+    unique_lock<recursive_mutex> lock(_mutex);
+
+    // A write-back file that queued too many pages writes them out first
+    RC rc = checkDirtyThreshold(fileHandle);
+    if (rc)
+        return rc;
+
+    PageKey key;
+    key.fileId = fileHandle._fileId;
+    key.pageNum = pageNum;
+
+    unsigned frame;
+    if (findFrame(lock, key, frame))
+    {
+        pinFrame(fileHandle, frame, pageHandle);
+        return SUCCESS;
+    }
+
+    // Miss, claim a frame and bring the page in from disk without holding the lock
+    rc = getVictimFrame(frame, fileHandle._pageSize);
+    if (rc)
+        return rc;
+    claimFrame(frame, key);
+    void *data = getFrameData(frame);
+
+    lock.unlock();
+    rc = fileHandle.readPageFromDisk(pageNum, data);
+    lock.lock();
+
+    finishLoad(frame, rc);
+    if (rc)
+        return rc;
+    pinFrame(fileHandle, frame, pageHandle);
+    return SUCCESS;
+}
+
+
+RC BufferManager::appendPage(FileHandle &fileHandle, const void *data)
+{
+    RC rc = fileHandle.appendPage(data);
+    if (rc)
+        return rc;
+
+    lock_guard<recursive_mutex> lock(_mutex);
+
+    PageKey key;
+    key.fileId = fileHandle._fileId;
+    key.pageNum = fileHandle.getNumberOfPages() - 1;
+
+    // A write-back handle already queued the page in the pool
+    if (_pageTable.find(key) != _pageTable.end())
+        return SUCCESS;
+
+    // Caching the new page is only an optimization, so a full pool is not an error
+    unsigned frame;
+    if (getVictimFrame(frame, fileHandle._pageSize) != SUCCESS)
+        return SUCCESS;
+
+    memcpy(getFrameData(frame), data, fileHandle._pageSize);
+    _frames[frame].fileId = key.fileId;
+    _frames[frame].pageNum = key.pageNum;
+    _frames[frame].valid = true;
+    _frames[frame].dirty = false;
+    _frames[frame].referenced = true;
+    _pageTable[key] = frame;
+    return SUCCESS;
+}
+
+
+RC BufferManager::flushFile(FileHandle &fileHandle)
+{
+    lock_guard<recursive_mutex> lock(_mutex);
+    return flushFileFrames(fileHandle);
+}
+
+
+// Brings in the pages that aren't cached yet with a single batch of reads. They are
+// left unpinned and unreferenced, so pages nobody asks for are the first to go.
+// Pages that don't exist are skipped, and a full pool just ends the prefetch early.
+RC BufferManager::prefetchPages(FileHandle &fileHandle, const vector<PageNum> &pageNums)
+{
+    unique_lock<recursive_mutex> lock(_mutex);
+
+    vector<PageNum> missing;
+    vector<void *> data;
+    vector<unsigned> frames;
+    for (PageNum pageNum : pageNums)
+    {
+        PageKey key;
+        key.fileId = fileHandle._fileId;
+        key.pageNum = pageNum;
+        if (_pageTable.find(key) != _pageTable.end() || !fileHandle.pageExists(pageNum))
+            continue;
+
+        unsigned frame;
+        if (getVictimFrame(frame, fileHandle._pageSize) != SUCCESS)
+            break;
+
+        // Claim the frame right away, so the batch doesn't pick it twice
+        claimFrame(frame, key);
+        missing.push_back(pageNum);
+        data.push_back(getFrameData(frame));
+        frames.push_back(frame);
+    }
+    if (missing.empty())
+        return SUCCESS;
+
+    // The batch is read without holding the lock, like a miss in pinPage()
+    lock.unlock();
+    RC rc = fileHandle.readPagesFromDisk(missing, data);
+    lock.lock();
+
+    for (unsigned frame : frames)
+        finishLoad(frame, rc);
+    return rc;
+}
+
+
+// Private helper methods ///////////////////////////////////////////////////////////////////
+
+// Writes back the dirty frames of a file, one pwritev per run of adjacent pages.
+// Callers hold _mutex.
+RC BufferManager::flushFileFrames(FileHandle &fileHandle, bool skipPinned)
+{
+    // Sort the dirty pages by page number so neighbours end up next to each other
+    vector<pair<PageNum, unsigned> > dirty;
+    for (unsigned i = 0; i < _numFrames; i++)
+    {
+        if (!_frames[i].valid || !_frames[i].dirty || !(_frames[i].fileId == fileHandle._fileId))
+            continue;
+        if (skipPinned && _frames[i].pinCount > 0)
+            continue;
+        dirty.push_back(make_pair(_frames[i].pageNum, i));
+    }
+    sort(dirty.begin(), dirty.end());
+
+    vector<unsigned> run;
+    for (size_t i = 0; i < dirty.size(); i++)
+    {
+        bool adjacent = !run.empty() && dirty[i].first == _frames[run.back()].pageNum + 1;
+        if (!run.empty() && (!adjacent || run.size() == IOV_MAX))
+        {
+            RC rc = writeBackRun(run, fileHandle);
+            if (rc)
+                return rc;
+            run.clear();
+        }
+        run.push_back(dirty[i].second);
+    }
+    return writeBackRun(run, fileHandle);
+}
+
+// Writes frames holding consecutive pages of a file in one go
+RC BufferManager::writeBackRun(const vector<unsigned> &run, FileHandle &fileHandle)
+{
+    if (run.empty())
+        return SUCCESS;
+
+    vector<void *> pages;
+    for (unsigned frame : run)
+        pages.push_back(getFrameData(frame));
+
+    RC rc = fileHandle.writePagesToDisk(_frames[run.front()].pageNum, pages);
+    if (rc)
+        return rc;
+    for (unsigned frame : run)
+        setFrameDirty(frame, false);
+    return SUCCESS;
+}
+
+// Flushes a FH_WRITE_BACK file once it has queued as many dirty pages as it
+// allows. Pinned pages may be in the middle of an update, so they stay queued.
+RC BufferManager::checkDirtyThreshold(FileHandle &fileHandle)
+{
+    if (fileHandle._writePolicy != FH_WRITE_BACK)
+        return SUCCESS;
+
+    auto it = _dirtyPages.find(fileHandle._fileId);
+    if (it == _dirtyPages.end() || it->second < fileHandle._dirtyThreshold)
+        return SUCCESS;
+    return flushFileFrames(fileHandle, true);
+}
+
+// Updates a frame's dirty bit along with its file's count of dirty pages
+void BufferManager::setFrameDirty(unsigned frame, bool dirty)
+{
+    Frame &f = _frames[frame];
+    if (f.dirty == dirty)
+        return;
+
+    f.dirty = dirty;
+    if (dirty)
+        _dirtyPages[f.fileId]++;
+    else if (--_dirtyPages[f.fileId] == 0)
+        _dirtyPages.erase(f.fileId);
+}
+
+void *BufferManager::getFrameData(unsigned frame)
+{
+    return _frames[frame].data;
+}
+
+bool BufferManager::findFrame(unique_lock<recursive_mutex> &lock, const PageKey &key, unsigned &frame)
+{
+    while (true)
+    {
+        auto it = _pageTable.find(key);
+        if (it == _pageTable.end())
+            return false;
+        frame = it->second;
+        if (!_frames[frame].loading)
+            return true;
+        // If the read fails the page is gone from the table, and the caller reads it itself
+        _frameLoaded.wait(lock);
+    }
+}
+
+// Enters a frame for a page that is about to be read in. It stays pinned while
+// loading, so it can't be picked as a victim, and is only published by finishLoad().
+void BufferManager::claimFrame(unsigned frame, const PageKey &key)
+{
+    Frame &f = _frames[frame];
+    f.fileId = key.fileId;
+    f.pageNum = key.pageNum;
+    f.valid = true;
+    f.loading = true;
+    f.dirty = false;
+    f.referenced = false;
+    f.pinCount = 1;
+    _pageTable[key] = frame;
+}
+
+// Publishes a frame once its read is over, or drops it if nothing useful was read
+void BufferManager::finishLoad(unsigned frame, RC rc)
+{
+    Frame &f = _frames[frame];
+    f.loading = false;
+    f.pinCount--;
+    if (rc)
+        evictFrame(frame);
+    _frameLoaded.notify_all();
+}
+
+void BufferManager::pinFrame(FileHandle &fileHandle, unsigned frame, PageHandle &pageHandle)
+{
+    _frames[frame].pinCount++;
+    _frames[frame].referenced = true;
+
+    pageHandle._frame = frame;
+    pageHandle._fileHandle = &fileHandle;
+    pageHandle._pageNum = _frames[frame].pageNum;
+    pageHandle._data = getFrameData(frame);
+}
+
+void BufferManager::freeFrames()
+{
+    for (unsigned i = 0; i < _numFrames; i++)
+        free(_frames[i].data);
+}
+
+// Finds a frame to load a page of pageSize bytes into, growing its buffer if
+// the page is larger than any the frame held before
+RC BufferManager::getVictimFrame(unsigned &frame, unsigned pageSize)
+{
+    RC rc = findVictimFrame(frame);
+    if (rc)
+        return rc;
+
+    // Page aligned, so frames can be transferred directly to files opened with PFM_OPEN_DIRECT
+    Frame &f = _frames[frame];
+    if (f.size < pageSize)
+    {
+        void *data;
+        if (posix_memalign(&data, PAGE_SIZE, pageSize) != 0)
+            return BM_MALLOC_FAILED;
+        free(f.data);
+        f.data = (char*) data;
+        f.size = pageSize;
+    }
+    return SUCCESS;
+}
+
+// Picks a frame using the CLOCK algorithm, writing back the previous contents
+// if they are dirty. A frame that can't be written back stays cached and the
+// sweep moves on, its error is only returned if no other frame can be used.
+RC BufferManager::findVictimFrame(unsigned &frame)
+{
+    RC writeError = SUCCESS;
+    // Two sweeps are enough to clear every reference bit once
+    for (unsigned i = 0; i < 2 * _numFrames; i++)
+    {
+        unsigned candidate = _clockHand;
+        _clockHand = (_clockHand + 1) % _numFrames;
+
+        Frame &f = _frames[candidate];
+        if (!f.valid)
+        {
+            frame = candidate;
+            return SUCCESS;
+        }
+        if (f.pinCount > 0)
+            continue;
+        if (f.referenced)
+        {
+            f.referenced = false;
+            continue;
+        }
+
+        if (f.dirty)
+        {
+            RC rc = writeBackFrame(candidate, NULL);
+            if (rc)
+            {
+                writeError = rc;
+                continue;
+            }
+        }
+        evictFrame(candidate);
+        frame = candidate;
+        return SUCCESS;
+    }
+    return writeError ? writeError : BM_NO_FREE_FRAME;
+}
+
+// Writes a dirty frame to disk, through the given handle or any open handle on its file
+RC BufferManager::writeBackFrame(unsigned frame, FileHandle *fileHandle)
+{
+    Frame &f = _frames[frame];
+    if (fileHandle == NULL)
+    {
+        auto it = _openHandles.find(f.fileId);
+        if (it == _openHandles.end() || it->second.empty())
+            return BM_NO_OPEN_HANDLE;
+        fileHandle = it->second.front();
+    }
+
+    RC rc = fileHandle->writePageToDisk(f.pageNum, getFrameData(frame));
+    if (rc)
+        return rc;
+    setFrameDirty(frame, false);
+    return SUCCESS;
+}
+
+void BufferManager::evictFrame(unsigned frame)
+{
+    PageKey key;
+    key.fileId = _frames[frame].fileId;
+    key.pageNum = _frames[frame].pageNum;
+    _pageTable.erase(key);
+
+    setFrameDirty(frame, false);
+    _frames[frame].valid = false;
+    _frames[frame].referenced = false;
+}
+
+void BufferManager::unpinFrame(unsigned frame)
+{
+    lock_guard<recursive_mutex> lock(_mutex);
+    Frame &f = _frames[frame];
+    if (f.pinCount > 0)
+        f.pinCount--;
+}
+
+// Pages changed through a FH_SYNC_EVERY_WRITE handle are written right away, through
+// that handle. If that fails they stay dirty and go out later.
+RC BufferManager::markFrameDirty(unsigned frame, FileHandle &fileHandle)
+{
+    lock_guard<recursive_mutex> lock(_mutex);
+    pageChanged(fileHandle._fileId);
+    if (!_frames[frame].valid)
+        return SUCCESS;
+    setFrameDirty(frame, true);
+    if (fileHandle._writePolicy == FH_SYNC_EVERY_WRITE)
+        return writeBackFrame(frame, &fileHandle);
+    return SUCCESS;
+}
+
+const unsigned long *BufferManager::getFileVersion(FileHandle &fileHandle)
+{
+    lock_guard<recursive_mutex> lock(_mutex);
+    return &_fileVersions[fileHandle._fileId];
+}
+
+// Bumped once a change is in the page, readers load it without taking _mutex
+void BufferManager::pageChanged(const FileId &fileId)
+{
+    __atomic_fetch_add(&_fileVersions[fileId], 1, __ATOMIC_RELEASE);
+}
+
+void BufferManager::registerHandle(FileHandle &fileHandle)
+{
+    lock_guard<recursive_mutex> lock(_mutex);
+    vector<FileHandle *> &handles = _openHandles[fileHandle._fileId];
+
+    // Pages appended through a write-back handle may not be on disk yet
+    for (FileHandle *other : handles)
+        fileHandle._numPages = max(fileHandle._numPages, other->_numPages);
+    handles.push_back(&fileHandle);
+}
+
+// The largest size any open handle on the file knows of
+unsigned BufferManager::getOpenFileSize(const FileId &fileId)
+{
+    lock_guard<recursive_mutex> lock(_mutex);
+    unsigned numPages = 0;
+    auto it = _openHandles.find(fileId);
+    if (it != _openHandles.end())
+    {
+        for (FileHandle *handle : it->second)
+            numPages = max(numPages, handle->_numPages);
+    }
+    return numPages;
+}
+
+// Lets every other open handle on the file see a page appended through fileHandle
+void BufferManager::pageAppended(FileHandle &fileHandle)
+{
+    lock_guard<recursive_mutex> lock(_mutex);
+    auto it = _openHandles.find(fileHandle._fileId);
+    if (it == _openHandles.end())
+        return;
+    for (FileHandle *other : it->second)
+        other->_numPages = max(other->_numPages, fileHandle._numPages);
+}
+
+// Forgets an open handle. Copies of a handle were never registered, so they are ignored.
+RC BufferManager::unregisterHandle(FileHandle &fileHandle)
+{
+    lock_guard<recursive_mutex> lock(_mutex);
+    auto it = _openHandles.find(fileHandle._fileId);
+    if (it == _openHandles.end())
+        return SUCCESS;
+
+    vector<FileHandle *> &handles = it->second;
+    auto pos = find(handles.begin(), handles.end(), &fileHandle);
+    if (pos == handles.end())
+        return SUCCESS;
+
+    // Nobody is left to write back through once the last handle is gone
+    RC rc = SUCCESS;
+    if (handles.size() == 1)
+        rc = flushFileFrames(fileHandle);
+
+    handles.erase(pos);
+    if (handles.empty())
+        _openHandles.erase(it);
+    return rc;
+}
+
+// Drops every cached page of a file without writing it back
+void BufferManager::discardFile(const FileId &fileId)
+{
+    unique_lock<recursive_mutex> lock(_mutex);
+    for (unsigned i = 0; i < _numFrames; i++)
+    {
+        // A page still being read in is let finish first
+        while (_frames[i].valid && _frames[i].loading && _frames[i].fileId == fileId)
+            _frameLoaded.wait(lock);
+        if (_frames[i].valid && _frames[i].fileId == fileId)
+            evictFrame(i);
+    }
+}
+
+RC BufferManager::writeBackPage(FileHandle &fileHandle, PageNum pageNum)
+{
+    lock_guard<recursive_mutex> lock(_mutex);
+    PageKey key;
+    key.fileId = fileHandle._fileId;
+    key.pageNum = pageNum;
+
+    auto it = _pageTable.find(key);
+    if (it == _pageTable.end() || !_frames[it->second].dirty)
+        return SUCCESS;
+    return writeBackFrame(it->second, &fileHandle);
+}
+
+void BufferManager::refreshPage(FileHandle &fileHandle, PageNum pageNum, const void *data)
+{
+    unique_lock<recursive_mutex> lock(_mutex);
+    PageKey key;
+    key.fileId = fileHandle._fileId;
+    key.pageNum = pageNum;
+
+    // A read in progress could still overwrite the frame with what was on disk before
+    unsigned frame;
+    pageChanged(key.fileId);
+    if (!findFrame(lock, key, frame))
+        return;
+
+    memcpy(getFrameData(frame), data, fileHandle._pageSize);
+    setFrameDirty(frame, false);
+}
+
+RC BufferManager::queuePage(FileHandle &fileHandle, PageNum pageNum, const void *data)
+{
+    unique_lock<recursive_mutex> lock(_mutex);
+    PageKey key;
+    key.fileId = fileHandle._fileId;
+    key.pageNum = pageNum;
+
+    // A page being read in is waited for, or the read would undo the write
+    unsigned frame;
+    if (!findFrame(lock, key, frame))
+    {
+        RC rc = getVictimFrame(frame, fileHandle._pageSize);
+        if (rc)
+            return rc;
+
+        _frames[frame].fileId = key.fileId;
+        _frames[frame].pageNum = pageNum;
+        _frames[frame].valid = true;
+        _frames[frame].dirty = false;
+        _pageTable[key] = frame;
+    }
+
+    memcpy(getFrameData(frame), data, fileHandle._pageSize);
+    _frames[frame].referenced = true;
+    setFrameDirty(frame, true);
+    pageChanged(key.fileId);
+
+    return checkDirtyThreshold(fileHandle);
+}
+
+bool BufferManager::PageKey::operator== (const PageKey &other) const
+{
+    return fileId == other.fileId && pageNum == other.pageNum;
+}
+
+size_t BufferManager::PageKeyHash::operator() (const PageKey &key) const
+{
+    // Pages of one file are the common case, so mix the page number in last
+    size_t h = key.fileId.dev * 31 + key.fileId.ino;
+    return h * 1000003 ^ key.pageNum;
+}
+
+
+PageReader* PageReader::_page_reader = NULL;
+
+PageReader* PageReader::instance()
+{
+    if(!_page_reader)
+        _page_reader = new PageReader();
+
+    return _page_reader;
+}
+
+
+PageReader::PageReader()
+: _ringFd(-1), _ringEntries(0), _sqHead(NULL), _sqTail(NULL), _sqMask(NULL), _sqArray(NULL),
+  _cqHead(NULL), _cqTail(NULL), _cqMask(NULL), _sqes(NULL), _cqes(NULL),
+  _sqRing(NULL), _cqRing(NULL), _sqRingSize(0), _cqRingSize(0), _sqesSize(0),
+  _threadsStarted(false), _batchFd(-1), _batchBlockSize(0), _batchPages(NULL), _batchData(NULL), _batchDoneFlags(NULL),
+  _nextRead(0), _readsDone(0)
+{
+    // Kernels without io_uring (or with it disabled) get the thread pool
+    setupRing();
+}
+
+
+PageReader::~PageReader()
+{
+    releaseRing();
+}
+
+
+void PageReader::readPages(int fd, unsigned blockSize, const vector<PageNum> &pageNums,
+                           const vector<void *> &data, vector<char> &done)
+{
+    // While another thread's batch is in flight this one is left to the caller, which
+    // reads it page by page itself rather than waiting
+    unique_lock<mutex> lock(_mutex, try_to_lock);
+    if (!lock.owns_lock())
+        return;
+    if (_ringFd >= 0)
+        readWithRing(fd, blockSize, pageNums, data, done);
+    else
+        readWithThreads(fd, blockSize, pageNums, data, done);
+}
+
+
+void PageReader::closeRing()
+{
+    lock_guard<mutex> lock(_mutex);
+    releaseRing();
+}
+
+
+// Private helper methods ///////////////////////////////////////////////////////////////////
+
+// Sets up an io_uring instance and maps its rings. There is no liburing to lean on,
+// so this talks to the kernel directly.
+bool PageReader::setupRing()
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = syscall(__NR_io_uring_setup, PR_QUEUE_DEPTH, &params);
+    if (fd < 0)
+        return false;
+
+    size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    // Newer kernels put both rings in one mapping
+    bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMap)
+        sqSize = cqSize = max(sqSize, cqSize);
+
+    void *sq = mmap(NULL, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sq == MAP_FAILED)
+    {
+        close(fd);
+        return false;
+    }
+    void *cq = sq;
+    if (!singleMap)
+    {
+        cq = mmap(NULL, cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (cq == MAP_FAILED)
+        {
+            munmap(sq, sqSize);
+            close(fd);
+            return false;
+        }
+    }
+    size_t sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    void *sqes = mmap(NULL, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+    {
+        if (!singleMap)
+            munmap(cq, cqSize);
+        munmap(sq, sqSize);
+        close(fd);
+        return false;
+    }
+
+    _sqHead  = (unsigned*) ((char*) sq + params.sq_off.head);
+    _sqTail  = (unsigned*) ((char*) sq + params.sq_off.tail);
+    _sqMask  = (unsigned*) ((char*) sq + params.sq_off.ring_mask);
+    _sqArray = (unsigned*) ((char*) sq + params.sq_off.array);
+    _cqHead  = (unsigned*) ((char*) cq + params.cq_off.head);
+    _cqTail  = (unsigned*) ((char*) cq + params.cq_off.tail);
+    _cqMask  = (unsigned*) ((char*) cq + params.cq_off.ring_mask);
+    _cqes    = (char*) cq + params.cq_off.cqes;
+    _sqes    = sqes;
+    _sqRing = sq;
+    _cqRing = singleMap ? NULL : cq;
+    _sqRingSize = sqSize;
+    _cqRingSize = cqSize;
+    _sqesSize = sqesSize;
+    // Never more reads in flight than the submission ring holds, so the
+    // (larger) completion ring can't overflow
+    _ringEntries = params.sq_entries;
+    _ringFd = fd;
+    return true;
+}
+
+void PageReader::readWithRing(int fd, unsigned blockSize, const vector<PageNum> &pageNums,
+                              const vector<void *> &data, vector<char> &done)
+{
+    size_t submitted = 0;
+    size_t completed = 0;
+    while (completed < pageNums.size())
+    {
+        // Queue as many reads as the ring has room for
+        unsigned tail = *_sqTail;
+        while (submitted < pageNums.size() && submitted - completed < _ringEntries)
+        {
+            unsigned index = tail & *_sqMask;
+            struct io_uring_sqe *sqe = (struct io_uring_sqe*) _sqes + index;
+            memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = IORING_OP_READ;
+            sqe->fd = fd;
+            sqe->addr = (uintptr_t) data[submitted];
+            sqe->len = blockSize;
+            sqe->off = (uint64_t) pageNums[submitted] * blockSize;
+            sqe->user_data = submitted;
+            _sqArray[index] = index;
+            tail++;
+            submitted++;
+        }
+        __atomic_store_n(_sqTail, tail, __ATOMIC_RELEASE);
+
+        // Hand the kernel whatever it hasn't picked up yet and wait for a completion
+        unsigned toSubmit = tail - __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE);
+        int rc = syscall(__NR_io_uring_enter, _ringFd, toSubmit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (rc < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+        {
+            // The ring is unusable. Reads the kernel already took still write into the
+            // caller's buffers, so wait for every one of them before letting go of it.
+            // Reads it never took are left to the caller, later batches go through
+            // the thread pool.
+            size_t taken = submitted - (tail - __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE));
+            while ((completed += reapCompletions(blockSize, done)) < taken)
+            {
+                if (syscall(__NR_io_uring_enter, _ringFd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0)
+                    this_thread::yield();
+            }
+            releaseRing();
+            return;
+        }
+
+        completed += reapCompletions(blockSize, done);
+    }
+}
+
+// Collects the finished reads and returns how many there were. Short ones count as not done.
+size_t PageReader::reapCompletions(unsigned blockSize, vector<char> &done)
+{
+    unsigned head = *_cqHead;
+    unsigned cqTail = __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE);
+    size_t reaped = 0;
+    for (; head != cqTail; head++)
+    {
+        struct io_uring_cqe *cqe = (struct io_uring_cqe*) _cqes + (head & *_cqMask);
+        done[cqe->user_data] = cqe->res == (int) blockSize;
+        reaped++;
+    }
+    __atomic_store_n(_cqHead, head, __ATOMIC_RELEASE);
+    return reaped;
+}
+
+// Unmaps the rings and closes the io_uring instance, if there is one
+void PageReader::releaseRing()
+{
+    if (_ringFd < 0)
+        return;
+    munmap(_sqes, _sqesSize);
+    if (_cqRing != NULL)
+        munmap(_cqRing, _cqRingSize);
+    munmap(_sqRing, _sqRingSize);
+    close(_ringFd);
+    _ringFd = -1;
+    _sqes = _cqes = _sqRing = _cqRing = NULL;
+}
+
+// Each thread of the pool keeps one pread in flight. The calling thread helps
+// out instead of just waiting.
+void PageReader::readWithThreads(int fd, unsigned blockSize, const vector<PageNum> &pageNums,
+                                 const vector<void *> &data, vector<char> &done)
+{
+    {
+        lock_guard<mutex> lock(_poolMutex);
+        // The pool is only started once it is needed
+        if (!_threadsStarted)
+        {
+            for (unsigned i = 0; i < PR_NUM_THREADS; i++)
+                thread(&PageReader::worker, this).detach();
+            _threadsStarted = true;
+        }
+
+        _batchFd = fd;
+        _batchBlockSize = blockSize;
+        _batchPages = &pageNums;
+        _batchData = &data;
+        _batchDoneFlags = &done;
+        _nextRead = 0;
+        _readsDone = 0;
+    }
+    _workReady.notify_all();
+
+    size_t i;
+    while (takeRead(i))
+        readOne(i);
+
+    unique_lock<mutex> lock(_poolMutex);
+    _batchDone.wait(lock, [&] { return _readsDone == pageNums.size(); });
+    _batchPages = NULL;
+}
+
+// Claims the next read of the current batch, if there is one left
+bool PageReader::takeRead(size_t &i)
+{
+    lock_guard<mutex> lock(_poolMutex);
+    if (_batchPages == NULL || _nextRead >= _batchPages->size())
+        return false;
+    i = _nextRead++;
+    return true;
+}
+
+// Reads page i of the current batch with pread
+void PageReader::readOne(size_t i)
+{
+    char *buffer = (char*) (*_batchData)[i];
+    off_t offset = (off_t) (*_batchPages)[i] * _batchBlockSize;
+    size_t got = 0;
+    while (got < _batchBlockSize)
+    {
+        ssize_t n = pread(_batchFd, buffer + got, _batchBlockSize - got, offset + got);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        got += n;
+    }
+
+    lock_guard<mutex> lock(_poolMutex);
+    (*_batchDoneFlags)[i] = got == _batchBlockSize;
+    if (++_readsDone == _batchPages->size())
+        _batchDone.notify_all();
+}
+
+void PageReader::worker()
+{
+    while (true)
+    {
+        size_t i;
+        {
+            unique_lock<mutex> lock(_poolMutex);
+            _workReady.wait(lock, [&] { return _batchPages != NULL && _nextRead < _batchPages->size(); });
+            i = _nextRead++;
+        }
+        readOne(i);
+    }
+}
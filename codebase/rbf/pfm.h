@@ -9,31 +9,94 @@
 #define PFM_HANDLE_IN_USE 4
 #define PFM_FILE_DN_EXIST 5
 #define PFM_FILE_NOT_OPEN 6
+#define PFM_BAD_HEADER    7
+#define PFM_BAD_PAGE_SIZE 8
 
 #define FH_PAGE_DN_EXIST  1
 #define FH_SEEK_FAILED    2
 #define FH_READ_FAILED    3
 #define FH_WRITE_FAILED   4
+#define FH_NOT_MAPPED     5
+
+// Flags for PagedFileManager::openFile
+#define PFM_OPEN_DEFAULT  0
+#define PFM_OPEN_DIRECT   1   // Unbuffered page transfers (O_DIRECT) where the file system supports it
+#define PFM_OPEN_MMAP     2   // Read pages through a shared read-only mapping of the file
+
+// Write policies for FileHandle::setWritePolicy
+#define FH_SYNC_EVERY_WRITE 0   // Every written page is handed to the OS right away (the default)
+#define FH_WRITE_BACK       1   // Written pages are queued in the buffer pool and go out coalesced
+                                // on flush()/sync(), on close, or once the dirty threshold is hit
+
+#define BM_NO_FREE_FRAME  1
+#define BM_FRAMES_PINNED  2
+#define BM_MALLOC_FAILED  3
+#define BM_NO_OPEN_HANDLE 4
 
 typedef unsigned PageNum;
 typedef int RC;
 typedef char byte;
 
+// Default page size, and the smallest one. A file can use any power of two up to
+// PFM_MAX_PAGE_SIZE, chosen when it is created.
 #define PAGE_SIZE 4096
+#define PFM_MAX_PAGE_SIZE 65536
+
+// Number of page frames in the buffer pool unless changed with setNumberOfFrames()
+#define BM_DEFAULT_NUM_FRAMES 1024
+// Page 0 of every paged file is a header that FileHandle never exposes, page n of
+// a file is stored right after it. The header takes up a whole page of the file's
+// page size, but only its first PAGE_SIZE bytes are ever read or written. Files
+// grow by a whole extent at a time, so the header keeps the logical number of pages.
+#define PFM_HEADER_PAGES 1
+#define PFM_MAGIC        0x31464d50                    // "PFM1"
+// Pages a file grows by unless changed with FileHandle::setExtentSize()
+#define PFM_DEFAULT_EXTENT_PAGES 256
+// Percentage of each page inserts may fill unless changed with FileHandle::setFillFactor()
+#define PFM_DEFAULT_FILL_FACTOR 100
+
+// Address space reserved for a PFM_OPEN_MMAP file. Pages past it are read with pread.
+#define PFM_MMAP_MAX_SIZE ((size_t) 1 << 36)
+// Dirty pages a FH_WRITE_BACK file may queue before they are written out
+#define FH_DEFAULT_DIRTY_THRESHOLD 256
+
+// Reads a PageReader keeps in flight at once
+#define PR_QUEUE_DEPTH 64
+// Threads doing the reads when io_uring isn't available
+#define PR_NUM_THREADS 16
+
 #include <string>
 #include <climits>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 using namespace std;
 
 class FileHandle;
 
+// Stored at the start of the header page
+typedef struct FileHeader
+{
+    uint32_t magic;
+    uint32_t numPages;                                                  // Pages past this are preallocated but unused
+    uint32_t extentPages;
+    uint32_t pageSize;
+    uint32_t fillFactor;                                                // 0 in files created before it was kept
+} FileHeader;
+
 class PagedFileManager
 {
 public:
     static PagedFileManager* instance();                                // Access to the _pf_manager instance
 
-    RC createFile    (const string &fileName);                          // Create a new file
+    RC createFile    (const string &fileName,                           // Create a new file
+                      unsigned pageSize = PAGE_SIZE);
     RC destroyFile   (const string &fileName);                          // Destroy a file
-    RC openFile      (const string &fileName, FileHandle &fileHandle);  // Open a file
+    RC openFile      (const string &fileName, FileHandle &fileHandle,   // Open a file
+                      unsigned flags = PFM_OPEN_DEFAULT);
     RC closeFile     (FileHandle &fileHandle);                          // Close a file
 
 protected:
@@ -48,6 +111,18 @@ private:
 };
 
 
+// Identifies a file independently of the handle it was opened through,
+// so every handle on the same file shares the same cached pages
+typedef struct FileId
+{
+    uint64_t dev;
+    uint64_t ino;
+} FileId;
+
+bool operator< (const FileId &a, const FileId &b);
+bool operator== (const FileId &a, const FileId &b);
+
+
 class FileHandle
 {
 public:
@@ -55,25 +130,276 @@ public:
     unsigned readPageCounter;
     unsigned writePageCounter;
     unsigned appendPageCounter;
-    
+
     FileHandle();                                                       // Default constructor
     ~FileHandle();                                                      // Destructor
 
+    // Pages are transferred with pread/pwrite, so several threads may read through one handle
     RC readPage(PageNum pageNum, void *data);                           // Get a specific page
+    RC readPages(const vector<PageNum> &pageNums,                       // Get several pages, with all reads in flight at once
+                 const vector<void *> &data);
     RC writePage(PageNum pageNum, const void *data);                    // Write a specific page
     RC appendPage(const void *data);                                    // Append a specific page
+    RC appendPages(const vector<void *> &data);                         // Append several pages in one write, bypassing the buffer pool
+    RC borrowPage(PageNum pageNum, const void *&data);                  // Point into the mapping of a PFM_OPEN_MMAP file, valid until closeFile
+    RC readAhead(PageNum pageNum, unsigned count);                      // Let the OS start reading pages we will need soon
+    bool isMapped();                                                    // Whether borrowPage can be used
+    RC extendMapping();                                                 // Map every page the file has so far, reading none of them
     unsigned getNumberOfPages();                                        // Get the number of pages in the file
+    unsigned getPageSize();                                             // Size in bytes of every page of the file
+    RC refreshNumberOfPages();                                          // Re-read the size of a file grown by others
+    RC setExtentSize(unsigned numPages);                                // Number of pages the file grows by at a time
+    unsigned getFillFactor();                                           // Percentage of each page inserts may fill, the
+    RC setFillFactor(unsigned percent);                                 // rest is left for records to grow into
+    RC setWritePolicy(unsigned policy,                                  // Choose between FH_SYNC_EVERY_WRITE and FH_WRITE_BACK
+                      unsigned dirtyThreshold = FH_DEFAULT_DIRTY_THRESHOLD);
+    RC flush();                                                         // Write out every queued page of the file
+    RC sync();                                                          // Flush and wait until the pages are on stable storage
     RC collectCounterValues(unsigned &readPageCount, unsigned &writePageCount, unsigned &appendPageCount);  // Put the current counter values into variables
 
-    // Let PagedFileManager access our private helper methods
+    // Let PagedFileManager and BufferManager access our private helper methods
+    friend class PagedFileManager;
+    friend class BufferManager;
+
+private:
+    int _fd;
+    bool _direct;                                                       // Opened with O_DIRECT
+    char *_map;                                                         // Reserved address range of a PFM_OPEN_MMAP file
+    unsigned _mappedPages;                                              // Pages of _map backed by the file so far
+    FileId _fileId;
+    unsigned _pageSize;
+    unsigned _numPages;                                                 // Cached file size in pages
+    unsigned _headerPages;                                              // Size last seen in or written to the header
+    unsigned _allocatedPages;                                           // Pages the file has room for
+    unsigned _extentPages;
+    unsigned _fillFactor;
+    unsigned _writePolicy;
+    unsigned _dirtyThreshold;
+
+    // Private helper methods
+    void setfd(int fd);
+    int getfd();
+    bool transferPage(PageNum pageNum, void *data, bool write);
+    bool pageExists(PageNum pageNum);
+    bool mapPage(PageNum pageNum);
+    RC allocatePage(PageNum pageNum);
+    RC updateHeader();
+
+    // Disk transfers that bypass the buffer pool. These are the only places
+    // that bump readPageCounter/writePageCounter
+    RC readPageFromDisk(PageNum pageNum, void *data);
+    RC readPagesFromDisk(const vector<PageNum> &pageNums, const vector<void *> &data);
+    RC writePageToDisk(PageNum pageNum, const void *data);
+    RC writePagesToDisk(PageNum pageNum, const vector<void *> &pages);  // Consecutive pages in one pwritev
+};
+
+
+// A pinned page in the buffer pool. The frame stays resident until unpin()
+// is called or the handle goes out of scope. Changes are made after pinning and
+// announced with markDirty(), which writes them right away, and reports how that
+// went, when the page was pinned through a FH_SYNC_EVERY_WRITE handle.
+class PageHandle
+{
+public:
+    PageHandle();
+    ~PageHandle();
+
+    void *getData();                                                    // The pinned page contents
+    PageNum getPageNum();                                               // Page number within its file
+    RC markDirty();                                                     // Page must be written back before eviction
+    void unpin();                                                       // Release the frame early
+
+    friend class BufferManager;
+
+private:
+    int _frame;                                                         // -1 when nothing is pinned
+    PageNum _pageNum;
+    void *_data;
+    FileHandle *_fileHandle;                                            // The handle the page was pinned through
+
+    // A pin is owned by exactly one handle
+    PageHandle(const PageHandle &);
+    PageHandle &operator= (const PageHandle &);
+};
+
+
+// Page cache shared by every FileHandle. Pages are replaced with the CLOCK
+// algorithm and dirty pages are only written when evicted, flushed, when the
+// last handle on their file is closed, or when a FH_WRITE_BACK file reaches its
+// dirty threshold. Runs of adjacent dirty pages are written with one pwritev.
+// All methods are thread safe. Pages are read in without holding the pool's lock,
+// so threads missing on different pages read them at the same time.
+class BufferManager
+{
+public:
+    static BufferManager* instance();                                   // Access to the _buffer_manager instance
+
+    RC setNumberOfFrames(unsigned numFrames);                           // Resize the pool, fails while pages are pinned
+    unsigned getNumberOfFrames();                                       // Number of page frames in the pool
+
+    RC pinPage(FileHandle &fileHandle, PageNum pageNum, PageHandle &pageHandle);  // Pin a page, reading it on a miss
+    RC appendPage(FileHandle &fileHandle, const void *data);            // Append a page and keep it cached
+    RC flushFile(FileHandle &fileHandle);                               // Write back every dirty page of a file
+    RC prefetchPages(FileHandle &fileHandle,                            // Read the uncached ones of these pages in one batch
+                     const vector<PageNum> &pageNums);
+    // Counts the changes made to pages of the file, through any handle. Whoever keeps
+    // looking at a page can tell from it whether the page may have changed since.
+    const unsigned long *getFileVersion(FileHandle &fileHandle);
+
     friend class PagedFileManager;
+    friend class FileHandle;
+    friend class PageHandle;
+
+protected:
+    BufferManager();                                                    // Constructor
+    ~BufferManager();                                                   // Destructor
+
+private:
+    static BufferManager *_buffer_manager;
+
+    typedef struct Frame
+    {
+        FileId fileId;
+        PageNum pageNum;
+        unsigned pinCount;
+        bool valid;
+        bool dirty;
+        bool referenced;                                                // CLOCK reference bit
+        bool loading;                                                   // Being read in, _frameLoaded tells when it's done
+        char *data;                                                     // Page aligned, grown to the largest page held so far
+        unsigned size;
+    } Frame;
+
+    typedef struct PageKey
+    {
+        FileId fileId;
+        PageNum pageNum;
+        bool operator== (const PageKey &other) const;
+    } PageKey;
+
+    struct PageKeyHash
+    {
+        size_t operator() (const PageKey &key) const;
+    };
+
+    // Recursive, as disk transfers made under it may ask about the open handles
+    recursive_mutex _mutex;
+    condition_variable_any _frameLoaded;
+    unsigned _numFrames;
+    vector<Frame> _frames;
+    unsigned _clockHand;
+    unordered_map<PageKey, unsigned, PageKeyHash> _pageTable;
+    // Handles currently open on each file, used to write back dirty pages
+    map<FileId, vector<FileHandle *> > _openHandles;
+    // Number of dirty frames of each file, checked against the write-back threshold
+    map<FileId, unsigned> _dirtyPages;
+    // Changes made to each file, entries are never removed so pointers to them stay valid
+    map<FileId, unsigned long> _fileVersions;
+
+    // Private helper methods
+    void *getFrameData(unsigned frame);
+    // Looks a page up, waiting for it if another thread is reading it in. The caller
+    // holds _mutex through lock, and only once.
+    bool findFrame(unique_lock<recursive_mutex> &lock, const PageKey &key, unsigned &frame);
+    void claimFrame(unsigned frame, const PageKey &key);
+    void finishLoad(unsigned frame, RC rc);
+    void pinFrame(FileHandle &fileHandle, unsigned frame, PageHandle &pageHandle);
+    RC getVictimFrame(unsigned &frame, unsigned pageSize);
+    RC findVictimFrame(unsigned &frame);
+    void freeFrames();
+    RC flushFileFrames(FileHandle &fileHandle, bool skipPinned = false);
+    RC writeBackFrame(unsigned frame, FileHandle *fileHandle);
+    RC writeBackRun(const vector<unsigned> &run, FileHandle &fileHandle);
+    RC checkDirtyThreshold(FileHandle &fileHandle);
+    void setFrameDirty(unsigned frame, bool dirty);
+    void evictFrame(unsigned frame);
+    void unpinFrame(unsigned frame);
+    RC markFrameDirty(unsigned frame, FileHandle &fileHandle);
+    void pageChanged(const FileId &fileId);
+
+    void registerHandle(FileHandle &fileHandle);
+    unsigned getOpenFileSize(const FileId &fileId);
+    void pageAppended(FileHandle &fileHandle);
+    RC unregisterHandle(FileHandle &fileHandle);
+    void discardFile(const FileId &fileId);
+
+    // Keep cached pages coherent with direct FileHandle transfers
+    RC writeBackPage(FileHandle &fileHandle, PageNum pageNum);
+    void refreshPage(FileHandle &fileHandle, PageNum pageNum, const void *data);
+
+    // Queues a page written through a FH_WRITE_BACK handle as a dirty frame
+    RC queuePage(FileHandle &fileHandle, PageNum pageNum, const void *data);
+};
+
+
+// Reads batches of pages with all of them in flight at once, through io_uring
+// where the kernel offers it and through a pool of threads doing pread otherwise.
+// Batches are read one at a time.
+class PageReader
+{
+public:
+    static PageReader* instance();                                      // Access to the _page_reader instance
+
+    // Reads the block of blockSize bytes at pageNums[i] * blockSize of the file into
+    // data[i]. done[i] is set for every block that was read in full, the caller takes
+    // care of the others.
+    void readPages(int fd, unsigned blockSize, const vector<PageNum> &pageNums,
+                   const vector<void *> &data, vector<char> &done);
+
+    // Gives up io_uring, later batches go through the thread pool
+    void closeRing();
+
+protected:
+    PageReader();                                                       // Constructor
+    ~PageReader();                                                      // Destructor
 
 private:
-    FILE *_fd;
+    static PageReader *_page_reader;
+
+    mutex _mutex;                                                       // Held for a whole batch
+
+    // io_uring submission and completion rings, _ringFd is -1 without io_uring
+    int _ringFd;
+    unsigned _ringEntries;
+    unsigned *_sqHead;
+    unsigned *_sqTail;
+    unsigned *_sqMask;
+    unsigned *_sqArray;
+    unsigned *_cqHead;
+    unsigned *_cqTail;
+    unsigned *_cqMask;
+    void *_sqes;
+    void *_cqes;
+    void *_sqRing;                                                      // The three mappings, to unmap them again
+    void *_cqRing;
+    size_t _sqRingSize;
+    size_t _cqRingSize;
+    size_t _sqesSize;
+
+    // State of the batch the thread pool is working on
+    mutex _poolMutex;
+    condition_variable _workReady;
+    condition_variable _batchDone;
+    bool _threadsStarted;
+    int _batchFd;
+    unsigned _batchBlockSize;
+    const vector<PageNum> *_batchPages;
+    const vector<void *> *_batchData;
+    vector<char> *_batchDoneFlags;
+    size_t _nextRead;
+    size_t _readsDone;
 
     // Private helper methods
-    void setfd(FILE *fd);
-    FILE *getfd();
-}; 
+    bool setupRing();
+    void releaseRing();
+    size_t reapCompletions(unsigned blockSize, vector<char> &done);
+    void readWithRing(int fd, unsigned blockSize, const vector<PageNum> &pageNums,
+                      const vector<void *> &data, vector<char> &done);
+    void readWithThreads(int fd, unsigned blockSize, const vector<PageNum> &pageNums,
+                         const vector<void *> &data, vector<char> &done);
+    bool takeRead(size_t &i);
+    void readOne(size_t i);
+    void worker();
+};
 
 #endif
@@ -1,16 +1,24 @@
 #include <algorithm>
-#include <cmath>
+#include <atomic>
 #include <cstdint>
 #include <cstdio>
 #include <cstring>
 #include <iomanip>
 #include <iostream>
+#include <mutex>
 #include <string>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RBFM_SIMD_X86
+#endif
 
 #include "rbfm.h"
 
 RecordBasedFileManager* RecordBasedFileManager::_rbf_manager = NULL;
 PagedFileManager *RecordBasedFileManager::_pf_manager = NULL;
+BufferManager *RecordBasedFileManager::_buffer_manager = NULL;
 
 RecordBasedFileManager* RecordBasedFileManager::instance()
 {
@@ -24,30 +32,43 @@ RecordBasedFileManager::RecordBasedFileManager()
 {
     // Initialize the internal PagedFileManager instance
     _pf_manager = PagedFileManager::instance();
+    // All page reads go through the shared buffer pool
+    _buffer_manager = BufferManager::instance();
 }
 
 RecordBasedFileManager::~RecordBasedFileManager()
 {
 }
 
-RC RecordBasedFileManager::createFile(const string &fileName) 
+RC RecordBasedFileManager::createFile(const string &fileName, unsigned pageSize, unsigned fillFactor) 
 {
+    if (fillFactor == 0 || fillFactor > 100)
+        return RBFM_BAD_FILL_FACTOR;
+
     // Creating a new paged file.
-    if (_pf_manager->createFile(fileName))
+    if (_pf_manager->createFile(fileName, pageSize))
         return RBFM_CREATE_FAILED;
 
     // Setting up the first page.
-    void * firstPageData = calloc(PAGE_SIZE, 1);
+    void * firstPageData = calloc(pageSize, 1);
     if (firstPageData == NULL)
         return RBFM_MALLOC_FAILED;
-    newRecordBasedPage(firstPageData);
 
-    // Adds the first record based page.
     FileHandle handle;
     if (_pf_manager->openFile(fileName.c_str(), handle))
         return RBFM_OPEN_FAILED;
+    if (fillFactor != PFM_DEFAULT_FILL_FACTOR && handle.setFillFactor(fillFactor))
+        return RBFM_CREATE_FAILED;
+
+    // Adds the free space map root, which starts out empty.
     if (handle.appendPage(firstPageData))
         return RBFM_APPEND_FAILED;
+
+    // Adds the first record based page (and the FSM leaf page describing it).
+    PageNum pageNum;
+    newRecordBasedPage(firstPageData, pageSize);
+    if (appendRecordBasedPage(handle, firstPageData, pageNum))
+        return RBFM_APPEND_FAILED;
     _pf_manager->closeFile(handle);
 
     free(firstPageData);
@@ -60,9 +81,15 @@ RC RecordBasedFileManager::destroyFile(const string &fileName)
     return _pf_manager->destroyFile(fileName);
 }
 
-RC RecordBasedFileManager::openFile(const string &fileName, FileHandle &fileHandle) 
+RC RecordBasedFileManager::openFile(const string &fileName, FileHandle &fileHandle, unsigned flags) 
 {
-    return _pf_manager->openFile(fileName.c_str(), fileHandle);
+    RC rc = _pf_manager->openFile(fileName.c_str(), fileHandle, flags);
+    if (rc)
+        return rc;
+
+    // Record pages are changed in the buffer pool and written out on close or
+    // at the dirty threshold rather than on every change
+    return fileHandle.setWritePolicy(FH_WRITE_BACK);
 }
 
 RC RecordBasedFileManager::closeFile(FileHandle &fileHandle) 
@@ -70,82 +97,143 @@ RC RecordBasedFileManager::closeFile(FileHandle &fileHandle)
     return _pf_manager->closeFile(fileHandle);
 }
 
-RC RecordBasedFileManager::insertRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const void *data, RID &rid) 
+RC RecordBasedFileManager::insertRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const void *data, RID &rid)
+{
+    return insertRecord(fileHandle, getLayout(recordDescriptor), data, rid);
+}
+
+RC RecordBasedFileManager::insertRecord(FileHandle &fileHandle, const RecordLayout &layout, const void *data, RID &rid)
 {
     // Gets the size of the record.
-    unsigned recordSize = getRecordSize(recordDescriptor, data);
+    unsigned recordSize = getRecordSize(layout, data);
 
-    // Cycles through pages looking for enough free space for the new entry.
-    void *pageData = malloc(PAGE_SIZE);
-    if (pageData == NULL)
-        return RBFM_MALLOC_FAILED;
+    // Asks the free space map for a page with enough space (accounting also for the size that will be added to the slot directory).
+    // The space the fill factor reserves must be left free after the record goes in.
+    PageHandle page;
+    void *pageData = NULL;
     bool pageFound = false;
-    unsigned i;
-    unsigned numPages = fileHandle.getNumberOfPages();
-    for (i = 0; i < numPages; i++)
-    {
-        if (fileHandle.readPage(i, pageData))
-            return RBFM_READ_FAILED;
-
-        // When we find a page with enough space (accounting also for the size that will be added to the slot directory), we stop the loop.
-        if (getPageFreeSpaceSize(pageData) >= sizeof(SlotDirectoryRecordEntry) + recordSize)
-        {
-            pageFound = true;
-            break;
-        }
-    }
+    unsigned reservedSpace = getReservedSpace(fileHandle);
+    if (findPageWithFreeSpace(fileHandle, sizeof(SlotDirectoryRecordEntry) + recordSize + reservedSpace, page, pageFound))
+        return RBFM_READ_FAILED;
 
     // If we can't find a page with enough space, we create a new one
-    if(!pageFound)
+    if (pageFound)
     {
-        newRecordBasedPage(pageData);
+        pageData = page.getData();
+    }
+    else
+    {
+        pageData = malloc(fileHandle.getPageSize());
+        if (pageData == NULL)
+            return RBFM_MALLOC_FAILED;
+        newRecordBasedPage(pageData, fileHandle.getPageSize());
     }
 
-    SlotDirectoryHeader slotHeader = getSlotDirectoryHeader(pageData);
-
-    // Setting the return RID.
-    rid.pageNum = i;
-    rid.slotNum = getOpenSlot(pageData);
-
-    // Adding the new record reference in the slot directory.
-    SlotDirectoryRecordEntry newRecordEntry;
-    newRecordEntry.length = recordSize;
-    newRecordEntry.offset = slotHeader.freeSpaceOffset - recordSize;
-    setSlotDirectoryRecordEntry(pageData, rid.slotNum, newRecordEntry);
-
-    // Updating the slot directory header.
-    slotHeader.freeSpaceOffset = newRecordEntry.offset;
-    if (rid.slotNum == slotHeader.recordEntriesNumber)
-        slotHeader.recordEntriesNumber += 1;
-    setSlotDirectoryHeader(pageData, slotHeader);
-
-    // Adding the record data.
-    setRecordAtOffset (pageData, newRecordEntry.offset, recordDescriptor, data);
+    // Setting the return RID. The page number of a new page is only known once it is appended.
+    rid.pageNum = page.getPageNum();
+    rid.slotNum = placeRecord(pageData, layout, data, recordSize);
 
-    // Writing the page to disk.
+    // The buffer pool writes modified pages back, new pages are appended right away.
     if (pageFound)
     {
-        if (fileHandle.writePage(i, pageData))
+        if (page.markDirty())
             return RBFM_WRITE_FAILED;
-    }
-    else
-    {
-        if (fileHandle.appendPage(pageData))
-            return RBFM_APPEND_FAILED;
+        RC rc = updateFreeSpaceMap(fileHandle, rid.pageNum, pageData);
+        if (rc)
+            return rc;
+        return updateZoneMap(fileHandle, rid.pageNum, pageData, layout, rid.slotNum, rid.slotNum + 1);
     }
 
+    RC rc = appendRecordBasedPage(fileHandle, pageData, rid.pageNum);
+    if (rc == SUCCESS)
+        rc = updateZoneMap(fileHandle, rid.pageNum, pageData, layout, rid.slotNum, rid.slotNum + 1);
     free(pageData);
+    if (rc)
+        return RBFM_APPEND_FAILED;
     return SUCCESS;
 }
 
-RC RecordBasedFileManager::readRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const RID &rid, void *data) 
+RC RecordBasedFileManager::insertRecords(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const vector<const void *> &data, vector<RID> &rids)
+{
+    return insertRecords(fileHandle, getLayout(recordDescriptor), data, rids);
+}
+
+// Fills each page with as many of the records as fit before moving on to the next,
+// so the free space map is searched and updated once per page rather than once per record
+RC RecordBasedFileManager::insertRecords(FileHandle &fileHandle, const RecordLayout &layout, const vector<const void *> &data, vector<RID> &rids)
+{
+    unsigned pageSize = fileHandle.getPageSize();
+    unsigned reservedSpace = getReservedSpace(fileHandle);
+    rids.resize(data.size());
+
+    // The page being filled is either pinned from the file, or built in newPage
+    // and appended once it is full
+    PageHandle page;
+    void *pageData = NULL;
+    void *newPage = NULL;
+    size_t firstOnPage = 0;
+    RC rc = SUCCESS;
+
+    for (size_t i = 0; i < data.size(); i++)
+    {
+        unsigned recordSize = getRecordSize(layout, data[i]);
+        unsigned size = sizeof(SlotDirectoryRecordEntry) + recordSize;
+
+        // Move on to another page once this record doesn't fit in front of the reserved space
+        if (pageData == NULL || getPageFreeSpaceSize(pageData) < size + reservedSpace)
+        {
+            if (pageData != NULL)
+            {
+                rc = finishInsertPage(fileHandle, page, pageData, pageData == newPage, layout, rids, firstOnPage, i);
+                if (rc)
+                    break;
+            }
+
+            bool pageFound = false;
+            if (findPageWithFreeSpace(fileHandle, size + reservedSpace, page, pageFound))
+            {
+                rc = RBFM_READ_FAILED;
+                break;
+            }
+            if (pageFound)
+            {
+                pageData = page.getData();
+            }
+            else
+            {
+                if (newPage == NULL && (newPage = malloc(pageSize)) == NULL)
+                {
+                    rc = RBFM_MALLOC_FAILED;
+                    break;
+                }
+                newRecordBasedPage(newPage, pageSize);
+                pageData = newPage;
+            }
+            firstOnPage = i;
+        }
+
+        rids[i].pageNum = page.getPageNum();
+        rids[i].slotNum = placeRecord(pageData, layout, data[i], recordSize);
+    }
+
+    if (rc == SUCCESS && pageData != NULL)
+        rc = finishInsertPage(fileHandle, page, pageData, pageData == newPage, layout, rids, firstOnPage, data.size());
+    free(newPage);
+    return rc;
+}
+
+RC RecordBasedFileManager::readRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const RID &rid, void *data)
+{
+    return readRecord(fileHandle, getLayout(recordDescriptor), rid, data);
+}
+
+RC RecordBasedFileManager::readRecord(FileHandle &fileHandle, const RecordLayout &layout, const RID &rid, void *data)
 {
     // Retrieve the specific page
-    void *pageData = malloc(PAGE_SIZE);
-    if (pageData == NULL)
-        return RBFM_MALLOC_FAILED;
-    if (fileHandle.readPage(rid.pageNum, pageData))
+    PageHandle page;
+    if (_buffer_manager->pinPage(fileHandle, rid.pageNum, page))
         return RBFM_READ_FAILED;
+    void *pageData = page.getData();
 
     // Checks if the specific slot id exists in the page
     SlotDirectoryHeader slotHeader = getSlotDirectoryHeader(pageData);
@@ -160,32 +248,69 @@ RC RecordBasedFileManager::readRecord(FileHandle &fileHandle, const vector<Attri
     {
         // Error to read a deleted record
         case DEAD:
-            free(pageData);
             return RBFM_READ_AFTER_DEL;
         // Get the forwarding address from the record entry and recurse
         case MOVED:
-            free(pageData);
+            page.unpin();
             RID newRid;
             newRid.pageNum = recordEntry.length;
             newRid.slotNum = -recordEntry.offset;
-            return readRecord(fileHandle, recordDescriptor, newRid, data);
+            return readRecord(fileHandle, layout, newRid, data);
         // Retrieve the actual entry data
         case VALID:
             int32_t offset = recordEntry.offset;
-            getRecordAtOffset(pageData, offset, recordDescriptor, data);
-            free(pageData);
+            getRecordAtOffset(pageData, offset, layout, data);
             return SUCCESS;
     }
     // Not possible to reach this point, but compiler doesn't know that
     return -1;
 }
 
+RC RecordBasedFileManager::readRecordView(FileHandle &fileHandle, const RID &rid, RecordView &view)
+{
+    // The view keeps the page pinned in place of a copy of the record
+    view.release();
+    if (_buffer_manager->pinPage(fileHandle, rid.pageNum, view.page))
+        return RBFM_READ_FAILED;
+    void *pageData = view.page.getData();
+
+    // Checks if the specific slot id exists in the page
+    SlotDirectoryHeader slotHeader = getSlotDirectoryHeader(pageData);
+    if (slotHeader.recordEntriesNumber <= rid.slotNum)
+    {
+        view.release();
+        return RBFM_SLOT_DN_EXIST;
+    }
+
+    SlotDirectoryRecordEntry recordEntry = getSlotDirectoryRecordEntry(pageData, rid.slotNum);
+    switch (getSlotStatus(recordEntry))
+    {
+        case DEAD:
+            view.release();
+            return RBFM_READ_AFTER_DEL;
+        // Follow the forwarding address
+        case MOVED:
+            RID newRid;
+            newRid.pageNum = recordEntry.length;
+            newRid.slotNum = -recordEntry.offset;
+            return readRecordView(fileHandle, newRid, view);
+        case VALID:
+        break;
+    }
+
+    view.fileHandle = &fileHandle;
+    view.pageNum = rid.pageNum;
+    view.record = (const char*) pageData + recordEntry.offset;
+    return SUCCESS;
+}
+
 RC RecordBasedFileManager::deleteRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const RID &rid)
 {
     // Get page
-    void *pageData = malloc(PAGE_SIZE);
-    if (fileHandle.readPage(rid.pageNum, pageData) != SUCCESS)
+    PageHandle page;
+    if (_buffer_manager->pinPage(fileHandle, rid.pageNum, page) != SUCCESS)
         return RBFM_READ_FAILED;
+    void *pageData = page.getData();
 
     // Get page header
     SlotDirectoryHeader slotHeader = getSlotDirectoryHeader(pageData);
@@ -198,7 +323,6 @@ RC RecordBasedFileManager::deleteRecord(FileHandle &fileHandle, const vector<Att
     // Cannot delete a deleted page
     if (status == DEAD)
     {
-        free(pageData);
         return RBFM_SLOT_DN_EXIST;
     }
     // Recursively delete moved pages
@@ -209,22 +333,24 @@ RC RecordBasedFileManager::deleteRecord(FileHandle &fileHandle, const vector<Att
         newRid.slotNum = -recordEntry.offset;
         RC rc = deleteRecord(fileHandle, recordDescriptor, newRid);
         if (rc != SUCCESS)
-        {
-            free(pageData);
             return rc;
-        }
         markSlotDeleted(pageData, rid.slotNum);
     }
     else if (status == VALID)
     {
         markSlotDeleted(pageData, rid.slotNum);
-        reorganizePage(pageData);
+        reorganizePage(pageData, fileHandle.getPageSize());
     }
     
-    // Once we've deleted the page(s), write changes to disk
-    RC rc = fileHandle.writePage(rid.pageNum, pageData);
-    free(pageData);
-    return rc;
+    // Once we've deleted the page(s), let the buffer pool write the changes back
+    if (page.markDirty())
+        return RBFM_WRITE_FAILED;
+    return updateFreeSpaceMap(fileHandle, rid.pageNum, pageData);
+}
+
+RC RecordBasedFileManager::updateRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const void *data, const RID &rid)
+{
+    return updateRecord(fileHandle, getLayout(recordDescriptor), data, rid);
 }
 
 // update record
@@ -232,23 +358,18 @@ RC RecordBasedFileManager::deleteRecord(FileHandle &fileHandle, const vector<Att
 // Larger but fits: remove, reorganize, setRecordAtOffset
 // Larger dnf: remove, reorganize, insert into new page and update slot info
 // same: do nothing
-RC RecordBasedFileManager::updateRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const void *data, const RID &rid)
+RC RecordBasedFileManager::updateRecord(FileHandle &fileHandle, const RecordLayout &layout, const void *data, const RID &rid)
 {
     // Retrieve the specific page
-    void *pageData = malloc(PAGE_SIZE);
-    if (fileHandle.readPage(rid.pageNum, pageData))
-    {
-        free(pageData);
+    PageHandle page;
+    if (_buffer_manager->pinPage(fileHandle, rid.pageNum, page))
         return RBFM_READ_FAILED;
-    }
+    void *pageData = page.getData();
 
     // Checks if the specific slot id exists in the page
     SlotDirectoryHeader slotHeader = getSlotDirectoryHeader(pageData);
     if(slotHeader.recordEntriesNumber <= rid.slotNum)
-    {
-        free(pageData);
         return RBFM_SLOT_DN_EXIST;
-    }
 
     // Gets the slot directory record entry data
     SlotDirectoryRecordEntry recordEntry = getSlotDirectoryRecordEntry(pageData, rid.slotNum);
@@ -258,37 +379,35 @@ RC RecordBasedFileManager::updateRecord(FileHandle &fileHandle, const vector<Att
     {
         // Error to update a deleted record
         case DEAD:
-            free(pageData);
             return RBFM_READ_AFTER_DEL;
-        // Get the forwarding address from the record entry and recurse
+        // Update the record where it was forwarded to, keeping the home slot pointing at it
         case MOVED:
-            free(pageData);
-            RID newRid;
-            newRid.pageNum = recordEntry.length;
-            newRid.slotNum = -recordEntry.offset;
-            return updateRecord(fileHandle, recordDescriptor, data, newRid);
+            return updateForwardedRecord(fileHandle, layout, data, rid, page);
         default:
         break;
     }
     // Do actual work
     // Gets the size of the updated record
-    unsigned recordSize = getRecordSize(recordDescriptor, data);
+    unsigned recordSize = getRecordSize(layout, data);
     if (recordSize  == recordEntry.length)
     {
-        setRecordAtOffset(pageData, recordEntry.offset, recordDescriptor, data);
-        RC rc = fileHandle.writePage(rid.pageNum, pageData);
-        free(pageData);
-        return rc;
+        setRecordAtOffset(pageData, recordEntry.offset, layout, data);
+        if (page.markDirty())
+            return RBFM_WRITE_FAILED;
+        return updateZoneMap(fileHandle, rid.pageNum, pageData, layout, rid.slotNum, rid.slotNum + 1);
     }
     else if (recordSize < recordEntry.length)
     {
-        setRecordAtOffset(pageData, recordEntry.offset, recordDescriptor, data);
+        setRecordAtOffset(pageData, recordEntry.offset, layout, data);
         recordEntry.length = recordSize;
         setSlotDirectoryRecordEntry(pageData, rid.slotNum, recordEntry);
-        reorganizePage(pageData);
-        RC rc = fileHandle.writePage(rid.pageNum, pageData);
-        free(pageData);
-        return rc;
+        reorganizePage(pageData, fileHandle.getPageSize());
+        if (page.markDirty())
+            return RBFM_WRITE_FAILED;
+        RC rc = updateFreeSpaceMap(fileHandle, rid.pageNum, pageData);
+        if (rc)
+            return rc;
+        return updateZoneMap(fileHandle, rid.pageNum, pageData, layout, rid.slotNum, rid.slotNum + 1);
     }
     else if (recordSize > recordEntry.length)
     {
@@ -297,43 +416,195 @@ RC RecordBasedFileManager::updateRecord(FileHandle &fileHandle, const vector<Att
         {
             // Need to insert then set forward address then reorganize
             RID newRid;
-            RC rc = insertRecord(fileHandle, recordDescriptor, data, newRid);
+            RC rc = insertRecord(fileHandle, layout, data, newRid);
             if (rc != SUCCESS)
-            {
-                free(pageData);
                 return rc;
-            }
             recordEntry.length = newRid.pageNum;
             recordEntry.offset = -newRid.slotNum;
             setSlotDirectoryRecordEntry(pageData, rid.slotNum, recordEntry);
-            reorganizePage(pageData);
+            reorganizePage(pageData, fileHandle.getPageSize());
         }
         else
         {
             // Need to set header to DEAD and reorganize to consolidate free space
-            recordEntry.length = 0;
-            recordEntry.offset = 0;
-            setSlotDirectoryRecordEntry(pageData, rid.slotNum, recordEntry);
-            reorganizePage(pageData);
+            markSlotDeleted(pageData, rid.slotNum);
+            reorganizePage(pageData, fileHandle.getPageSize());
 
-            // Get updated slotHeader with new free space pointer
-            slotHeader = getSlotDirectoryHeader(pageData);
-            // Update record length and offset
-            recordEntry.length = recordSize;
-            recordEntry.offset = slotHeader.freeSpaceOffset - recordSize;
-            setSlotDirectoryRecordEntry(pageData, rid.slotNum, recordEntry);
+            // Add new record data in the consolidated free space
+            setRecordInSlot(pageData, rid.slotNum, layout, data, recordSize);
+            RC rc = updateZoneMap(fileHandle, rid.pageNum, pageData, layout, rid.slotNum, rid.slotNum + 1);
+            if (rc)
+                return rc;
+        }
+    }
+    if (page.markDirty())
+        return RBFM_WRITE_FAILED;
+    return updateFreeSpaceMap(fileHandle, rid.pageNum, pageData);
+}
+
+// Updates a record forwarded away from its home slot, which is pinned in page. The record
+// comes back home if the page has room for it now, stays where it is if it still fits
+// there, and otherwise moves on to another page. Either way the home slot ends up pointing
+// straight at it and the slots it leaves are freed, so chains never grow past one hop.
+RC RecordBasedFileManager::updateForwardedRecord(FileHandle &fileHandle, const RecordLayout &layout, const void *data,
+                                                 const RID &rid, PageHandle &page)
+{
+    void *pageData = page.getData();
+    RID target;
+    vector<RID> hops;
+    RC rc = findForwardedRecord(fileHandle, getSlotDirectoryRecordEntry(pageData, rid.slotNum), target, hops);
+    if (rc)
+        return rc;
 
-            // Update header with new free space pointer
-            slotHeader.freeSpaceOffset = recordEntry.offset;
-            setSlotDirectoryHeader(pageData, slotHeader);
+    unsigned recordSize = getRecordSize(layout, data);
+    if (recordSize <= getPageFreeSpaceSize(pageData))
+    {
+        // The home slot already has its directory entry, only the record needs room
+        setRecordInSlot(pageData, rid.slotNum, layout, data, recordSize);
+        if (page.markDirty())
+            return RBFM_WRITE_FAILED;
+        hops.push_back(target);
+        rc = updateZoneMap(fileHandle, rid.pageNum, pageData, layout, rid.slotNum, rid.slotNum + 1);
+    }
+    else
+    {
+        PageHandle targetPage;
+        if (_buffer_manager->pinPage(fileHandle, target.pageNum, targetPage))
+            return RBFM_READ_FAILED;
+        void *targetData = targetPage.getData();
+        unsigned space = getPageFreeSpaceSize(targetData) + getSlotDirectoryRecordEntry(targetData, target.slotNum).length;
+        targetPage.unpin();
 
-            // Add new record data
-            setRecordAtOffset (pageData, recordEntry.offset, recordDescriptor, data);
+        RID newRid = target;
+        if (recordSize <= space)
+        {
+            // The target slot is valid and has room, so this update doesn't move it
+            rc = updateRecord(fileHandle, layout, data, target);
+        }
+        else
+        {
+            rc = insertRecord(fileHandle, layout, data, newRid);
+            hops.push_back(target);
         }
+        if (rc)
+            return rc;
+
+        SlotDirectoryRecordEntry recordEntry;
+        recordEntry.length = newRid.pageNum;
+        recordEntry.offset = -newRid.slotNum;
+        setSlotDirectoryRecordEntry(pageData, rid.slotNum, recordEntry);
+        if (page.markDirty())
+            return RBFM_WRITE_FAILED;
     }
-    RC rc = fileHandle.writePage(rid.pageNum, pageData);
-    free(pageData);
-    return rc;
+
+    for (size_t i = 0; i < hops.size() && rc == SUCCESS; i++)
+        rc = freeForwardedSlot(fileHandle, hops[i]);
+    if (rc)
+        return rc;
+    return updateFreeSpaceMap(fileHandle, rid.pageNum, pageData);
+}
+
+RC RecordBasedFileManager::deforwardRecords(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, PageNum &pageNum, unsigned maxPages)
+{
+    return deforwardRecords(fileHandle, getLayout(recordDescriptor), pageNum, maxPages);
+}
+
+// Looks for forwarding addresses in each page and copies the records they lead to back
+// into their home slots, as stored, when the page has room. Records that still don't fit
+// at least get their chains cut down to one hop.
+RC RecordBasedFileManager::deforwardRecords(FileHandle &fileHandle, const RecordLayout &layout, PageNum &pageNum, unsigned maxPages)
+{
+    unsigned pageSize = fileHandle.getPageSize();
+    for (PageNum end = pageNum + maxPages; pageNum < end && pageNum < fileHandle.getNumberOfPages(); pageNum++)
+    {
+        if (!isRecordBasedPage(pageNum, pageSize))
+            continue;
+
+        PageHandle page;
+        if (_buffer_manager->pinPage(fileHandle, pageNum, page))
+            return RBFM_READ_FAILED;
+        void *pageData = page.getData();
+        unsigned numSlots = getSlotDirectoryHeader(pageData).recordEntriesNumber;
+
+        bool changed = false;
+        RC rc = SUCCESS;
+        for (unsigned slotNum = 0; slotNum < numSlots && rc == SUCCESS; slotNum++)
+        {
+            SlotDirectoryRecordEntry recordEntry = getSlotDirectoryRecordEntry(pageData, slotNum);
+            if (getSlotStatus(recordEntry) != MOVED)
+                continue;
+
+            // Forwarding addresses that lead nowhere are left alone, deleteRecord() reports them
+            RID target;
+            vector<RID> hops;
+            rc = findForwardedRecord(fileHandle, recordEntry, target, hops);
+            if (rc == RBFM_READ_FAILED)
+                break;
+            if (rc)
+            {
+                rc = SUCCESS;
+                continue;
+            }
+
+            PageHandle targetPage;
+            if (_buffer_manager->pinPage(fileHandle, target.pageNum, targetPage))
+            {
+                rc = RBFM_READ_FAILED;
+                break;
+            }
+            void *targetData = targetPage.getData();
+            SlotDirectoryRecordEntry targetEntry = getSlotDirectoryRecordEntry(targetData, target.slotNum);
+
+            if (targetEntry.length <= getPageFreeSpaceSize(pageData))
+            {
+                SlotDirectoryHeader slotHeader = getSlotDirectoryHeader(pageData);
+                SlotDirectoryHeader oldHeader = slotHeader;
+                SlotDirectoryRecordEntry oldEntry = recordEntry;
+                recordEntry.length = targetEntry.length;
+                recordEntry.offset = slotHeader.freeSpaceOffset - targetEntry.length;
+                memcpy((char*) pageData + recordEntry.offset, (char*) targetData + targetEntry.offset, targetEntry.length);
+                slotHeader.freeSpaceOffset = recordEntry.offset;
+                setSlotDirectoryHeader(pageData, slotHeader);
+                setSlotDirectoryRecordEntry(pageData, slotNum, recordEntry);
+                hops.push_back(target);
+                rc = updateZoneMap(fileHandle, pageNum, pageData, layout, slotNum, slotNum + 1);
+                if (rc)
+                {
+                    // The copy stays at the forwarded address, or scans would see the record twice
+                    setSlotDirectoryRecordEntry(pageData, slotNum, oldEntry);
+                    setSlotDirectoryHeader(pageData, oldHeader);
+                    break;
+                }
+            }
+            else if (!hops.empty())
+            {
+                recordEntry.length = target.pageNum;
+                recordEntry.offset = -target.slotNum;
+                setSlotDirectoryRecordEntry(pageData, slotNum, recordEntry);
+            }
+            else
+            {
+                continue;
+            }
+            changed = true;
+            targetPage.unpin();
+
+            for (size_t i = 0; i < hops.size() && rc == SUCCESS; i++)
+                rc = freeForwardedSlot(fileHandle, hops[i]);
+        }
+
+        if (changed)
+        {
+            RC writeRc = page.markDirty();
+            if (rc == SUCCESS && writeRc)
+                rc = RBFM_WRITE_FAILED;
+            if (rc == SUCCESS)
+                rc = updateFreeSpaceMap(fileHandle, pageNum, pageData);
+        }
+        if (rc)
+            return rc;
+    }
+    return SUCCESS;
 }
 
 RC RecordBasedFileManager::printRecord(const vector<Attribute> &recordDescriptor, const void *data) 
@@ -402,14 +673,15 @@ RC RecordBasedFileManager::printRecord(const vector<Attribute> &recordDescriptor
 
 RC RecordBasedFileManager::readAttribute(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const RID &rid, const string &attributeName, void *data)
 {
-    char *pageData = (char*)malloc(PAGE_SIZE);
-    if (pageData == NULL)
-        return RBFM_MALLOC_FAILED;
-    if (fileHandle.readPage(rid.pageNum, pageData) != SUCCESS)
-    {
-        free(pageData);
+    return readAttribute(fileHandle, getLayout(recordDescriptor), rid, attributeName, data);
+}
+
+RC RecordBasedFileManager::readAttribute(FileHandle &fileHandle, const RecordLayout &layout, const RID &rid, const string &attributeName, void *data)
+{
+    PageHandle page;
+    if (_buffer_manager->pinPage(fileHandle, rid.pageNum, page) != SUCCESS)
         return RBFM_READ_FAILED;
-    }
+    void *pageData = page.getData();
     // Get record header, recurse if forwarded
     // Checks if the specific slot id exists in the page
     SlotDirectoryHeader slotHeader = getSlotDirectoryHeader(pageData);
@@ -424,15 +696,14 @@ RC RecordBasedFileManager::readAttribute(FileHandle &fileHandle, const vector<At
     {
         // Error to get attribute of a deleted record
         case DEAD:
-            free(pageData);
             return RBFM_READ_AFTER_DEL;
         // Get the forwarding address from the record entry and recurse
         case MOVED:
-            free(pageData);
+            page.unpin();
             RID newRid;
             newRid.pageNum = recordEntry.length;
             newRid.slotNum = -recordEntry.offset;
-            return readAttribute(fileHandle, recordDescriptor, newRid, attributeName, data);
+            return readAttribute(fileHandle, layout, newRid, attributeName, data);
         default:
         break;
     }
@@ -440,15 +711,12 @@ RC RecordBasedFileManager::readAttribute(FileHandle &fileHandle, const vector<At
     // Get offset to record
     unsigned offset = recordEntry.offset;
     // Get index and type of attribute
-    auto pred = [&](Attribute a) {return a.name == attributeName;};
-    auto iterPos = find_if(recordDescriptor.begin(), recordDescriptor.end(), pred);
-    unsigned index = distance(recordDescriptor.begin(), iterPos);
-    if (index == recordDescriptor.size())
+    unsigned index = layout.getAttributeIndex(attributeName);
+    if (index == layout.getNumberOfAttributes())
         return RBFM_NO_SUCH_ATTR;
-    AttrType type = recordDescriptor[index].type;
+    AttrType type = layout.recordDescriptor[index].type;
     // Write attribute to data
     getAttributeFromRecord(pageData, offset, index, type, data);
-    free(pageData);
     return SUCCESS;
 }
 
@@ -461,72 +729,176 @@ RC RecordBasedFileManager::readAttribute(FileHandle &fileHandle, const vector<At
       const vector<string> &attributeNames, // a list of projected attributes
       RBFM_ScanIterator &rbfm_ScanIterator)
 {
-    return rbfm_ScanIterator.scanInit(fileHandle, recordDescriptor, conditionAttribute, compOp, value, attributeNames);
+    return scan(fileHandle, RecordLayout(recordDescriptor, attributeNames), conditionAttribute, compOp, value, rbfm_ScanIterator);
+}
+
+RC RecordBasedFileManager::scan(FileHandle &fileHandle,
+      const RecordLayout &layout,
+      const string &conditionAttribute,
+      const CompOp compOp,
+      const void *value,
+      RBFM_ScanIterator &rbfm_ScanIterator)
+{
+    ScanCondition condition = {conditionAttribute, compOp, value};
+    return rbfm_ScanIterator.scanInit(fileHandle, layout, vector<vector<ScanCondition> >(1, vector<ScanCondition>(1, condition)));
+}
+
+RC RecordBasedFileManager::scan(FileHandle &fileHandle,
+      const vector<Attribute> &recordDescriptor,
+      const vector<vector<ScanCondition> > &conditions,
+      const vector<string> &attributeNames,
+      RBFM_ScanIterator &rbfm_ScanIterator)
+{
+    return rbfm_ScanIterator.scanInit(fileHandle, RecordLayout(recordDescriptor, attributeNames), conditions);
+}
+
+RC RecordBasedFileManager::scan(FileHandle &fileHandle,
+      const RecordLayout &layout,
+      const vector<vector<ScanCondition> > &conditions,
+      RBFM_ScanIterator &rbfm_ScanIterator)
+{
+    return rbfm_ScanIterator.scanInit(fileHandle, layout, conditions);
+}
+
+RC RecordBasedFileManager::parallelScan(FileHandle &fileHandle,
+      const vector<Attribute> &recordDescriptor,
+      const vector<vector<ScanCondition> > &conditions,
+      const vector<string> &attributeNames,
+      unsigned numThreads,
+      const ScanBatchCallback &callback)
+{
+    return parallelScan(fileHandle, RecordLayout(recordDescriptor, attributeNames), conditions, numThreads, callback);
+}
+
+// Every worker runs a scan iterator of its own over one morsel after the other, taking
+// the next morsel from a shared counter, so workers that finish early simply do more
+RC RecordBasedFileManager::parallelScan(FileHandle &fileHandle,
+      const RecordLayout &layout,
+      const vector<vector<ScanCondition> > &conditions,
+      unsigned numThreads,
+      const ScanBatchCallback &callback)
+{
+    if (numThreads == 0)
+        numThreads = max(thread::hardware_concurrency(), 1u);
+
+    // Page 0 is the FSM root, record pages start after it
+    PageNum totalPage = fileHandle.getNumberOfPages();
+    atomic<PageNum> nextMorsel(FSM_ROOT_PAGE + 1);
+    atomic<bool> stop(false);
+    mutex errorMutex;
+    RC error = SUCCESS;
+
+    // Workers scan through copies of the handle. Mapping the whole file up front
+    // keeps each of them from extending the mapping on its own.
+    if (fileHandle.isMapped())
+    {
+        RC rc = fileHandle.extendMapping();
+        if (rc)
+            return rc;
+    }
+
+    auto worker = [&](unsigned workerNum)
+    {
+        RBFM_ScanIterator iterator;
+        RecordBatch batch;
+        RC rc = iterator.scanInit(fileHandle, layout, conditions);
+        while (rc == SUCCESS && !stop)
+        {
+            PageNum first = nextMorsel.fetch_add(RBFM_MORSEL_PAGES);
+            if (first >= totalPage)
+                break;
+            iterator.setPageRange(first, min(first + RBFM_MORSEL_PAGES, totalPage));
+            RC scanRc = SUCCESS;
+            while (!stop && (scanRc = iterator.getNextBatch(batch)) == SUCCESS)
+            {
+                rc = callback(workerNum, batch);
+                if (rc)
+                    break;
+            }
+            // Only the iterator running out of pages ends a morsel quietly, whatever
+            // the callback returns other than SUCCESS stops the scan and is returned
+            if (rc == SUCCESS && scanRc != RBFM_EOF)
+                rc = scanRc;
+        }
+        iterator.close();
+
+        if (rc)
+        {
+            lock_guard<mutex> lock(errorMutex);
+            if (error == SUCCESS)
+                error = rc;
+            stop = true;
+        }
+    };
+
+    vector<thread> threads;
+    for (unsigned i = 0; i < numThreads; i++)
+        threads.push_back(thread(worker, i));
+    for (thread &t : threads)
+        t.join();
+    return error;
 }
 
 RBFM_ScanIterator::RBFM_ScanIterator()
-: currPage(0), currSlot(0), totalPage(0), totalSlot(0)
+: currPage(0), currSlot(0), totalPage(0), totalSlot(0), pageData(NULL),
+  lastPage(0), readAheadEnd(0), readAheadMark(0), readAheadWindow(RBFM_SCAN_READ_AHEAD_MIN),
+  fileVersion(NULL), selectedVersion(0)
 {
     rbfm = RecordBasedFileManager::instance();
+    scanZoneMap.data = readAheadZoneMap.data = NULL;
+    scanZoneMap.pageNum = readAheadZoneMap.pageNum = 0;
 }
 
 RC RBFM_ScanIterator::close()
 {
-    free(pageData);
+    page.unpin();
+    pageData = NULL;
+    scanZoneMap.page.unpin();
+    scanZoneMap.data = NULL;
+    readAheadZoneMap.page.unpin();
+    readAheadZoneMap.data = NULL;
     return SUCCESS;
 }
 
 // Initialize the scanIterator with all necessary state
 RC RBFM_ScanIterator::scanInit(FileHandle &fh,
-        const vector<Attribute> rd,
-        const string &ca, 
-        const CompOp co, 
-        const void *v, 
-        const vector<string> &an)
+        const RecordLayout &l,
+        const vector<vector<ScanCondition> > &conditions)
 {
     // Start at page 0 slot 0
     currPage = 0;
     currSlot = 0;
     totalPage = 0;
     totalSlot = 0;
-    // Keep a buffer to hold the current page
-    pageData = malloc(PAGE_SIZE);
+    // The current page stays pinned in the buffer pool while we scan it.
+    // Page 0 is never a record page, so the first getNextSlot() moves on to the first one.
+    page.unpin();
+    pageData = NULL;
+    lastPage = 0;
+    readAheadEnd = 0;
+    readAheadMark = 0;
+    readAheadWindow = RBFM_SCAN_READ_AHEAD_MIN;
+    scanZoneMap.page.unpin();
+    scanZoneMap.data = NULL;
+    readAheadZoneMap.page.unpin();
+    readAheadZoneMap.data = NULL;
 
     // Store the variables passed in to
     fileHandle = fh;
-    conditionAttribute = ca;
-    recordDescriptor = rd;
-    compOp = co;
-    value = v;
-    attributeNames = an;
-
-    skipList.clear();
+    layout = l;
 
     // Get total number of pages
     totalPage = fh.getNumberOfPages();
-    if (totalPage > 0)
-    {
-        if (fh.readPage(0, pageData))
-            return RBFM_READ_FAILED;
-    }
-    else
-        return SUCCESS;
-
-    // Get number of slots on first page
-    SlotDirectoryHeader header = rbfm->getSlotDirectoryHeader(pageData);
-    totalSlot = header.recordEntriesNumber;
-
-    // If we don't need to do any comparisons, we can ignore the condition attribute
-    if (co == NO_OP)
-        return SUCCESS;
-
-    // Else, we need to find the condition attribute's index in the record descriptor
-    auto pred = [&](Attribute a) {return a.name == conditionAttribute;};
-    auto iterPos = find_if(recordDescriptor.begin(), recordDescriptor.end(), pred);
-    attrIndex = distance(recordDescriptor.begin(), iterPos);
-    if (attrIndex == recordDescriptor.size())
-        return RBFM_NO_SUCH_ATTR;
+    fileVersion = rbfm->_buffer_manager->getFileVersion(fileHandle);
 
+    // The conditions are compiled against the descriptor once for the whole scan, and
+    // get room for testing the fullest page there can be
+    RC rc = filter.compile(layout, conditions);
+    if (rc)
+        return rc;
+    unsigned pageSize = fh.getPageSize();
+    filter.setMaxSlots((pageSize - sizeof(SlotDirectoryHeader)) / sizeof(SlotDirectoryRecordEntry));
+    selection.reserve((pageSize - sizeof(SlotDirectoryHeader)) / sizeof(SlotDirectoryRecordEntry));
     return SUCCESS;
 }
 
@@ -537,7 +909,8 @@ RC RBFM_ScanIterator::getNextRecord(RID &rid, void *data)
         return rc;
 
     // If we are not returning any results, we can just set the RID and return
-    if (attributeNames.size() == 0)
+    const vector<unsigned> &projection = layout.projection;
+    if (projection.size() == 0)
     {
         rid.pageNum = currPage;
         rid.slotNum = currSlot++;
@@ -545,231 +918,1534 @@ RC RBFM_ScanIterator::getNextRecord(RID &rid, void *data)
     }
 
     // Prepare null indicator
-    unsigned nullIndicatorSize = rbfm->getNullIndicatorSize(attributeNames.size());
+    unsigned nullIndicatorSize = layout.projectionNullIndicatorSize;
     char nullIndicator[nullIndicatorSize];
     memset(nullIndicator, 0, nullIndicatorSize);
 
     SlotDirectoryRecordEntry recordEntry = rbfm->getSlotDirectoryRecordEntry(pageData, currSlot);
-
-    // Unsure how large each attribute will be, set to size of page to be safe
-    void *buffer = malloc(PAGE_SIZE);
-    if (buffer == NULL)
-        return RBFM_MALLOC_FAILED;
+    const char *record = (const char*) pageData + recordEntry.offset;
 
     // Keep track of offset into data
     unsigned dataOffset = nullIndicatorSize;
 
-    for (unsigned i = 0; i < attributeNames.size(); i++)
+    // Copy each attribute straight from the page into data
+    for (unsigned i = 0; i < projection.size(); i++)
     {
-        // Get index and type of attribute in record
-        auto pred = [&](Attribute a) {return a.name == attributeNames[i];};
-        auto iterPos = find_if(recordDescriptor.begin(), recordDescriptor.end(), pred);
-        unsigned index = distance(recordDescriptor.begin(), iterPos);
-        if (index == recordDescriptor.size())
+        unsigned index = projection[i];
+        if (index == layout.getNumberOfAttributes())
             return RBFM_NO_SUCH_ATTR;
-        AttrType type = recordDescriptor[index].type;
-
-        // Read attribute into buffer
-        rbfm->getAttributeFromRecord(pageData, recordEntry.offset, index, type, buffer);
-        // Determine if null
-        char null;
-        memcpy (&null, buffer, 1);
-        if (null)
+
+        unsigned length;
+        const char *value = rbfm->findAttribute(record, index, length);
+        if (value == NULL)
         {
             int indicatorIndex = i / CHAR_BIT;
             char indicatorMask  = 1 << (CHAR_BIT - 1 - (i % CHAR_BIT));
             nullIndicator[indicatorIndex] |= indicatorMask;
+            continue;
         }
-        // Read from buffer into data
-        else if (type == TypeInt)
-        {
-            memcpy ((char*)data + dataOffset, (char*)buffer + 1, INT_SIZE);
-            dataOffset += INT_SIZE;
-        }
-        else if (type == TypeReal)
+        if (layout.recordDescriptor[index].type == TypeVarChar)
         {
-            memcpy ((char*)data + dataOffset, (char*)buffer + 1, REAL_SIZE);
-            dataOffset += REAL_SIZE;
+            uint32_t varcharSize = length;
+            memcpy((char*)data + dataOffset, &varcharSize, VARCHAR_LENGTH_SIZE);
+            dataOffset += VARCHAR_LENGTH_SIZE;
         }
-        else if (type == TypeVarChar)
+        memcpy((char*)data + dataOffset, value, length);
+        dataOffset += length;
+    }
+    // Finally set null indicator of data and return
+    memcpy((char*)data, nullIndicator, nullIndicatorSize);
+
+    rid.pageNum = currPage;
+    rid.slotNum = currSlot++;
+    return SUCCESS;
+}
+
+RC RBFM_ScanIterator::getNextRecordView(RID &rid, RecordView &view)
+{
+    RC rc = getNextSlot();
+    if (rc)
+        return rc;
+
+    // A view already on this page keeps it, a page lent by the mapping needs no pin
+    if (view.record == NULL || view.fileHandle != &fileHandle || view.pageNum != currPage)
+    {
+        view.release();
+        if (page.getData() == pageData && rbfm->_buffer_manager->pinPage(fileHandle, currPage, view.page))
+            return RBFM_READ_FAILED;
+        view.fileHandle = &fileHandle;
+        view.pageNum = currPage;
+    }
+    SlotDirectoryRecordEntry recordEntry = rbfm->getSlotDirectoryRecordEntry(pageData, currSlot);
+    view.record = (const char*) pageData + recordEntry.offset;
+
+    rid.pageNum = currPage;
+    rid.slotNum = currSlot++;
+    return SUCCESS;
+}
+
+// Decodes records straight from their pages into the columns of the batch
+RC RBFM_ScanIterator::getNextBatch(RecordBatch &batch, unsigned maxRows)
+{
+    const vector<unsigned> &projection = layout.projection;
+    batch.reset(layout, maxRows);
+
+    while (batch.numRows < maxRows)
+    {
+        RC rc = getNextSlot();
+        if (rc == RBFM_EOF)
+            break;
+        if (rc)
+            return rc;
+
+        unsigned row = batch.numRows;
+        SlotDirectoryRecordEntry recordEntry = rbfm->getSlotDirectoryRecordEntry(pageData, currSlot);
+        const char *record = (const char*) pageData + recordEntry.offset;
+
+        for (unsigned i = 0; i < projection.size(); i++)
+        {
+            unsigned index = projection[i];
+            if (index == layout.getNumberOfAttributes())
+                return RBFM_NO_SUCH_ATTR;
+
+            RecordBatch::Column &column = batch.columns[i];
+            unsigned length;
+            const char *value = rbfm->findAttribute(record, index, length);
+            if (value == NULL)
+                column.nulls[row / CHAR_BIT] |= 1 << (CHAR_BIT - 1 - (row % CHAR_BIT));
+
+            switch (column.type)
+            {
+                case TypeInt:
+                    column.ints[row] = 0;
+                    if (value != NULL)
+                        memcpy(&column.ints[row], value, INT_SIZE);
+                break;
+                case TypeReal:
+                    column.reals[row] = 0;
+                    if (value != NULL)
+                        memcpy(&column.reals[row], value, REAL_SIZE);
+                break;
+                case TypeVarChar:
+                    column.bytes.insert(column.bytes.end(), value, value + length);
+                    column.offsets[row + 1] = column.bytes.size();
+                break;
+            }
+        }
+
+        batch.rids[row].pageNum = currPage;
+        batch.rids[row].slotNum = currSlot++;
+        batch.numRows++;
+    }
+    return batch.numRows == 0 ? RBFM_EOF : SUCCESS;
+}
+
+// Private helper methods ///////////////////////////////////////////////////////////////////
+
+// Restricts the scan to pages [first, end), first being past the FSM root. The next
+// getNextSlot() moves on to page first.
+void RBFM_ScanIterator::setPageRange(PageNum first, PageNum end)
+{
+    currPage = first - 1;
+    currSlot = 0;
+    totalSlot = 0;
+    totalPage = end;
+}
+
+// Looks the page up in its zone map. Zone map pages stay pinned (or borrowed from a
+// mapped file) while the scan goes through the pages they describe. A zone map that
+// can't be read just means the page has to be read.
+bool RBFM_ScanIterator::pageMayMatch(PageNum pageNum, ZoneMapCursor &cursor)
+{
+    if (!filter.usesZoneMaps())
+        return true;
+
+    unsigned pageSize = fileHandle.getPageSize();
+    unsigned entry;
+    PageNum zonePageNum = rbfm->getZoneMapPage(pageNum, pageSize, entry);
+    if (cursor.data == NULL || cursor.pageNum != zonePageNum)
+    {
+        const void *borrowed;
+        cursor.data = NULL;
+        if (fileHandle.isMapped() && fileHandle.borrowPage(zonePageNum, borrowed) == SUCCESS)
+        {
+            cursor.page.unpin();
+            cursor.data = (const char*) borrowed;
+        }
+        else if (rbfm->_buffer_manager->pinPage(fileHandle, zonePageNum, cursor.page))
+            return true;
+        else
+            cursor.data = (const char*) cursor.page.getData();
+        cursor.pageNum = zonePageNum;
+    }
+    return filter.mayMatch(cursor.data + entry * ZONE_MAP_ENTRY_SIZE(pageSize), pageSize);
+}
+
+RC RBFM_ScanIterator::getNextSlot()
+{
+    while (true)
+    {
+        // If we're done with the current page, or we've read the last page
+        if (currSlot >= totalSlot || currPage >= totalPage)
+        {
+            // Reinitialize the current slot and increment page number
+            currSlot = 0;
+            currPage++;
+            // Free space map and zone map pages don't hold records, and the zone
+            // maps tell which record pages can't hold a match
+            while (currPage < totalPage && (!rbfm->isRecordBasedPage(currPage, fileHandle.getPageSize())
+                                            || !pageMayMatch(currPage, scanZoneMap)))
+                currPage++;
+            // If we're done with last page, return EOF
+            if (currPage >= totalPage)
+                return RBFM_EOF;
+            // Otherwise get next page ready
+            RC rc = getNextPage();
+            if (rc)
+                return rc;
+            continue;
+        }
+
+        // The page was tested when it was read, but it is the live page rather than a
+        // copy. Once anything in the file has changed since, the record may have been
+        // updated, or its slot freed and reused, so a selected slot is checked against
+        // the filter again before it is returned.
+        if (selection[currSlot])
+        {
+            if (__atomic_load_n(fileVersion, __ATOMIC_ACQUIRE) == selectedVersion)
+                return SUCCESS;
+            SlotDirectoryRecordEntry recordEntry = rbfm->getSlotDirectoryRecordEntry(pageData, currSlot);
+            if (rbfm->getSlotStatus(recordEntry) == VALID
+                && filter.matches((const char*) pageData + recordEntry.offset))
+                return SUCCESS;
+        }
+
+        // If not, try next slot
+        currSlot++;
+    }
+}
+
+RC RBFM_ScanIterator::getNextPage()
+{
+    readAhead();
+
+    // A mapped file lends us the page in place, so it is never copied into the pool.
+    // Pages it can't lend (e.g. past the mapping) are pinned as usual.
+    const void *borrowed;
+    if (fileHandle.isMapped() && fileHandle.borrowPage(currPage, borrowed) == SUCCESS)
+    {
+        page.unpin();
+        pageData = (void*) borrowed;
+    }
+    // Pin the next page, which also releases the previous one
+    else if (rbfm->_buffer_manager->pinPage(fileHandle, currPage, page))
+        return RBFM_READ_FAILED;
+    else
+        pageData = page.getData();
+
+    // Update slot total, and test the whole page against the filter at once. Changes
+    // made from here on make getNextSlot() test records again.
+    selectedVersion = __atomic_load_n(fileVersion, __ATOMIC_ACQUIRE);
+    SlotDirectoryHeader header = rbfm->getSlotDirectoryHeader(pageData);
+    totalSlot = header.recordEntriesNumber;
+    filter.selectPage(pageData, totalSlot, selection);
+    return SUCCESS;
+}
+
+// Reads ahead of a sequential scan. Once the scan gets halfway through the current
+// window the next, twice as large, window is requested. Any other access pattern
+// starts over with the smallest window. Read-ahead is only a hint, so failures
+// show up when the page itself is read.
+void RBFM_ScanIterator::readAhead()
+{
+    // Skipping an FSM page right at the end of the window still counts as in order
+    bool sequential = currPage > lastPage && currPage <= readAheadEnd + 1;
+    lastPage = currPage;
+    if (!sequential)
+    {
+        readAheadWindow = RBFM_SCAN_READ_AHEAD_MIN;
+        readAheadEnd = currPage;
+    }
+    else if (currPage < readAheadMark)
+        return;
+    else
+        readAheadWindow = min(readAheadWindow * 2, (uint32_t) RBFM_SCAN_READ_AHEAD_MAX);
+
+    PageNum first = max(currPage, readAheadEnd);
+    PageNum end = min(first + readAheadWindow, totalPage);
+
+    // Only the record pages the zone maps don't rule out are worth reading
+    vector<PageNum> pageNums;
+    for (PageNum pageNum = first; pageNum < end; pageNum++)
+    {
+        if (rbfm->isRecordBasedPage(pageNum, fileHandle.getPageSize()) && pageMayMatch(pageNum, readAheadZoneMap))
+            pageNums.push_back(pageNum);
+    }
+
+    // Without a mapping the window is read into the buffer pool, as long as it leaves
+    // most of the pool to everybody else. A window cut short ends at its last page, so
+    // the next one starts right after it.
+    bool mapped = fileHandle.isMapped();
+    unsigned limit = rbfm->_buffer_manager->getNumberOfFrames() / 4;
+    if (!mapped && pageNums.size() > limit)
+    {
+        pageNums.resize(limit);
+        end = pageNums.empty() ? first : pageNums.back() + 1;
+    }
+    readAheadEnd = end;
+    readAheadMark = first + (end - first) / 2;
+    if (pageNums.empty())
+        return;
+
+    // A mapped file is read in the background by the kernel, a run of pages at a time
+    if (mapped)
+    {
+        for (size_t i = 0, j; i < pageNums.size(); i = j)
+        {
+            for (j = i + 1; j < pageNums.size() && pageNums[j] == pageNums[j - 1] + 1; j++);
+            fileHandle.readAhead(pageNums[i], j - i);
+        }
+        return;
+    }
+    rbfm->_buffer_manager->prefetchPages(fileHandle, pageNums);
+}
+
+// Scan predicates /////////////////////////////////////////////////////////////////////////
+
+// Copies the summarized form of a value: ints and reals as they are, varchars cut to
+// their first bytes or padded with zeros
+static void getZoneMapValue(AttrType type, const char *value, unsigned length, char *zoneValue)
+{
+    if (type != TypeVarChar)
+    {
+        memcpy(zoneValue, value, ZONE_MAP_VALUE_SIZE);
+        return;
+    }
+    memset(zoneValue, 0, ZONE_MAP_VALUE_SIZE);
+    memcpy(zoneValue, value, min(length, (unsigned) ZONE_MAP_VALUE_SIZE));
+}
+
+// Three-way comparison of two summarized values
+static int compareZoneMapValues(AttrType type, const char *a, const char *b)
+{
+    switch (type)
+    {
+        case TypeInt:
+        {
+            int32_t x, y;
+            memcpy(&x, a, INT_SIZE);
+            memcpy(&y, b, INT_SIZE);
+            return (x > y) - (x < y);
+        }
+        case TypeReal:
+        {
+            float x, y;
+            memcpy(&x, a, REAL_SIZE);
+            memcpy(&y, b, REAL_SIZE);
+            return (x > y) - (x < y);
+        }
+        case TypeVarChar:
+            return memcmp(a, b, ZONE_MAP_VALUE_SIZE);
+    }
+    return 0;
+}
+
+// Applies a comparison operator, resolved at compile time
+template <CompOp op, typename T>
+static inline bool compareValues(T recordValue, T value)
+{
+    switch (op)
+    {
+        case EQ_OP: return recordValue == value;
+        case LT_OP: return recordValue <  value;
+        case GT_OP: return recordValue >  value;
+        case LE_OP: return recordValue <= value;
+        case GE_OP: return recordValue >= value;
+        case NE_OP: return recordValue != value;
+        case NO_OP: return true;
+        // Should never happen
+        default: return false;
+    }
+}
+
+// Clears selection[i] for each of the values failing the comparison. Bit j of each
+// mask says whether value j compares equal, less or greater.
+static inline void applyComparisonMasks(CompOp compOp, unsigned eq, unsigned lt, unsigned gt,
+                                        unsigned lanes, uint8_t *selection)
+{
+    unsigned mask;
+    switch (compOp)
+    {
+        case EQ_OP: mask = eq; break;
+        case LT_OP: mask = lt; break;
+        case GT_OP: mask = gt; break;
+        case LE_OP: mask = lt | eq; break;
+        case GE_OP: mask = gt | eq; break;
+        case NE_OP: mask = ~eq; break;
+        default: mask = ~0u; break;
+    }
+    for (unsigned j = 0; j < lanes; j++)
+        selection[j] &= (mask >> j) & 1;
+}
+
+template <typename T>
+static unsigned selectValuesScalar(CompOp compOp, const T *values, unsigned count, T value, uint8_t *selection)
+{
+    for (unsigned i = 0; i < count; i++)
+    {
+        switch (compOp)
+        {
+            case EQ_OP: selection[i] &= compareValues<EQ_OP>(values[i], value); break;
+            case LT_OP: selection[i] &= compareValues<LT_OP>(values[i], value); break;
+            case GT_OP: selection[i] &= compareValues<GT_OP>(values[i], value); break;
+            case LE_OP: selection[i] &= compareValues<LE_OP>(values[i], value); break;
+            case GE_OP: selection[i] &= compareValues<GE_OP>(values[i], value); break;
+            case NE_OP: selection[i] &= compareValues<NE_OP>(values[i], value); break;
+            default: break;
+        }
+    }
+    return count;
+}
+
+#ifdef RBFM_SIMD_X86
+// Each of these compares as many whole vectors of values as there are and returns how
+// many values that was. Comparisons of reals are ordered, so a NaN is only unequal.
+
+__attribute__((target("avx2")))
+static unsigned selectIntsAVX2(CompOp compOp, const int32_t *values, unsigned count, int32_t value, uint8_t *selection)
+{
+    __m256i v = _mm256_set1_epi32(value);
+    unsigned i;
+    for (i = 0; i + 8 <= count; i += 8)
+    {
+        __m256i x = _mm256_loadu_si256((const __m256i*) (values + i));
+        unsigned eq = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(x, v)));
+        unsigned gt = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(x, v)));
+        applyComparisonMasks(compOp, eq, ~(eq | gt), gt, 8, selection + i);
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static unsigned selectRealsAVX2(CompOp compOp, const float *values, unsigned count, float value, uint8_t *selection)
+{
+    __m256 v = _mm256_set1_ps(value);
+    unsigned i;
+    for (i = 0; i + 8 <= count; i += 8)
+    {
+        __m256 x = _mm256_loadu_ps(values + i);
+        unsigned eq = _mm256_movemask_ps(_mm256_cmp_ps(x, v, _CMP_EQ_OQ));
+        unsigned lt = _mm256_movemask_ps(_mm256_cmp_ps(x, v, _CMP_LT_OQ));
+        unsigned gt = _mm256_movemask_ps(_mm256_cmp_ps(x, v, _CMP_GT_OQ));
+        applyComparisonMasks(compOp, eq, lt, gt, 8, selection + i);
+    }
+    return i;
+}
+
+static unsigned selectIntsSSE2(CompOp compOp, const int32_t *values, unsigned count, int32_t value, uint8_t *selection)
+{
+    __m128i v = _mm_set1_epi32(value);
+    unsigned i;
+    for (i = 0; i + 4 <= count; i += 4)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i*) (values + i));
+        unsigned eq = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(x, v)));
+        unsigned lt = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(x, v)));
+        unsigned gt = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(x, v)));
+        applyComparisonMasks(compOp, eq, lt, gt, 4, selection + i);
+    }
+    return i;
+}
+
+static unsigned selectRealsSSE2(CompOp compOp, const float *values, unsigned count, float value, uint8_t *selection)
+{
+    __m128 v = _mm_set1_ps(value);
+    unsigned i;
+    for (i = 0; i + 4 <= count; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(values + i);
+        unsigned eq = _mm_movemask_ps(_mm_cmpeq_ps(x, v));
+        unsigned lt = _mm_movemask_ps(_mm_cmplt_ps(x, v));
+        unsigned gt = _mm_movemask_ps(_mm_cmpgt_ps(x, v));
+        applyComparisonMasks(compOp, eq, lt, gt, 4, selection + i);
+    }
+    return i;
+}
+
+static bool hasAVX2()
+{
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+}
+#endif
+
+// Compares count gathered values at once where the CPU allows, the rest one by one
+static void selectInts(CompOp compOp, const int32_t *values, unsigned count, int32_t value, uint8_t *selection)
+{
+    unsigned done = 0;
+#ifdef RBFM_SIMD_X86
+    if (hasAVX2())
+        done = selectIntsAVX2(compOp, values, count, value, selection);
+    done += selectIntsSSE2(compOp, values + done, count - done, value, selection + done);
+#endif
+    selectValuesScalar(compOp, values + done, count - done, value, selection + done);
+}
+
+static void selectReals(CompOp compOp, const float *values, unsigned count, float value, uint8_t *selection)
+{
+    unsigned done = 0;
+#ifdef RBFM_SIMD_X86
+    if (hasAVX2())
+        done = selectRealsAVX2(compOp, values, count, value, selection);
+    done += selectRealsSSE2(compOp, values + done, count - done, value, selection + done);
+#endif
+    selectValuesScalar(compOp, values + done, count - done, value, selection + done);
+}
+
+ScanPredicate::ScanPredicate()
+: comparator(NULL), attrIndex(0), type(TypeInt), compOp(NO_OP), selectivity(1), intValue(0), realValue(0)
+{
+}
+
+RC ScanPredicate::compile(const RecordLayout &layout, const string &conditionAttribute, const CompOp co, const void *value)
+{
+    comparator = NULL;
+    compOp = co;
+    selectivity = 1;
+    varCharValue.clear();
+
+    // If we don't need to do any comparisons, we can ignore the condition attribute
+    if (compOp == NO_OP)
+        return SUCCESS;
+
+    // Else, we need to find the condition attribute's index in the record descriptor
+    attrIndex = layout.getAttributeIndex(conditionAttribute);
+    if (attrIndex == layout.getNumberOfAttributes())
+        return RBFM_NO_SUCH_ATTR;
+
+    // Nothing compares to a missing value
+    type = layout.recordDescriptor[attrIndex].type;
+    if (value == NULL)
+    {
+        comparator = compareNone;
+        selectivity = 0;
+        return SUCCESS;
+    }
+
+    switch (type)
+    {
+        case TypeInt:
+            memcpy(&intValue, value, INT_SIZE);
+        break;
+        case TypeReal:
+            memcpy(&realValue, value, REAL_SIZE);
+        break;
+        case TypeVarChar:
+            uint32_t varcharSize;
+            memcpy(&varcharSize, value, VARCHAR_LENGTH_SIZE);
+            varCharValue.assign((const char*) value + VARCHAR_LENGTH_SIZE, varcharSize);
+        break;
+    }
+
+    switch (compOp)
+    {
+        case EQ_OP: comparator = getComparator<EQ_OP>(type); break;
+        case LT_OP: comparator = getComparator<LT_OP>(type); break;
+        case GT_OP: comparator = getComparator<GT_OP>(type); break;
+        case LE_OP: comparator = getComparator<LE_OP>(type); break;
+        case GE_OP: comparator = getComparator<GE_OP>(type); break;
+        case NE_OP: comparator = getComparator<NE_OP>(type); break;
+        default: comparator = compareNone; break;
+    }
+
+    // Without statistics, the usual guesses: an equality selects few records, an
+    // inequality most of them and a range a third
+    switch (compOp)
+    {
+        case EQ_OP: selectivity = 0.1; break;
+        case NE_OP: selectivity = 0.9; break;
+        case LT_OP:
+        case GT_OP:
+        case LE_OP:
+        case GE_OP: selectivity = 1.0 / 3; break;
+        default: selectivity = 0; break;
+    }
+    return SUCCESS;
+}
+
+bool ScanPredicate::matches(const char *record) const
+{
+    if (comparator == NULL)
+        return true;
+
+    unsigned length;
+    const char *value = RecordBasedFileManager::instance()->findAttribute(record, attrIndex, length);
+    if (value == NULL)
+        return false;
+    return comparator(*this, value, length);
+}
+
+void ScanPredicate::selectPage(void *page, unsigned numSlots, uint8_t *selection)
+{
+    if (comparator == NULL)
+        return;
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
+    // Varchars are compared record by record
+    if (type == TypeVarChar)
+    {
+        for (unsigned s = 0; s < numSlots; s++)
+        {
+            if (selection[s])
+                selection[s] = matches((const char*) page + rbfm->getSlotDirectoryRecordEntry(page, s).offset);
+        }
+        return;
+    }
+
+    // Gather the attribute of every selected record, a null one fails right away. The
+    // buffers are sized by setMaxSlots(), this only grows them for a page past that.
+    if (type == TypeInt && intValues.size() < numSlots)
+        intValues.resize(numSlots);
+    if (type == TypeReal && realValues.size() < numSlots)
+        realValues.resize(numSlots);
+    void *values = type == TypeInt ? (void*) intValues.data() : (void*) realValues.data();
+    for (unsigned s = 0; s < numSlots; s++)
+    {
+        if (!selection[s])
+            continue;
+        unsigned length;
+        const char *record = (const char*) page + rbfm->getSlotDirectoryRecordEntry(page, s).offset;
+        const char *value = rbfm->findAttribute(record, attrIndex, length);
+        if (value == NULL)
+            selection[s] = 0;
+        else
+            memcpy((char*) values + s * INT_SIZE, value, INT_SIZE);
+    }
+
+    // Values of records no longer selected are compared too, but can't be selected again
+    if (type == TypeInt)
+        selectInts(compOp, intValues.data(), numSlots, intValue, selection);
+    else
+        selectReals(compOp, realValues.data(), numSlots, realValue, selection);
+}
+
+void ScanPredicate::setMaxSlots(unsigned maxSlots)
+{
+    if (comparator == NULL)
+        return;
+    if (type == TypeInt)
+        intValues.resize(maxSlots);
+    else if (type == TypeReal)
+        realValues.resize(maxSlots);
+}
+
+bool ScanPredicate::mayMatch(const char *zoneMapEntry, unsigned pageSize) const
+{
+    if (comparator == NULL)
+        return true;
+
+    ZoneMapHeader header;
+    memcpy(&header, zoneMapEntry, sizeof(ZoneMapHeader));
+    // Pages without a summary of the attribute have to be read
+    if (attrIndex >= header.numColumns || (header.unboundedColumns & (1u << attrIndex)))
+        return true;
+    // Only nulls, which never match
+    if (!(header.valueColumns & (1u << attrIndex)))
+        return false;
+
+    // A NaN is in no range, every other value is only unequal to it
+    if (type == TypeReal && realValue != realValue)
+        return compOp == NE_OP;
+
+    const ZoneMapRange *range = (const ZoneMapRange*) (zoneMapEntry + sizeof(ZoneMapHeader)) + attrIndex;
+    char value[ZONE_MAP_VALUE_SIZE];
+    switch (type)
+    {
+        case TypeInt: memcpy(value, &intValue, INT_SIZE); break;
+        case TypeReal: memcpy(value, &realValue, REAL_SIZE); break;
+        case TypeVarChar: getZoneMapValue(type, varCharValue.data(), varCharValue.size(), value); break;
+    }
+    int minCmp = compareZoneMapValues(type, range->min, value);
+    int maxCmp = compareZoneMapValues(type, range->max, value);
+
+    // Varchars only have their first bytes in the zone map, so a value that
+    // summarizes the same as the bounds may still be past them
+    bool exact = type != TypeVarChar;
+    switch (compOp)
+    {
+        case EQ_OP: return minCmp <= 0 && maxCmp >= 0;
+        case LT_OP: return exact ? minCmp < 0 : minCmp <= 0;
+        case LE_OP: return minCmp <= 0;
+        case GT_OP: return exact ? maxCmp > 0 : maxCmp >= 0;
+        case GE_OP: return maxCmp >= 0;
+        case NE_OP: return !exact || minCmp != 0 || maxCmp != 0;
+        default: return true;
+    }
+}
+
+float ScanPredicate::getSelectivity() const
+{
+    return selectivity;
+}
+
+// Numbers compare in one instruction, varchars byte by byte
+unsigned ScanPredicate::getCost() const
+{
+    return comparator != NULL && type == TypeVarChar ? 2 : 1;
+}
+
+template <CompOp op>
+ScanPredicate::Comparator ScanPredicate::getComparator(AttrType type)
+{
+    switch (type)
+    {
+        case TypeInt: return compareInt<op>;
+        case TypeReal: return compareReal<op>;
+        case TypeVarChar: return compareVarChar<op>;
+    }
+    return compareNone;
+}
+
+// Fields in a page aren't aligned, so numbers are read through memcpy
+template <CompOp op>
+bool ScanPredicate::compareInt(const ScanPredicate &predicate, const char *value, unsigned length)
+{
+    int32_t recordInt;
+    memcpy(&recordInt, value, INT_SIZE);
+    return compareValues<op>(recordInt, predicate.intValue);
+}
+
+template <CompOp op>
+bool ScanPredicate::compareReal(const ScanPredicate &predicate, const char *value, unsigned length)
+{
+    float recordReal;
+    memcpy(&recordReal, value, REAL_SIZE);
+    return compareValues<op>(recordReal, predicate.realValue);
+}
+
+// Compares the stored bytes with their length, so embedded NULs are just characters
+template <CompOp op>
+bool ScanPredicate::compareVarChar(const ScanPredicate &predicate, const char *value, unsigned length)
+{
+    unsigned valueSize = predicate.varCharValue.size();
+    int cmp = memcmp(value, predicate.varCharValue.data(), min(length, valueSize));
+    if (cmp == 0)
+        cmp = (length > valueSize) - (length < valueSize);
+    return compareValues<op>(cmp, 0);
+}
+
+bool ScanPredicate::compareNone(const ScanPredicate &predicate, const char *value, unsigned length)
+{
+    return false;
+}
+
+ScanFilter::ScanFilter()
+: matchAll(true)
+{
+}
+
+RC ScanFilter::compile(const RecordLayout &layout, const vector<vector<ScanCondition> > &conditions)
+{
+    conjunctions.clear();
+    matchAll = conditions.empty();
+
+    vector<float> conjunctionSelectivity;
+    for (const vector<ScanCondition> &conjunction : conditions)
+    {
+        vector<ScanPredicate> predicates;
+        float selectivity = 1;
+        for (const ScanCondition &condition : conjunction)
+        {
+            ScanPredicate predicate;
+            RC rc = predicate.compile(layout, condition.attribute, condition.compOp, condition.value);
+            if (rc)
+                return rc;
+            // Conditions without an operator always hold
+            if (condition.compOp == NO_OP)
+                continue;
+            selectivity *= predicate.getSelectivity();
+            predicates.push_back(predicate);
+        }
+        // An AND that always holds makes the whole filter hold, one that never does can go
+        if (predicates.empty())
+            matchAll = true;
+        if (selectivity == 0)
+            continue;
+
+        // Cheap predicates that reject the most records go first
+        stable_sort(predicates.begin(), predicates.end(), [](const ScanPredicate &a, const ScanPredicate &b)
+            {return a.getSelectivity() * a.getCost() < b.getSelectivity() * b.getCost();});
+        conjunctions.push_back(predicates);
+        conjunctionSelectivity.push_back(selectivity);
+    }
+    if (matchAll)
+    {
+        conjunctions.clear();
+        return SUCCESS;
+    }
+
+    // The ANDs most likely to hold go first
+    vector<unsigned> order;
+    for (unsigned i = 0; i < conjunctions.size(); i++)
+        order.push_back(i);
+    stable_sort(order.begin(), order.end(), [&](unsigned a, unsigned b)
+        {return conjunctionSelectivity[a] > conjunctionSelectivity[b];});
+    vector<vector<ScanPredicate> > ordered;
+    for (unsigned i : order)
+        ordered.push_back(conjunctions[i]);
+    conjunctions.swap(ordered);
+    return SUCCESS;
+}
+
+bool ScanFilter::matches(const char *record) const
+{
+    if (matchAll)
+        return true;
+    for (const vector<ScanPredicate> &predicates : conjunctions)
+    {
+        bool match = true;
+        for (const ScanPredicate &predicate : predicates)
+        {
+            if (!predicate.matches(record))
+            {
+                match = false;
+                break;
+            }
+        }
+        if (match)
+            return true;
+    }
+    return false;
+}
+
+bool ScanFilter::mayMatch(const char *zoneMapEntry, unsigned pageSize) const
+{
+    if (matchAll)
+        return true;
+    for (const vector<ScanPredicate> &predicates : conjunctions)
+    {
+        bool match = true;
+        for (const ScanPredicate &predicate : predicates)
+        {
+            if (!predicate.mayMatch(zoneMapEntry, pageSize))
+            {
+                match = false;
+                break;
+            }
+        }
+        if (match)
+            return true;
+    }
+    return false;
+}
+
+void ScanFilter::setMaxSlots(unsigned maxSlots)
+{
+    liveSlots.reserve(maxSlots);
+    conjunctionSelection.reserve(maxSlots);
+    for (vector<ScanPredicate> &predicates : conjunctions)
+    {
+        for (ScanPredicate &predicate : predicates)
+            predicate.setMaxSlots(maxSlots);
+    }
+}
+
+bool ScanFilter::usesZoneMaps() const
+{
+    return !matchAll;
+}
+
+// Tests the page one predicate at a time, each over the records still selected by
+// the predicates of its AND before it
+void ScanFilter::selectPage(void *page, unsigned numSlots, vector<uint8_t> &selection)
+{
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    selection.resize(numSlots);
+    for (unsigned s = 0; s < numSlots; s++)
+        selection[s] = rbfm->getSlotStatus(rbfm->getSlotDirectoryRecordEntry(page, s)) == VALID;
+    if (matchAll)
+        return;
+
+    conjunctionSelection.resize(numSlots);
+    liveSlots.swap(selection);
+    selection.assign(numSlots, 0);
+    for (vector<ScanPredicate> &predicates : conjunctions)
+    {
+        // Records already selected by an earlier AND needn't be tested again
+        for (unsigned s = 0; s < numSlots; s++)
+            conjunctionSelection[s] = liveSlots[s] && !selection[s];
+        for (ScanPredicate &predicate : predicates)
+            predicate.selectPage(page, numSlots, conjunctionSelection.data());
+        for (unsigned s = 0; s < numSlots; s++)
+            selection[s] |= conjunctionSelection[s];
+    }
+}
+
+// Record layouts //////////////////////////////////////////////////////////////////////////
+
+RecordLayout::RecordLayout()
+: nullIndicatorSize(0), headerSize(sizeof(RecordLength)), fixedSize(true), fixedDataSize(0),
+  projectionNullIndicatorSize(0)
+{
+}
+
+RecordLayout::RecordLayout(const vector<Attribute> &rd)
+: recordDescriptor(rd)
+{
+    compile();
+    projectionNullIndicatorSize = 0;
+}
+
+// Attributes missing from the descriptor are kept as its size, getNextRecord() reports them
+RecordLayout::RecordLayout(const vector<Attribute> &rd, const vector<string> &attributeNames)
+: recordDescriptor(rd)
+{
+    compile();
+    for (const string &name : attributeNames)
+        projection.push_back(getAttributeIndex(name));
+    projectionNullIndicatorSize = RecordBasedFileManager::instance()->getNullIndicatorSize(projection.size());
+}
+
+const vector<Attribute> &RecordLayout::getRecordDescriptor() const
+{
+    return recordDescriptor;
+}
+
+unsigned RecordLayout::getNumberOfAttributes() const
+{
+    return recordDescriptor.size();
+}
+
+unsigned RecordLayout::getNullIndicatorSize() const
+{
+    return nullIndicatorSize;
+}
+
+unsigned RecordLayout::getAttributeIndex(const string &attributeName) const
+{
+    unsigned i;
+    for (i = 0; i < recordDescriptor.size(); i++)
+    {
+        if (recordDescriptor[i].name == attributeName)
+            break;
+    }
+    return i;
+}
+
+bool RecordLayout::describes(const vector<Attribute> &rd) const
+{
+    if (rd.size() != recordDescriptor.size())
+        return false;
+    for (unsigned i = 0; i < rd.size(); i++)
+    {
+        if (rd[i].type != recordDescriptor[i].type || rd[i].length != recordDescriptor[i].length
+            || rd[i].name != recordDescriptor[i].name)
+            return false;
+    }
+    return true;
+}
+
+void RecordLayout::compile()
+{
+    unsigned n = recordDescriptor.size();
+    nullIndicatorSize = RecordBasedFileManager::instance()->getNullIndicatorSize(n);
+    headerSize = sizeof(RecordLength) + nullIndicatorSize + n * sizeof(ColumnOffset);
+
+    // The column directory of a record without nulls, only complete without varchars
+    fixedSize = true;
+    fixedDataSize = 0;
+    fixedDirectory.clear();
+    for (const Attribute &attr : recordDescriptor)
+    {
+        if (attr.type == TypeVarChar)
+            fixedSize = false;
+        fixedDataSize += attr.type == TypeInt ? INT_SIZE : attr.type == TypeReal ? REAL_SIZE : 0;
+        fixedDirectory.push_back(headerSize + fixedDataSize);
+    }
+    if (!fixedSize)
+    {
+        fixedDataSize = 0;
+        fixedDirectory.clear();
+    }
+}
+
+// Callers that only have a descriptor get the layout compiled the last time the same
+// descriptor was used on this thread, so runs of calls with one descriptor compile it once
+const RecordLayout &RecordBasedFileManager::getLayout(const vector<Attribute> &recordDescriptor)
+{
+    static thread_local RecordLayout lastLayout;
+    if (!lastLayout.describes(recordDescriptor))
+        lastLayout = RecordLayout(recordDescriptor);
+    return lastLayout;
+}
+
+// Record views ////////////////////////////////////////////////////////////////////////////
+
+RecordView::RecordView()
+: fileHandle(NULL), pageNum(0), record(NULL)
+{
+}
+
+unsigned RecordView::getNumberOfAttributes()
+{
+    RecordLength n;
+    memcpy(&n, record, sizeof(RecordLength));
+    return n;
+}
+
+bool RecordView::isNull(unsigned attrIndex)
+{
+    unsigned length;
+    return RecordBasedFileManager::instance()->findAttribute(record, attrIndex, length) == NULL;
+}
+
+const void *RecordView::getAttribute(unsigned attrIndex, unsigned &length)
+{
+    return RecordBasedFileManager::instance()->findAttribute(record, attrIndex, length);
+}
+
+int32_t RecordView::getInt(unsigned attrIndex)
+{
+    unsigned length;
+    int32_t value;
+    memcpy(&value, getAttribute(attrIndex, length), INT_SIZE);
+    return value;
+}
+
+float RecordView::getReal(unsigned attrIndex)
+{
+    unsigned length;
+    float value;
+    memcpy(&value, getAttribute(attrIndex, length), REAL_SIZE);
+    return value;
+}
+
+void RecordView::release()
+{
+    page.unpin();
+    fileHandle = NULL;
+    record = NULL;
+}
+
+// Record batches //////////////////////////////////////////////////////////////////////////
+
+RecordBatch::RecordBatch()
+: numRows(0)
+{
+}
+
+unsigned RecordBatch::getNumberOfRows() const
+{
+    return numRows;
+}
+
+unsigned RecordBatch::getNumberOfColumns() const
+{
+    return columns.size();
+}
+
+AttrType RecordBatch::getColumnType(unsigned column) const
+{
+    return columns[column].type;
+}
+
+const RID *RecordBatch::getRIDs() const
+{
+    return rids.data();
+}
+
+bool RecordBatch::isNull(unsigned column, unsigned row) const
+{
+    return (columns[column].nulls[row / CHAR_BIT] & (1 << (CHAR_BIT - 1 - (row % CHAR_BIT)))) != 0;
+}
+
+const uint8_t *RecordBatch::getNullBitmap(unsigned column) const
+{
+    return columns[column].nulls.data();
+}
+
+const int32_t *RecordBatch::getInts(unsigned column) const
+{
+    return columns[column].ints.data();
+}
+
+const float *RecordBatch::getReals(unsigned column) const
+{
+    return columns[column].reals.data();
+}
+
+const uint32_t *RecordBatch::getVarCharOffsets(unsigned column) const
+{
+    return columns[column].offsets.data();
+}
+
+const char *RecordBatch::getVarCharBytes(unsigned column) const
+{
+    return columns[column].bytes.data();
+}
+
+// Empties the batch and sizes its columns for the projection of the layout. Arrays
+// only grow, so a scan allocates for its first batch and then reuses them.
+void RecordBatch::reset(const RecordLayout &layout, unsigned capacity)
+{
+    const vector<unsigned> &projection = layout.projection;
+    numRows = 0;
+    columns.resize(projection.size());
+    if (rids.size() < capacity)
+        rids.resize(capacity);
+
+    for (unsigned i = 0; i < projection.size(); i++)
+    {
+        Column &column = columns[i];
+        unsigned index = projection[i];
+        column.type = index < layout.getNumberOfAttributes() ? layout.recordDescriptor[index].type : TypeInt;
+        column.nulls.assign((capacity + CHAR_BIT - 1) / CHAR_BIT, 0);
+        switch (column.type)
         {
-            uint32_t varcharSize;
-            memcpy(&varcharSize, (char*)buffer + 1, VARCHAR_LENGTH_SIZE);
-            memcpy((char*)data + dataOffset, &varcharSize, VARCHAR_LENGTH_SIZE);
-            dataOffset += VARCHAR_LENGTH_SIZE;
-            memcpy((char*)data + dataOffset, (char*)buffer + 1 + VARCHAR_LENGTH_SIZE, varcharSize);
-            dataOffset += varcharSize;
+            case TypeInt:
+                if (column.ints.size() < capacity)
+                    column.ints.resize(capacity);
+            break;
+            case TypeReal:
+                if (column.reals.size() < capacity)
+                    column.reals.resize(capacity);
+            break;
+            case TypeVarChar:
+                if (column.offsets.size() < capacity + 1)
+                    column.offsets.resize(capacity + 1);
+                column.offsets[0] = 0;
+                column.bytes.clear();
+            break;
         }
     }
-    // Finally set null indicator of data, clean up and return
-    memcpy((char*)data, nullIndicator, nullIndicatorSize);
+}
 
-    free (buffer);
-    rid.pageNum = currPage;
-    rid.slotNum = currSlot++;
+// Bulk load ///////////////////////////////////////////////////////////////////////////////
+
+RC RecordBasedFileManager::bulkLoad(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, RBFM_BulkLoader &rbfm_BulkLoader)
+{
+    return rbfm_BulkLoader.loadInit(fileHandle, RecordLayout(recordDescriptor));
+}
+
+RC RecordBasedFileManager::bulkLoad(FileHandle &fileHandle, const RecordLayout &layout, RBFM_BulkLoader &rbfm_BulkLoader)
+{
+    return rbfm_BulkLoader.loadInit(fileHandle, layout);
+}
+
+RBFM_BulkLoader::RBFM_BulkLoader()
+: fileHandle(NULL), pageSize(0), reservedSpace(0), buffer(NULL), firstPage(0)
+{
+    rbfm = RecordBasedFileManager::instance();
+}
+
+// Records still in memory are written rather than lost
+RBFM_BulkLoader::~RBFM_BulkLoader()
+{
+    close();
+    free(buffer);
+}
+
+RC RBFM_BulkLoader::loadInit(FileHandle &fh, const RecordLayout &l)
+{
+    RC rc = close();
+    if (rc)
+        return rc;
+
+    // The buffer is page aligned so it can go straight to a PFM_OPEN_DIRECT file
+    if (buffer == NULL || pageSize != fh.getPageSize())
+    {
+        free(buffer);
+        buffer = NULL;
+        if (posix_memalign((void**) &buffer, PAGE_SIZE, (size_t) fh.getPageSize() * RBFM_BULK_LOAD_PAGES))
+        {
+            buffer = NULL;
+            return RBFM_MALLOC_FAILED;
+        }
+    }
+
+    fileHandle = &fh;
+    layout = l;
+    pageSize = fh.getPageSize();
+    reservedSpace = rbfm->getReservedSpace(fh);
+    pages.clear();
+    firstPage = fh.getNumberOfPages();
+    return SUCCESS;
+}
+
+RC RBFM_BulkLoader::insertRecord(const void *data, RID &rid)
+{
+    if (fileHandle == NULL)
+        return RBFM_WRITE_FAILED;
+
+    unsigned recordSize = rbfm->getRecordSize(layout, data);
+    unsigned size = sizeof(SlotDirectoryRecordEntry) + recordSize;
+    if (size > pageSize - sizeof(SlotDirectoryHeader))
+        return RBFM_WRITE_FAILED;
+
+    // Only the last page can take more records, the ones before it are full.
+    // A new page takes its first record even if it leaves less than the reserved space.
+    if (pages.empty() || rbfm->getPageFreeSpaceSize(pages.back()) < size + reservedSpace)
+    {
+        RC rc = startPage();
+        if (rc)
+            return rc;
+    }
+
+    rid.pageNum = firstPage + pages.size() - 1;
+    rid.slotNum = rbfm->placeRecord(pages.back(), layout, data, recordSize);
     return SUCCESS;
 }
 
+RC RBFM_BulkLoader::close()
+{
+    if (fileHandle == NULL)
+        return SUCCESS;
+    RC rc = writePages();
+    fileHandle = NULL;
+    return rc;
+}
+
 // Private helper methods ///////////////////////////////////////////////////////////////////
 
-RC RBFM_ScanIterator::getNextSlot()
+// Adds an empty record page, preceded by a FSM leaf and a zone map page if they belong in front of it
+RC RBFM_BulkLoader::startPage()
 {
-    // If we're done with the current page, or we've read the last page
-    if (currSlot >= totalSlot || currPage >= totalPage)
-    {
-        // Reinitialize the current slot and increment page number
-        currSlot = 0;
-        currPage++;
-        // If we're done with last page, return EOF
-        if (currPage >= totalPage)
-            return RBFM_EOF;
-        // Otherwise get next page ready
-        RC rc = getNextPage();
+    if (pages.size() + 3 > RBFM_BULK_LOAD_PAGES)
+    {
+        RC rc = writePages();
         if (rc)
             return rc;
     }
 
-    // Get slot header, check to see if valid and meets scan condition
-    SlotDirectoryRecordEntry recordEntry = rbfm->getSlotDirectoryRecordEntry(pageData, currSlot);
-
-    if (rbfm->getSlotStatus(recordEntry) != VALID || !checkScanCondition())
+    // FSM leaves and zone map pages both start out zeroed
+    while (!rbfm->isRecordBasedPage(firstPage + pages.size(), pageSize))
     {
-        // If not, try next slot
-        currSlot++;
-        return getNextSlot();
+        char *sidePage = buffer + (size_t) pages.size() * pageSize;
+        memset(sidePage, 0, pageSize);
+        pages.push_back(sidePage);
     }
+
+    char *page = buffer + (size_t) pages.size() * pageSize;
+    rbfm->newRecordBasedPage(page, pageSize);
+    pages.push_back(page);
     return SUCCESS;
 }
 
-RC RBFM_ScanIterator::getNextPage()
+// Appends the pages in one vectored write, then records their free space
+RC RBFM_BulkLoader::writePages()
+{
+    if (pages.empty())
+        return SUCCESS;
+
+    // The RIDs handed out assumed nobody else appended to the file
+    if (fileHandle->getNumberOfPages() != firstPage)
+        return RBFM_APPEND_FAILED;
+    if (fileHandle->appendPages(pages))
+        return RBFM_APPEND_FAILED;
+
+    // The pages are in the file now, even if their free space and zone maps don't get recorded
+    RC rc = SUCCESS;
+    for (size_t i = 0; i < pages.size() && rc == SUCCESS; i++)
+    {
+        if (!rbfm->isRecordBasedPage(firstPage + i, pageSize))
+            continue;
+        rc = rbfm->updateFreeSpaceMap(*fileHandle, firstPage + i, pages[i]);
+        if (rc == SUCCESS)
+            rc = rbfm->updateZoneMap(*fileHandle, firstPage + i, pages[i], layout,
+                                     0, rbfm->getSlotDirectoryHeader(pages[i]).recordEntriesNumber);
+    }
+
+    firstPage += pages.size();
+    pages.clear();
+    return rc;
+}
+
+// Free space map //////////////////////////////////////////////////////////////////////////
+
+// Page 0 is the root, the leaves sit in front of the FSM_LEAF_SPAN record pages they describe
+bool RecordBasedFileManager::isFreeSpaceMapPage(PageNum pageNum, unsigned pageSize)
+{
+    return pageNum == FSM_ROOT_PAGE || (pageNum - 1) % (FSM_LEAF_SPAN(pageSize) + 1) == 0;
+}
+
+PageNum RecordBasedFileManager::getFreeSpaceMapLeafPage(unsigned leaf, unsigned pageSize)
+{
+    return 1 + leaf * (FSM_LEAF_SPAN(pageSize) + 1);
+}
+
+// Maps free bytes to a class, so that a page of class c has at least c * FSM_CLASS_SIZE free bytes
+uint8_t RecordBasedFileManager::getFreeSpaceClass(unsigned freeSpace, unsigned pageSize)
+{
+    unsigned freeSpaceClass = freeSpace / FSM_CLASS_SIZE(pageSize);
+    return freeSpaceClass > FSM_MAX_CLASS ? FSM_MAX_CLASS : freeSpaceClass;
+}
+
+// Finds a record page with at least size free bytes and leaves it pinned in page.
+// Only the root, one leaf and the chosen page are read in the common case.
+RC RecordBasedFileManager::findPageWithFreeSpace(FileHandle &fileHandle, unsigned size, PageHandle &page, bool &found)
 {
-    // Read in page
-    if (fileHandle.readPage(currPage, pageData))
+    found = false;
+    unsigned pageSize = fileHandle.getPageSize();
+
+    // Smallest class guaranteed to hold size bytes
+    unsigned neededClass = (size + FSM_CLASS_SIZE(pageSize) - 1) / FSM_CLASS_SIZE(pageSize);
+    if (neededClass > FSM_MAX_CLASS)
+        return SUCCESS;
+
+    unsigned numPages = fileHandle.getNumberOfPages();
+    if (numPages <= FSM_ROOT_PAGE + 1)
+        return SUCCESS;
+    unsigned numLeaves = (numPages - 1 + FSM_LEAF_SPAN(pageSize)) / (FSM_LEAF_SPAN(pageSize) + 1);
+    if (numLeaves > FSM_ROOT_SPAN(pageSize))
+        numLeaves = FSM_ROOT_SPAN(pageSize);
+
+    PageHandle root;
+    if (_buffer_manager->pinPage(fileHandle, FSM_ROOT_PAGE, root))
         return RBFM_READ_FAILED;
+    uint8_t *leafClasses = (uint8_t*) root.getData();
 
-    // Update slot total
-    SlotDirectoryHeader header = rbfm->getSlotDirectoryHeader(pageData);
-    totalSlot = header.recordEntriesNumber;
+    for (unsigned leaf = 0; leaf < numLeaves; leaf++)
+    {
+        // The root keeps the best class of each leaf, skip leaves that can't help
+        if (leafClasses[leaf] < neededClass)
+            continue;
+
+        PageHandle leafPage;
+        PageNum leafPageNum = getFreeSpaceMapLeafPage(leaf, pageSize);
+        if (_buffer_manager->pinPage(fileHandle, leafPageNum, leafPage))
+            return RBFM_READ_FAILED;
+        uint8_t *pageClasses = (uint8_t*) leafPage.getData();
+
+        uint8_t maxClass = 0;
+        for (unsigned i = 0; i < FSM_LEAF_SPAN(pageSize) && leafPageNum + 1 + i < numPages; i++)
+        {
+            if (pageClasses[i] >= neededClass)
+            {
+                if (_buffer_manager->pinPage(fileHandle, leafPageNum + 1 + i, page))
+                    return RBFM_READ_FAILED;
+                unsigned freeSpace = getPageFreeSpaceSize(page.getData());
+                if (freeSpace >= size)
+                {
+                    found = true;
+                    return SUCCESS;
+                }
+                // The entry was stale, correct it and keep looking
+                pageClasses[i] = getFreeSpaceClass(freeSpace, pageSize);
+                page.unpin();
+                if (leafPage.markDirty())
+                    return RBFM_WRITE_FAILED;
+            }
+            maxClass = max(maxClass, pageClasses[i]);
+        }
+
+        // Nothing suitable after all, so the root overestimated this leaf
+        leafClasses[leaf] = maxClass;
+        if (root.markDirty())
+            return RBFM_WRITE_FAILED;
+    }
     return SUCCESS;
 }
 
-bool RBFM_ScanIterator::checkScanCondition()
+// Records the current free space of a record page in its FSM leaf and in the root
+RC RecordBasedFileManager::updateFreeSpaceMap(FileHandle &fileHandle, PageNum pageNum, void *page)
 {
-    if (compOp == NO_OP) return true;
-    if (value == NULL) return false;
-    Attribute attr = recordDescriptor[attrIndex];
-    // Allocate enough memory to hold attribute and 1 byte null indicator
-    void *data = malloc(1 + attr.length);
-    // Get record entry to get offset
-    SlotDirectoryRecordEntry recordEntry = rbfm->getSlotDirectoryRecordEntry(pageData, currSlot);
-    // Grab the given attribute and store it in data
-    rbfm->getAttributeFromRecord(pageData, recordEntry.offset, attrIndex, attr.type, data);
+    unsigned pageSize = fileHandle.getPageSize();
+    if (!isRecordBasedPage(pageNum, pageSize))
+        return SUCCESS;
+
+    unsigned leaf = (pageNum - 1) / (FSM_LEAF_SPAN(pageSize) + 1);
+    unsigned index = (pageNum - 1) % (FSM_LEAF_SPAN(pageSize) + 1) - 1;
+    // Pages past what the root can describe are simply never reused
+    if (leaf >= FSM_ROOT_SPAN(pageSize))
+        return SUCCESS;
 
-    char null;
-    memcpy(&null, data, 1);
+    uint8_t newClass = getFreeSpaceClass(getPageFreeSpaceSize(page), pageSize);
 
-    bool result = false;
-    if (null)
+    PageHandle leafPage;
+    if (_buffer_manager->pinPage(fileHandle, getFreeSpaceMapLeafPage(leaf, pageSize), leafPage))
+        return RBFM_READ_FAILED;
+    uint8_t *pageClasses = (uint8_t*) leafPage.getData();
+    uint8_t oldClass = pageClasses[index];
+    if (oldClass == newClass)
+        return SUCCESS;
+    pageClasses[index] = newClass;
+    if (leafPage.markDirty())
+        return RBFM_WRITE_FAILED;
+
+    PageHandle root;
+    if (_buffer_manager->pinPage(fileHandle, FSM_ROOT_PAGE, root))
+        return RBFM_READ_FAILED;
+    uint8_t *leafClasses = (uint8_t*) root.getData();
+    uint8_t leafClass = leafClasses[leaf];
+
+    // The root entry only has to be recomputed if this page was what kept it up
+    if (newClass > leafClass)
+        leafClass = newClass;
+    else if (oldClass == leafClass)
+        leafClass = *max_element(pageClasses, pageClasses + FSM_LEAF_SPAN(pageSize));
+
+    if (leafClass != leafClasses[leaf])
     {
-        result = false;
+        leafClasses[leaf] = leafClass;
+        if (root.markDirty())
+            return RBFM_WRITE_FAILED;
     }
-    // Checkscan condition on record data and scan value
-    else if (attr.type == TypeInt)
+    return SUCCESS;
+}
+
+// Done filling a page in insertRecords(). A page of the file is left to the buffer pool to
+// write back, a new page is appended and records [first, end) learn its page number.
+RC RecordBasedFileManager::finishInsertPage(FileHandle &fileHandle, PageHandle &page, void *pageData, bool newPage,
+                                            const RecordLayout &layout, vector<RID> &rids, size_t first, size_t end)
+{
+    // The zone map is widened with the slots the records went to, and whatever lies between
+    unsigned firstSlot = UINT_MAX, endSlot = 0;
+    for (size_t i = first; i < end; i++)
     {
-        int32_t recordInt;
-        memcpy(&recordInt, (char*)data + 1, INT_SIZE);
-        result = checkScanCondition(recordInt, compOp, value);
+        firstSlot = min(firstSlot, rids[i].slotNum);
+        endSlot = max(endSlot, rids[i].slotNum + 1);
     }
-    else if (attr.type == TypeReal)
+
+    if (!newPage)
     {
-        float recordReal;
-        memcpy(&recordReal, (char*)data + 1, REAL_SIZE);
-        result = checkScanCondition(recordReal, compOp, value);
+        RC rc = page.markDirty() ? RBFM_WRITE_FAILED : SUCCESS;
+        if (rc == SUCCESS)
+            rc = updateFreeSpaceMap(fileHandle, page.getPageNum(), pageData);
+        if (rc == SUCCESS)
+            rc = updateZoneMap(fileHandle, page.getPageNum(), pageData, layout, firstSlot, endSlot);
+        page.unpin();
+        return rc;
     }
-    else if (attr.type == TypeVarChar)
-    {
-        uint32_t varcharSize;
-        memcpy(&varcharSize, (char*)data + 1, VARCHAR_LENGTH_SIZE);
-        char recordString[varcharSize + 1];
-        memcpy(recordString, (char*)data + 1 + VARCHAR_LENGTH_SIZE, varcharSize);
-        recordString[varcharSize] = '\0';
 
-        result = checkScanCondition(recordString, compOp, value);
-    }
-    free (data);
-    return result;
+    PageNum pageNum;
+    if (appendRecordBasedPage(fileHandle, pageData, pageNum))
+        return RBFM_APPEND_FAILED;
+    for (size_t i = first; i < end; i++)
+        rids[i].pageNum = pageNum;
+    return updateZoneMap(fileHandle, pageNum, pageData, layout, firstSlot, endSlot);
 }
 
-bool RBFM_ScanIterator::checkScanCondition(int recordInt, CompOp compOp, const void *value)
+// Appends a record page, preceded by a new FSM leaf if the page starts a new leaf's range
+// and by a new zone map page if it starts a new zone map's range
+RC RecordBasedFileManager::appendRecordBasedPage(FileHandle &fileHandle, void *page, PageNum &pageNum)
 {
-    int32_t intValue;
-    memcpy (&intValue, value, INT_SIZE);
-
-    switch (compOp)
+    pageNum = fileHandle.getNumberOfPages();
+    if (!isRecordBasedPage(pageNum, fileHandle.getPageSize()))
     {
-        case EQ_OP: return recordInt == intValue;
-        case LT_OP: return recordInt < intValue;
-        case GT_OP: return recordInt > intValue;
-        case LE_OP: return recordInt <= intValue;
-        case GE_OP: return recordInt >= intValue;
-        case NE_OP: return recordInt != intValue;
-        case NO_OP: return true;
-        // Should never happen
-        default: return false;
+        // Both start out zeroed
+        void *sideData = calloc(fileHandle.getPageSize(), 1);
+        if (sideData == NULL)
+            return RBFM_MALLOC_FAILED;
+        RC rc = SUCCESS;
+        for (; rc == SUCCESS && !isRecordBasedPage(pageNum, fileHandle.getPageSize()); pageNum++)
+            rc = _buffer_manager->appendPage(fileHandle, sideData);
+        free(sideData);
+        if (rc)
+            return RBFM_APPEND_FAILED;
     }
+
+    if (_buffer_manager->appendPage(fileHandle, page))
+        return RBFM_APPEND_FAILED;
+    return updateFreeSpaceMap(fileHandle, pageNum, page);
 }
 
-bool RBFM_ScanIterator::checkScanCondition(float recordReal, CompOp compOp, const void *value)
+// Zone maps ///////////////////////////////////////////////////////////////////////////////
+
+// Position of a page among those following its FSM leaf, the first of every
+// ZONE_MAP_SPAN + 1 of them being a zone map page
+static unsigned getPositionInLeaf(PageNum pageNum, unsigned pageSize)
 {
-    float realValue;
-    memcpy (&realValue, value, REAL_SIZE);
+    return (pageNum - 1) % (FSM_LEAF_SPAN(pageSize) + 1) - 1;
+}
 
-    switch (compOp)
+bool RecordBasedFileManager::isZoneMapPage(PageNum pageNum, unsigned pageSize)
+{
+    return !isFreeSpaceMapPage(pageNum, pageSize) && getPositionInLeaf(pageNum, pageSize) % (ZONE_MAP_SPAN + 1) == 0;
+}
+
+bool RecordBasedFileManager::isRecordBasedPage(PageNum pageNum, unsigned pageSize)
+{
+    return !isFreeSpaceMapPage(pageNum, pageSize) && !isZoneMapPage(pageNum, pageSize);
+}
+
+// Zone map page describing a record page, and the entry of the record page in it
+PageNum RecordBasedFileManager::getZoneMapPage(PageNum pageNum, unsigned pageSize, unsigned &entry)
+{
+    unsigned position = getPositionInLeaf(pageNum, pageSize) % (ZONE_MAP_SPAN + 1);
+    entry = position - 1;
+    return pageNum - position;
+}
+
+void RecordBasedFileManager::widenZoneMapEntry(char *entry, unsigned pageSize, const RecordLayout &layout, const char *record)
+{
+    ZoneMapHeader header;
+    memcpy(&header, entry, sizeof(ZoneMapHeader));
+    ZoneMapRange *ranges = (ZoneMapRange*) (entry + sizeof(ZoneMapHeader));
+
+    unsigned numColumns = min((size_t) layout.getNumberOfAttributes(), ZONE_MAP_MAX_COLUMNS(pageSize));
+    header.numColumns = max(header.numColumns, (uint32_t) numColumns);
+    for (unsigned i = 0; i < numColumns; i++)
     {
-        case EQ_OP: return recordReal == realValue;
-        case LT_OP: return recordReal < realValue;
-        case GT_OP: return recordReal > realValue;
-        case LE_OP: return recordReal <= realValue;
-        case GE_OP: return recordReal >= realValue;
-        case NE_OP: return recordReal != realValue;
-        case NO_OP: return true;
-        // Should never happen
-        default: return false;
+        unsigned length;
+        const char *value = findAttribute(record, i, length);
+        if (value == NULL)
+            continue;
+
+        AttrType type = layout.recordDescriptor[i].type;
+        if (type == TypeReal)
+        {
+            float real;
+            memcpy(&real, value, REAL_SIZE);
+            if (real != real)
+                header.unboundedColumns |= 1u << i;
+        }
+
+        char zoneValue[ZONE_MAP_VALUE_SIZE];
+        getZoneMapValue(type, value, length, zoneValue);
+        if (!(header.valueColumns & (1u << i)))
+        {
+            memcpy(ranges[i].min, zoneValue, ZONE_MAP_VALUE_SIZE);
+            memcpy(ranges[i].max, zoneValue, ZONE_MAP_VALUE_SIZE);
+            header.valueColumns |= 1u << i;
+            continue;
+        }
+        if (compareZoneMapValues(type, zoneValue, ranges[i].min) < 0)
+            memcpy(ranges[i].min, zoneValue, ZONE_MAP_VALUE_SIZE);
+        if (compareZoneMapValues(type, zoneValue, ranges[i].max) > 0)
+            memcpy(ranges[i].max, zoneValue, ZONE_MAP_VALUE_SIZE);
     }
+    memcpy(entry, &header, sizeof(ZoneMapHeader));
 }
 
-bool RBFM_ScanIterator::checkScanCondition(char *recordString, CompOp compOp, const void *value)
+RC RecordBasedFileManager::updateZoneMap(FileHandle &fileHandle, PageNum pageNum, void *page, const RecordLayout &layout,
+                                         unsigned first, unsigned end)
 {
-    if (compOp == NO_OP)
-        return true;
-
-    int32_t valueSize;
-    memcpy(&valueSize, value, VARCHAR_LENGTH_SIZE);
-    char valueStr[valueSize + 1];
-    valueStr[valueSize] = '\0';
-    memcpy(valueStr, (char*) value + VARCHAR_LENGTH_SIZE, valueSize);
+    unsigned pageSize = fileHandle.getPageSize();
+    unsigned entry;
+    PageHandle zoneMapPage;
+    if (_buffer_manager->pinPage(fileHandle, getZoneMapPage(pageNum, pageSize, entry), zoneMapPage))
+        return RBFM_READ_FAILED;
+    char *entryData = (char*) zoneMapPage.getData() + entry * ZONE_MAP_ENTRY_SIZE(pageSize);
 
-    int cmp = strcmp(recordString, valueStr);
-    switch (compOp)
+    end = min(end, getSlotDirectoryHeader(page).recordEntriesNumber);
+    for (unsigned i = first; i < end; i++)
     {
-        case EQ_OP: return cmp == 0;
-        case LT_OP: return cmp <  0;
-        case GT_OP: return cmp >  0;
-        case LE_OP: return cmp <= 0;
-        case GE_OP: return cmp >= 0;
-        case NE_OP: return cmp != 0;
-        // Should never happen
-        default: return false;
+        SlotDirectoryRecordEntry recordEntry = getSlotDirectoryRecordEntry(page, i);
+        if (getSlotStatus(recordEntry) == VALID)
+            widenZoneMapEntry(entryData, pageSize, layout, (const char*) page + recordEntry.offset);
     }
+    if (zoneMapPage.markDirty())
+        return RBFM_WRITE_FAILED;
+    return SUCCESS;
 }
 
 // Configures a new record based page, and puts it in "page".
-void RecordBasedFileManager::newRecordBasedPage(void * page)
+void RecordBasedFileManager::newRecordBasedPage(void * page, unsigned pageSize)
 {
-    memset(page, 0, PAGE_SIZE);
+    memset(page, 0, pageSize);
     // Writes the slot directory header.
     SlotDirectoryHeader slotHeader;
-    slotHeader.freeSpaceOffset = PAGE_SIZE;
+    slotHeader.freeSpaceOffset = pageSize;
     slotHeader.recordEntriesNumber = 0;
     setSlotDirectoryHeader(page, slotHeader);
 }
@@ -818,23 +2494,31 @@ unsigned RecordBasedFileManager::getPageFreeSpaceSize(void * page)
     return slotHeader.freeSpaceOffset - slotHeader.recordEntriesNumber * sizeof(SlotDirectoryRecordEntry) - sizeof(SlotDirectoryHeader);
 }
 
-unsigned RecordBasedFileManager::getRecordSize(const vector<Attribute> &recordDescriptor, const void *data) 
+// Bytes inserts leave free on each page, so that updates can grow records without moving them
+unsigned RecordBasedFileManager::getReservedSpace(FileHandle &fileHandle)
 {
-    // Read in the null indicator
-    int nullIndicatorSize = getNullIndicatorSize(recordDescriptor.size());
-    char nullIndicator[nullIndicatorSize];
-    memset(nullIndicator, 0, nullIndicatorSize);
-    memcpy(nullIndicator, (char*) data, nullIndicatorSize);
+    return (size_t) fileHandle.getPageSize() * (100 - fileHandle.getFillFactor()) / 100;
+}
+
+unsigned RecordBasedFileManager::getRecordSize(const RecordLayout &layout, const void *data) 
+{
+    const vector<Attribute> &recordDescriptor = layout.recordDescriptor;
+    const char *nullIndicator = (const char*) data;
+    unsigned nullIndicatorSize = layout.nullIndicatorSize;
+
+    // Records of a fixed size layout only differ when they have nulls
+    if (layout.fixedSize && !hasNullFields(nullIndicator, nullIndicatorSize))
+        return layout.headerSize + layout.fixedDataSize;
 
     // Offset into *data. Start just after null indicator
     unsigned offset = nullIndicatorSize;
     // Running count of size. Initialize to size of header
-    unsigned size = sizeof (RecordLength) + (recordDescriptor.size()) * sizeof(ColumnOffset) + nullIndicatorSize;
+    unsigned size = layout.headerSize;
 
     for (unsigned i = 0; i < (unsigned) recordDescriptor.size(); i++)
     {
         // Skip null fields
-        if (fieldIsNull(nullIndicator, i))
+        if (fieldIsNull((char*) nullIndicator, i))
             continue;
         switch (recordDescriptor[i].type)
         {
@@ -862,7 +2546,17 @@ unsigned RecordBasedFileManager::getRecordSize(const vector<Attribute> &recordDe
 // Calculate actual bytes for nulls-indicator for the given field counts
 int RecordBasedFileManager::getNullIndicatorSize(int fieldCount) 
 {
-    return int(ceil((double) fieldCount / CHAR_BIT));
+    return (fieldCount + CHAR_BIT - 1) / CHAR_BIT;
+}
+
+bool RecordBasedFileManager::hasNullFields(const char *nullIndicator, unsigned nullIndicatorSize)
+{
+    for (unsigned i = 0; i < nullIndicatorSize; i++)
+    {
+        if (nullIndicator[i])
+            return true;
+    }
+    return false;
 }
 
 bool RecordBasedFileManager::fieldIsNull(char *nullIndicator, int i)
@@ -872,13 +2566,12 @@ bool RecordBasedFileManager::fieldIsNull(char *nullIndicator, int i)
     return (nullIndicator[indicatorIndex] & indicatorMask) != 0;
 }
 
-void RecordBasedFileManager::setRecordAtOffset(void *page, unsigned offset, const vector<Attribute> &recordDescriptor, const void *data)
+void RecordBasedFileManager::setRecordAtOffset(void *page, unsigned offset, const RecordLayout &layout, const void *data)
 {
+    const vector<Attribute> &recordDescriptor = layout.recordDescriptor;
     // Read in the null indicator
-    int nullIndicatorSize = getNullIndicatorSize(recordDescriptor.size());
-    char nullIndicator[nullIndicatorSize];
-    memset (nullIndicator, 0, nullIndicatorSize);
-    memcpy(nullIndicator, (char*) data, nullIndicatorSize);
+    int nullIndicatorSize = layout.nullIndicatorSize;
+    const char *nullIndicator = (const char*) data;
 
     // Points to start of record
     char *start = (char*) page + offset;
@@ -895,14 +2588,23 @@ void RecordBasedFileManager::setRecordAtOffset(void *page, unsigned offset, cons
     memcpy(start + header_offset, nullIndicator, nullIndicatorSize);
     header_offset += nullIndicatorSize;
 
+    // Without varchars or nulls the fields are stored exactly as they are passed in,
+    // behind a column directory that is always the same
+    if (layout.fixedSize && !hasNullFields(nullIndicator, nullIndicatorSize))
+    {
+        memcpy(start + header_offset, layout.fixedDirectory.data(), len * sizeof(ColumnOffset));
+        memcpy(start + layout.headerSize, (char*) data + data_offset, layout.fixedDataSize);
+        return;
+    }
+
     // Keeps track of the offset of each record
     // Offset is relative to the start of the record and points to the END of a field
-    ColumnOffset rec_offset = header_offset + (recordDescriptor.size()) * sizeof(ColumnOffset);
+    ColumnOffset rec_offset = layout.headerSize;
 
     unsigned i = 0;
     for (i = 0; i < recordDescriptor.size(); i++)
     {
-        if (!fieldIsNull(nullIndicator, i))
+        if (!fieldIsNull((char*) nullIndicator, i))
         {
             // Points to current position in *data
             char *data_start = (char*) data + data_offset;
@@ -938,14 +2640,15 @@ void RecordBasedFileManager::setRecordAtOffset(void *page, unsigned offset, cons
     }
 }
 
-void RecordBasedFileManager::getRecordAtOffset(void *page, int32_t offset, const vector<Attribute> &recordDescriptor, void *data)
+void RecordBasedFileManager::getRecordAtOffset(void *page, int32_t offset, const RecordLayout &layout, void *data)
 {
+    const vector<Attribute> &recordDescriptor = layout.recordDescriptor;
     // Pointer to start of record
     char *start = (char*) page + offset;
 
     // Allocate space for null indicator. The returned null indicator may be larger than
     // the null indicator in the table has had fields added to it
-    int nullIndicatorSize = getNullIndicatorSize(recordDescriptor.size());
+    int nullIndicatorSize = layout.nullIndicatorSize;
     char nullIndicator[nullIndicatorSize];
     memset(nullIndicator, 0, nullIndicatorSize);
 
@@ -955,18 +2658,25 @@ void RecordBasedFileManager::getRecordAtOffset(void *page, int32_t offset, const
     int recordNullIndicatorSize = getNullIndicatorSize(len);
 
     // Read in the existing null indicator
-    memcpy (nullIndicator, start + sizeof(RecordLength), nullIndicatorSize);
+    memcpy (nullIndicator, start + sizeof(RecordLength), min(nullIndicatorSize, recordNullIndicatorSize));
 
     // If this new recordDescriptor has had fields added to it, we set all of the new fields to null
     for (unsigned i = len; i < recordDescriptor.size(); i++)
     {
-        int indicatorIndex = (i+1) / CHAR_BIT;
+        int indicatorIndex = i / CHAR_BIT;
         int indicatorMask  = 1 << (CHAR_BIT - 1 - (i % CHAR_BIT));
         nullIndicator[indicatorIndex] |= indicatorMask;
     }
     // Write out null indicator
     memcpy(data, nullIndicator, nullIndicatorSize);
 
+    // A complete record of a fixed size layout without nulls is stored just as it is returned
+    if (layout.fixedSize && len == recordDescriptor.size() && !hasNullFields(nullIndicator, nullIndicatorSize))
+    {
+        memcpy((char*) data + nullIndicatorSize, start + layout.headerSize, layout.fixedDataSize);
+        return;
+    }
+
     // Initialize some offsets
     // rec_offset: points to data in the record. We move this forward as we read data from our record
     unsigned rec_offset = sizeof(RecordLength) + recordNullIndicatorSize + len * sizeof(ColumnOffset);
@@ -1009,8 +2719,88 @@ SlotStatus RecordBasedFileManager::getSlotStatus(SlotDirectoryRecordEntry slot)
     return VALID;
 }
 
+RID RecordBasedFileManager::getForwardingAddress(SlotDirectoryRecordEntry slot)
+{
+    RID rid;
+    rid.pageNum = slot.length;
+    rid.slotNum = -slot.offset;
+    return rid;
+}
+
+RC RecordBasedFileManager::findForwardedRecord(FileHandle &fileHandle, SlotDirectoryRecordEntry slot, RID &target, vector<RID> &hops)
+{
+    hops.clear();
+    target = getForwardingAddress(slot);
+    while (true)
+    {
+        PageHandle page;
+        if (_buffer_manager->pinPage(fileHandle, target.pageNum, page))
+            return RBFM_READ_FAILED;
+        if (getSlotDirectoryHeader(page.getData()).recordEntriesNumber <= target.slotNum)
+            return RBFM_SLOT_DN_EXIST;
+
+        slot = getSlotDirectoryRecordEntry(page.getData(), target.slotNum);
+        switch (getSlotStatus(slot))
+        {
+            case DEAD:
+                return RBFM_READ_AFTER_DEL;
+            case MOVED:
+                hops.push_back(target);
+                target = getForwardingAddress(slot);
+                break;
+            case VALID:
+                return SUCCESS;
+        }
+    }
+}
+
+RC RecordBasedFileManager::freeForwardedSlot(FileHandle &fileHandle, const RID &rid)
+{
+    PageHandle page;
+    if (_buffer_manager->pinPage(fileHandle, rid.pageNum, page))
+        return RBFM_READ_FAILED;
+    void *pageData = page.getData();
+    markSlotDeleted(pageData, rid.slotNum);
+    reorganizePage(pageData, fileHandle.getPageSize());
+    if (page.markDirty())
+        return RBFM_WRITE_FAILED;
+    return updateFreeSpaceMap(fileHandle, rid.pageNum, pageData);
+}
+
 // Get first unused slot in page. Slot is considered unused if dead
 // If not dead slots returns recordEntriesNumber
+// Puts a record of recordSize bytes into a page known to have room for it and returns its slot
+unsigned RecordBasedFileManager::placeRecord(void *page, const RecordLayout &layout, const void *data, unsigned recordSize)
+{
+    SlotDirectoryHeader slotHeader = getSlotDirectoryHeader(page);
+    unsigned slotNum = getOpenSlot(page);
+    if (slotNum == slotHeader.recordEntriesNumber)
+    {
+        slotHeader.recordEntriesNumber += 1;
+        setSlotDirectoryHeader(page, slotHeader);
+    }
+
+    setRecordInSlot(page, slotNum, layout, data, recordSize);
+    return slotNum;
+}
+
+void RecordBasedFileManager::setRecordInSlot(void *page, unsigned slotNum, const RecordLayout &layout, const void *data, unsigned recordSize)
+{
+    // Adding the record reference in the slot directory.
+    SlotDirectoryHeader slotHeader = getSlotDirectoryHeader(page);
+    SlotDirectoryRecordEntry recordEntry;
+    recordEntry.length = recordSize;
+    recordEntry.offset = slotHeader.freeSpaceOffset - recordSize;
+    setSlotDirectoryRecordEntry(page, slotNum, recordEntry);
+
+    // Updating the slot directory header.
+    slotHeader.freeSpaceOffset = recordEntry.offset;
+    setSlotDirectoryHeader(page, slotHeader);
+
+    // Adding the record data.
+    setRecordAtOffset (page, recordEntry.offset, layout, data);
+}
+
 unsigned RecordBasedFileManager::getOpenSlot(void *page)
 {
     SlotDirectoryHeader header = getSlotDirectoryHeader(page);
@@ -1036,7 +2826,7 @@ void RecordBasedFileManager::markSlotDeleted(void *page, unsigned i)
 }
 
 // Consolidates free space in center of page
-void RecordBasedFileManager::reorganizePage(void *page)
+void RecordBasedFileManager::reorganizePage(void *page, unsigned pageSize)
 {
     SlotDirectoryHeader header = getSlotDirectoryHeader(page);
 
@@ -1056,7 +2846,7 @@ void RecordBasedFileManager::reorganizePage(void *page)
     sort(liveRecords.begin(), liveRecords.end(), comp);
 
     // Move each record back filling in any gap preceding the record
-    uint16_t pageOffset = PAGE_SIZE;
+    uint32_t pageOffset = pageSize;
     SlotDirectoryRecordEntry current;
     for (unsigned i = 0; i < liveRecords.size(); i++)
     {
@@ -1072,49 +2862,55 @@ void RecordBasedFileManager::reorganizePage(void *page)
     setSlotDirectoryHeader(page, header);
 }
 
-void RecordBasedFileManager::getAttributeFromRecord(void *page, unsigned offset, unsigned attrIndex, AttrType type, void *data)
+// Finds an attribute through the directory at the beginning of each record, which holds
+// the end offset of every attribute. Attributes the record predates read as null.
+const char *RecordBasedFileManager::findAttribute(const char *record, unsigned attrIndex, unsigned &length)
 {
-    char *start = (char*)page + offset;
-    unsigned data_offset = 0;
-
+    length = 0;
     // Get number of columns
     RecordLength n;
-    memcpy (&n, start, sizeof(RecordLength));
+    memcpy (&n, record, sizeof(RecordLength));
+    if (attrIndex >= n)
+        return NULL;
 
-    // Get null indicator
-    int recordNullIndicatorSize = getNullIndicatorSize(n);
-    char recordNullIndicator[recordNullIndicatorSize];
-    memcpy (recordNullIndicator, start + sizeof(RecordLength), recordNullIndicatorSize);
+    char *nullIndicator = (char*) record + sizeof(RecordLength);
+    if (fieldIsNull(nullIndicator, attrIndex))
+        return NULL;
+
+    unsigned header_offset = sizeof(RecordLength) + getNullIndicatorSize(n);
+    // The start is either the end of the previous attribute, or the start of the data section of the
+    // record if we are at the 0th attribute
+    ColumnOffset attrEnd, attrStart;
+    memcpy(&attrEnd, record + header_offset + attrIndex * sizeof(ColumnOffset), sizeof(ColumnOffset));
+    if (attrIndex > 0)
+        memcpy(&attrStart, record + header_offset + (attrIndex - 1) * sizeof(ColumnOffset), sizeof(ColumnOffset));
+    else
+        attrStart = header_offset + n * sizeof(ColumnOffset);
+    length = attrEnd - attrStart;
+    return record + attrStart;
+}
+
+void RecordBasedFileManager::getAttributeFromRecord(void *page, unsigned offset, unsigned attrIndex, AttrType type, void *data)
+{
+    unsigned data_offset = 0;
+    unsigned len;
+    const char *value = findAttribute((char*)page + offset, attrIndex, len);
 
     // Set null indicator for result
     char resultNullIndicator = 0;
-    if (fieldIsNull(recordNullIndicator, attrIndex))
+    if (value == NULL)
         resultNullIndicator |= (1 << 7);
     memcpy(data, &resultNullIndicator, 1);
     data_offset += 1;
     if (resultNullIndicator) return;
 
-    // Now we know the result isn't null, so we grab it
-    unsigned header_offset = sizeof(RecordLength) + recordNullIndicatorSize;
-    // attrEnd points to end of attribute, attrStart points to the beginning
-    // Our directory at the beginning of each record contains pointers to the ends of each attribute,
-    // so we can pull attrEnd from that
-    ColumnOffset attrEnd, attrStart;
-    memcpy(&attrEnd, start + header_offset + attrIndex * sizeof(ColumnOffset), sizeof(ColumnOffset));
-    // The start is either the end of the previous attribute, or the start of the data section of the
-    // record if we are after the 0th attribute
-    if (attrIndex > 0)
-        memcpy(&attrStart, start + header_offset + (attrIndex - 1) * sizeof(ColumnOffset), sizeof(ColumnOffset));
-    else
-        attrStart = header_offset + n * sizeof(ColumnOffset);
-    // The length of any attribute is just the difference between its start and end
-    uint32_t len = attrEnd - attrStart;
     if (type == TypeVarChar)
     {
         // For varchars we have to return this length in the result
-        memcpy((char*)data + data_offset, &len, sizeof(VARCHAR_LENGTH_SIZE));
+        uint32_t varcharSize = len;
+        memcpy((char*)data + data_offset, &varcharSize, VARCHAR_LENGTH_SIZE);
         data_offset += VARCHAR_LENGTH_SIZE;
     }
     // For all types, we then copy the data into the result
-    memcpy((char*)data + data_offset, start + attrStart, len);
+    memcpy((char*)data + data_offset, value, len);
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 #include <climits>
+#include <functional>
 
 #include "../rbf/pfm.h"
 
@@ -22,6 +23,7 @@
 #define RBFM_SLOT_DN_EXIST  7
 #define RBFM_READ_AFTER_DEL 8
 #define RBFM_NO_SUCH_ATTR   9
+#define RBFM_BAD_FILL_FACTOR 10
 
 using namespace std;
 
@@ -62,8 +64,8 @@ typedef enum
 // See chapter 9.6.2 of the cow book or lecture 3 slide 16 for more information
 typedef struct SlotDirectoryHeader
 {
-    uint16_t freeSpaceOffset;
-    uint16_t recordEntriesNumber;
+    uint32_t freeSpaceOffset;               // Pages can be up to PFM_MAX_PAGE_SIZE bytes
+    uint32_t recordEntriesNumber;
 } SlotDirectoryHeader;
 
 // Assignment 2 tip: Make offset negative to represent a forwarding address
@@ -86,6 +88,246 @@ typedef uint16_t ColumnOffset;
 
 typedef uint16_t RecordLength;
 
+// Free space map (FSM)
+// Page 0 of a record-based file is the FSM root. Every leaf page is followed by
+// the FSM_LEAF_SPAN record pages it describes and stores one free space class
+// per page. The root stores, per leaf, the best class found in that leaf.
+// Spans and classes scale with the page size of the file.
+#define FSM_ROOT_PAGE  0
+#define FSM_ROOT_SPAN(pageSize)  (pageSize)
+#define FSM_LEAF_SPAN(pageSize)  (pageSize)
+#define FSM_CLASS_SIZE(pageSize) ((pageSize) / 256)
+#define FSM_MAX_CLASS  UINT8_MAX
+
+// Zone maps
+// Within the pages an FSM leaf describes, every ZONE_MAP_SPAN record pages are preceded
+// by a zone map page. It has an entry for each of them with the smallest and largest
+// value of every column, so scans can skip pages that can't hold a match. Entries are
+// widened as records are added or updated and never narrowed, a delete leaves them as
+// they are. Varchars are summarized by their first ZONE_MAP_VALUE_SIZE bytes.
+#define ZONE_MAP_SPAN  32
+#define ZONE_MAP_ENTRY_SIZE(pageSize)  ((pageSize) / ZONE_MAP_SPAN)
+#define ZONE_MAP_VALUE_SIZE 4
+// Columns past this many (and past 32) aren't summarized
+#define ZONE_MAP_MAX_COLUMNS(pageSize) \
+    min((ZONE_MAP_ENTRY_SIZE(pageSize) - sizeof(ZoneMapHeader)) / sizeof(ZoneMapRange), (size_t) 32)
+
+typedef struct ZoneMapHeader
+{
+    uint32_t numColumns;                    // Columns summarized, 0 until a record is added
+    uint32_t valueColumns;                  // Bit i is set once column i has a value that isn't null
+    uint32_t unboundedColumns;              // Bit i is set once column i has a value without an order (NaN)
+} ZoneMapHeader;
+
+// Ints and reals are kept as stored, varchars as their first bytes padded with zeros
+typedef struct ZoneMapRange
+{
+    char min[ZONE_MAP_VALUE_SIZE];
+    char max[ZONE_MAP_VALUE_SIZE];
+} ZoneMapRange;
+
+
+// RecordLayout is a record descriptor compiled once, so records are encoded and
+// decoded without interpreting the vector<Attribute> on every call. A layout made
+// with a list of attribute names also carries that projection.
+class RecordLayout {
+public:
+  RecordLayout();
+  RecordLayout(const vector<Attribute> &recordDescriptor);
+  RecordLayout(const vector<Attribute> &recordDescriptor, const vector<string> &attributeNames);
+
+  const vector<Attribute> &getRecordDescriptor() const;
+  unsigned getNumberOfAttributes() const;
+  unsigned getNullIndicatorSize() const;
+  // Position in the record descriptor, getNumberOfAttributes() if there is no such attribute
+  unsigned getAttributeIndex(const string &attributeName) const;
+  bool describes(const vector<Attribute> &recordDescriptor) const;
+
+  friend class RecordBasedFileManager;
+  friend class RBFM_ScanIterator;
+  friend class ScanPredicate;
+  friend class RecordBatch;
+
+private:
+  vector<Attribute> recordDescriptor;
+  unsigned nullIndicatorSize;
+  unsigned headerSize;                  // Field count, null indicator and column directory of a stored record
+  bool fixedSize;                       // No varchars, so records without nulls all have the same size
+  unsigned fixedDataSize;               // Size of the fields of such a record
+  vector<ColumnOffset> fixedDirectory;  // and its column directory
+
+  vector<unsigned> projection;          // Descriptor index of each projected attribute
+  unsigned projectionNullIndicatorSize;
+
+  void compile();
+};
+
+
+// RecordView reads the attributes of a record where it is stored, without copying
+// the record out. The page holding it stays pinned until the view is released,
+// pointed at another record, or goes out of scope, so views should be short lived.
+// Attributes are numbered by their position in the record descriptor.
+class RecordView {
+public:
+  RecordView();
+  ~RecordView() {};
+
+  unsigned getNumberOfAttributes();
+  bool isNull(unsigned attrIndex);
+  // Points at the value inside the page, NULL if it is null. A varchar comes
+  // without its length, which is returned in "length" for every type.
+  const void *getAttribute(unsigned attrIndex, unsigned &length);
+  // Values of attributes that aren't null, read from possibly unaligned memory
+  int32_t getInt(unsigned attrIndex);
+  float getReal(unsigned attrIndex);
+  void release();
+
+  friend class RecordBasedFileManager;
+  friend class RBFM_ScanIterator;
+
+private:
+  PageHandle page;                      // Unpinned when the page is lent by a mapped file
+  FileHandle *fileHandle;               // Handle the page was reached through
+  PageNum pageNum;
+  const char *record;                   // NULL unless the view points at a record
+};
+
+
+// One comparison of a scan condition, the value follows the format of a single
+// condition scan. A BETWEEN-style range is two conditions on the same attribute.
+struct ScanCondition {
+  string      attribute;
+  CompOp      compOp;
+  const void *value;
+};
+
+
+// ScanPredicate is a scan condition compiled for one record descriptor. The value is
+// copied in and a comparator for the attribute type and operator is picked once, so
+// records are tested against the attribute where it is stored, without copying it out.
+// Varchars compare byte by byte, shorter first on a common prefix.
+class ScanPredicate {
+public:
+  ScanPredicate();
+
+  RC compile(const RecordLayout &layout, const string &conditionAttribute, const CompOp compOp, const void *value);
+  // Null attributes never satisfy a condition
+  bool matches(const char *record) const;
+  // Clears selection[s] for every record of the page that fails the condition, testing
+  // only those still selected. Ints and reals are gathered from the page and compared
+  // many at a time.
+  void selectPage(void *page, unsigned numSlots, uint8_t *selection);
+  // Whether a page with this zone map entry may hold a record satisfying the condition
+  bool mayMatch(const char *zoneMapEntry, unsigned pageSize) const;
+  // Sizes the buffers selectPage() gathers into for pages of up to maxSlots slots
+  void setMaxSlots(unsigned maxSlots);
+  // Estimated fraction of records that satisfy the condition
+  float getSelectivity() const;
+  // Relative cost of testing a record
+  unsigned getCost() const;
+
+private:
+  typedef bool (*Comparator)(const ScanPredicate &predicate, const char *value, unsigned length);
+
+  Comparator comparator;                // NULL when every record satisfies the condition
+  unsigned attrIndex;
+  AttrType type;
+  CompOp compOp;
+  float selectivity;
+  int32_t intValue;
+  float realValue;
+  string varCharValue;
+  vector<int32_t> intValues;            // Gathered by selectPage()
+  vector<float> realValues;
+
+  template <CompOp op> static Comparator getComparator(AttrType type);
+  template <CompOp op> static bool compareInt(const ScanPredicate &predicate, const char *value, unsigned length);
+  template <CompOp op> static bool compareReal(const ScanPredicate &predicate, const char *value, unsigned length);
+  template <CompOp op> static bool compareVarChar(const ScanPredicate &predicate, const char *value, unsigned length);
+  static bool compareNone(const ScanPredicate &predicate, const char *value, unsigned length);
+};
+
+
+// ScanFilter is an OR of ANDs of scan conditions, compiled into ScanPredicates.
+// Each AND tests its most selective and cheapest predicates first, and the ANDs
+// most likely to hold are tried first, so most records are settled by the first
+// predicate tested. No conditions at all select every record.
+class ScanFilter {
+public:
+  ScanFilter();
+
+  RC compile(const RecordLayout &layout, const vector<vector<ScanCondition> > &conditions);
+  bool matches(const char *record) const;
+  // Sets selection[s] to whether slot s of the page holds a record that matches
+  void selectPage(void *page, unsigned numSlots, vector<uint8_t> &selection);
+  bool mayMatch(const char *zoneMapEntry, unsigned pageSize) const;
+  // Sizes the scratch space of selectPage() once, for pages of up to maxSlots slots
+  void setMaxSlots(unsigned maxSlots);
+  // Whether any condition is worth looking up zone maps for
+  bool usesZoneMaps() const;
+
+private:
+  vector<vector<ScanPredicate> > conjunctions;
+  bool matchAll;
+  vector<uint8_t> liveSlots;            // Scratch space for selectPage()
+  vector<uint8_t> conjunctionSelection;
+};
+
+
+// Rows a batch scan returns per call unless asked otherwise
+#define RBFM_BATCH_SIZE 1024
+
+// RecordBatch holds up to a batch of scanned records column by column, one column per
+// projected attribute. Ints and reals are plain arrays, varchars are the offsets of
+// each value in a shared byte array (the value of row r is [offsets[r], offsets[r + 1]))
+// and every column has a null bitmap laid out like a null indicator, one bit per row.
+// Null values read as 0 or as empty varchars. The arrays are reused by the next batch.
+class RecordBatch {
+public:
+  RecordBatch();
+  ~RecordBatch() {};
+
+  unsigned getNumberOfRows() const;
+  unsigned getNumberOfColumns() const;
+  AttrType getColumnType(unsigned column) const;
+  const RID *getRIDs() const;
+
+  bool isNull(unsigned column, unsigned row) const;
+  const uint8_t *getNullBitmap(unsigned column) const;
+  // Valid for the column of the matching type only
+  const int32_t *getInts(unsigned column) const;
+  const float *getReals(unsigned column) const;
+  const uint32_t *getVarCharOffsets(unsigned column) const;
+  const char *getVarCharBytes(unsigned column) const;
+
+  friend class RBFM_ScanIterator;
+
+private:
+  typedef struct Column
+  {
+      AttrType type;
+      vector<uint8_t> nulls;
+      vector<int32_t> ints;
+      vector<float> reals;
+      vector<uint32_t> offsets;
+      vector<char> bytes;
+  } Column;
+
+  vector<Column> columns;
+  vector<RID> rids;
+  unsigned numRows;
+
+  void reset(const RecordLayout &layout, unsigned capacity);
+};
+
+
+// Pages a worker of a parallel scan takes from the file at a time
+#define RBFM_MORSEL_PAGES 64
+
+// Receives the batches of a parallel scan. It is called from every worker thread at
+// once, with the number of the calling worker, and anything but SUCCESS stops the scan.
+typedef function<RC(unsigned worker, const RecordBatch &batch)> ScanBatchCallback;
+
 
 /********************************************************************************
 The scan iterator is NOT required to be implemented for the part 1 of the project 
@@ -93,6 +335,11 @@ The scan iterator is NOT required to be implemented for the part 1 of the projec
 
 # define RBFM_EOF (-1)  // end of a scan operator
 
+// Scans read ahead adaptively. The window starts out small and doubles every
+// time the scan reaches the middle of the previous one in order.
+#define RBFM_SCAN_READ_AHEAD_MIN 4
+#define RBFM_SCAN_READ_AHEAD_MAX 256
+
 // RBFM_ScanIterator is an iterator to go through records
 // The way to use it is like the following:
 //  RBFM_ScanIterator rbfmScanIterator;
@@ -112,6 +359,12 @@ public:
   // a satisfying record needs to be fetched from the file.
   // "data" follows the same format as RecordBasedFileManager::insertRecord().
   RC getNextRecord(RID &rid, void *data);
+  // Same, but points "view" at the record in its page instead of copying the projected
+  // attributes. Views into a mapped file stay valid until the scan is closed.
+  RC getNextRecordView(RID &rid, RecordView &view);
+  // Fills "batch" with the projected attributes of up to maxRows records, and returns
+  // RBFM_EOF once there are none left
+  RC getNextBatch(RecordBatch &batch, unsigned maxRows = RBFM_BATCH_SIZE);
   RC close();
 
   friend class RecordBasedFileManager;
@@ -123,37 +376,86 @@ private:
   uint32_t currSlot;
 
   uint32_t totalPage;
-  uint16_t totalSlot;
+  uint32_t totalSlot;
 
+  PageHandle page;
   void *pageData;
-
-  AttrType type;
-  unsigned attrIndex;
+  uint32_t lastPage;                    // Page the scan read before the current one
+  uint32_t readAheadEnd;                // First page past the read-ahead window
+  uint32_t readAheadMark;               // Page that triggers reading the next window
+  uint32_t readAheadWindow;
+
+  // Zone map page last looked at. The scan and its read-ahead each keep their own,
+  // as they are usually in different groups of pages.
+  typedef struct ZoneMapCursor
+  {
+    PageHandle page;
+    const char *data;
+    PageNum pageNum;
+  } ZoneMapCursor;
+  ZoneMapCursor scanZoneMap;
+  ZoneMapCursor readAheadZoneMap;
 
   FileHandle fileHandle;
-  vector<Attribute> recordDescriptor;
-  string conditionAttribute;
-  CompOp compOp;
-  const void* value;
-  vector<string> attributeNames;
-
-  vector<RID> skipList;
+  RecordLayout layout;                  // With the projection of the scan
+  ScanFilter filter;
+  vector<uint8_t> selection;            // Slots of the current page that match
+  const unsigned long *fileVersion;     // Changes made to the file, from the buffer pool
+  unsigned long selectedVersion;        // fileVersion when the current page was tested
 
   RC scanInit(FileHandle &fh,
-        const vector<Attribute> rd,
-        const string &ca, 
-        const CompOp compOp, 
-        const void *v, 
-        const vector<string> &an);
+        const RecordLayout &l,
+        const vector<vector<ScanCondition> > &conditions);
 
+  void setPageRange(PageNum first, PageNum end);
+  bool pageMayMatch(PageNum pageNum, ZoneMapCursor &cursor);
   RC getNextSlot();
   RC getNextPage();
-  RC handleMovedRecord(bool &status, const RID rid, void *data);
-  bool checkScanCondition();
-  RC checkScanCondition(bool &result, const RID rid);
-  bool checkScanCondition(int, CompOp, const void*);
-  bool checkScanCondition(float, CompOp, const void*);
-  bool checkScanCondition(char*, CompOp, const void*);
+  void readAhead();
+};
+
+
+// Pages a bulk load fills in memory before writing them out together
+#define RBFM_BULK_LOAD_PAGES 64
+
+// RBFM_BulkLoader appends records to new pages at the end of a file, without ever
+// looking for free space in the pages already there. It is meant for filling a
+// file that is being created, and nothing else may append to the file meanwhile.
+// The way to use it is like the following:
+//  RBFM_BulkLoader rbfmBulkLoader;
+//  rbfm.bulkLoad(fileHandle, recordDescriptor, rbfmBulkLoader);
+//  while (...) {
+//    rbfmBulkLoader.insertRecord(data, rid);
+//  }
+//  rbfmBulkLoader.close();
+// RIDs are final when insertRecord() returns, but the records only reach the file
+// RBFM_BULK_LOAD_PAGES pages at a time, and the last ones on close().
+class RBFM_BulkLoader {
+public:
+  RBFM_BulkLoader();
+  ~RBFM_BulkLoader();
+
+  // "data" follows the same format as RecordBasedFileManager::insertRecord().
+  RC insertRecord(const void *data, RID &rid);
+  RC close();
+
+  friend class RecordBasedFileManager;
+
+private:
+  RecordBasedFileManager *rbfm;
+
+  FileHandle *fileHandle;               // NULL unless a load is open
+  RecordLayout layout;
+  unsigned pageSize;
+  unsigned reservedSpace;               // Free space left on each page for records to grow into
+
+  char *buffer;                         // Room for RBFM_BULK_LOAD_PAGES pages
+  vector<void *> pages;                 // Pages of the buffer in use, FSM leaves included
+  PageNum firstPage;                    // Page number pages[0] will get
+
+  RC loadInit(FileHandle &fh, const RecordLayout &l);
+  RC startPage();
+  RC writePages();
 };
 
 
@@ -162,11 +464,13 @@ class RecordBasedFileManager
 public:
   static RecordBasedFileManager* instance();
 
-  RC createFile(const string &fileName);
+  // Inserts fill pages up to fillFactor percent, leaving the rest for updates to grow records in
+  // place. It is kept in the file and can be changed later with FileHandle::setFillFactor().
+  RC createFile(const string &fileName, unsigned pageSize = PAGE_SIZE, unsigned fillFactor = PFM_DEFAULT_FILL_FACTOR);
   
   RC destroyFile(const string &fileName);
   
-  RC openFile(const string &fileName, FileHandle &fileHandle);
+  RC openFile(const string &fileName, FileHandle &fileHandle, unsigned flags = PFM_OPEN_DEFAULT);
   
   RC closeFile(FileHandle &fileHandle);
 
@@ -186,7 +490,20 @@ public:
   // For example, refer to the Q6 of Project 1 Environment document.
   RC insertRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const void *data, RID &rid);
 
+  // Every method taking a record descriptor also takes a compiled RecordLayout, which
+  // callers using the same descriptor over and over should keep around
+  RC insertRecord(FileHandle &fileHandle, const RecordLayout &layout, const void *data, RID &rid);
+
+  // Inserts a batch of records, rids[i] is set to the RID of data[i]. Each page is
+  // filled with as many records as fit and written once.
+  RC insertRecords(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const vector<const void *> &data, vector<RID> &rids);
+  RC insertRecords(FileHandle &fileHandle, const RecordLayout &layout, const vector<const void *> &data, vector<RID> &rids);
+
   RC readRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const RID &rid, void *data);
+  RC readRecord(FileHandle &fileHandle, const RecordLayout &layout, const RID &rid, void *data);
+
+  // Points "view" at the record, following a forwarding address if needed
+  RC readRecordView(FileHandle &fileHandle, const RID &rid, RecordView &view);
   
   // This method will be mainly used for debugging/testing. 
   // The format is as follows:
@@ -200,10 +517,22 @@ IMPORTANT, PLEASE READ: All methods below this comment (other than the construct
 ******************************************************************************************************************************************************************/
   RC deleteRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const RID &rid);
 
-  // Assume the RID does not change after an update
+  // Assume the RID does not change after an update. A record that outgrows its page is
+  // forwarded from its home slot to another page. Updating it again repoints the home slot
+  // wherever it ends up, or takes it back home if there is room, so reads take at most one hop.
   RC updateRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const void *data, const RID &rid);
+  RC updateRecord(FileHandle &fileHandle, const RecordLayout &layout, const void *data, const RID &rid);
+
+  // Moves forwarded records back into their home pages where those have room again, so
+  // they are read with one page read. Goes through at most maxPages pages starting at
+  // pageNum and leaves pageNum at the page to carry on from, which is past the last page
+  // of the file once it is done. The file stays usable in between, so this can run a
+  // few pages at a time alongside other work.
+  RC deforwardRecords(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, PageNum &pageNum, unsigned maxPages);
+  RC deforwardRecords(FileHandle &fileHandle, const RecordLayout &layout, PageNum &pageNum, unsigned maxPages);
 
   RC readAttribute(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const RID &rid, const string &attributeName, void *data);
+  RC readAttribute(FileHandle &fileHandle, const RecordLayout &layout, const RID &rid, const string &attributeName, void *data);
 
   // Scan returns an iterator to allow the caller to go through the results one by one. 
   RC scan(FileHandle &fileHandle,
@@ -213,9 +542,52 @@ IMPORTANT, PLEASE READ: All methods below this comment (other than the construct
       const void *value,                    // used in the comparison
       const vector<string> &attributeNames, // a list of projected attributes
       RBFM_ScanIterator &rbfm_ScanIterator);
+  // The projection is the one the layout was made with
+  RC scan(FileHandle &fileHandle,
+      const RecordLayout &layout,
+      const string &conditionAttribute,
+      const CompOp compOp,
+      const void *value,
+      RBFM_ScanIterator &rbfm_ScanIterator);
+  // Scans for records satisfying any one of "conditions", each of which is a list of
+  // conditions that must all hold, e.g. {{a, GE_OP, &lo}, {a, LE_OP, &hi}, {b, EQ_OP, &v}}
+  RC scan(FileHandle &fileHandle,
+      const vector<Attribute> &recordDescriptor,
+      const vector<vector<ScanCondition> > &conditions,
+      const vector<string> &attributeNames,
+      RBFM_ScanIterator &rbfm_ScanIterator);
+  RC scan(FileHandle &fileHandle,
+      const RecordLayout &layout,
+      const vector<vector<ScanCondition> > &conditions,
+      RBFM_ScanIterator &rbfm_ScanIterator);
+
+  // Scans with numThreads worker threads (0 for one per core), which take morsels of
+  // RBFM_MORSEL_PAGES pages from the file in turn and hand batches of the records they
+  // select to "callback". Returns once the whole file is scanned, or with the first
+  // result other than SUCCESS a callback returns, which stops every worker.
+  RC parallelScan(FileHandle &fileHandle,
+      const vector<Attribute> &recordDescriptor,
+      const vector<vector<ScanCondition> > &conditions,
+      const vector<string> &attributeNames,
+      unsigned numThreads,
+      const ScanBatchCallback &callback);
+  RC parallelScan(FileHandle &fileHandle,
+      const RecordLayout &layout,
+      const vector<vector<ScanCondition> > &conditions,
+      unsigned numThreads,
+      const ScanBatchCallback &callback);
+
+  // Starts a bulk load that appends records at the end of the file, see RBFM_BulkLoader
+  RC bulkLoad(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, RBFM_BulkLoader &rbfm_BulkLoader);
+  RC bulkLoad(FileHandle &fileHandle, const RecordLayout &layout, RBFM_BulkLoader &rbfm_BulkLoader);
 
 public:
   friend class RBFM_ScanIterator;
+  friend class RBFM_BulkLoader;
+  friend class RecordView;
+  friend class RecordLayout;
+  friend class ScanPredicate;
+  friend class ScanFilter;
 
 protected:
   RecordBasedFileManager();
@@ -224,10 +596,11 @@ protected:
 private:
   static RecordBasedFileManager *_rbf_manager;
   static PagedFileManager *_pf_manager;
+  static BufferManager *_buffer_manager;
 
   // Private helper methods
 
-  void newRecordBasedPage(void * page);
+  void newRecordBasedPage(void * page, unsigned pageSize);
 
   SlotDirectoryHeader getSlotDirectoryHeader(void * page);
   void setSlotDirectoryHeader(void * page, SlotDirectoryHeader slotHeader);
@@ -236,21 +609,54 @@ private:
   void setSlotDirectoryRecordEntry(void * page, unsigned recordEntryNumber, SlotDirectoryRecordEntry recordEntry);
 
   unsigned getPageFreeSpaceSize(void * page);
-  unsigned getRecordSize(const vector<Attribute> &recordDescriptor, const void *data);
+  unsigned getReservedSpace(FileHandle &fileHandle);
+  unsigned getRecordSize(const RecordLayout &layout, const void *data);
 
   int getNullIndicatorSize(int fieldCount);
+  bool hasNullFields(const char *nullIndicator, unsigned nullIndicatorSize);
+  const RecordLayout &getLayout(const vector<Attribute> &recordDescriptor);
   bool fieldIsNull(char *nullIndicator, int i);
 
-  void setRecordAtOffset(void *page, unsigned offset, const vector<Attribute> &recordDescriptor, const void *data);
-  void getRecordAtOffset(void *record, int32_t offset, const vector<Attribute> &recordDescriptor, void *data);
+  void setRecordAtOffset(void *page, unsigned offset, const RecordLayout &layout, const void *data);
+  // Writes a record into the free space of its page and points slotNum at it
+  void setRecordInSlot(void *page, unsigned slotNum, const RecordLayout &layout, const void *data, unsigned recordSize);
+  void getRecordAtOffset(void *record, int32_t offset, const RecordLayout &layout, void *data);
 
   SlotStatus getSlotStatus (SlotDirectoryRecordEntry slot);
+  RID getForwardingAddress(SlotDirectoryRecordEntry slot);
+  // Follows a forwarding address to the slot holding the record. Slots passed on the way
+  // only exist in files written before forwarding chains were collapsed.
+  RC findForwardedRecord(FileHandle &fileHandle, SlotDirectoryRecordEntry slot, RID &target, vector<RID> &hops);
+  // Frees a slot a record was forwarded to, once nothing points at it any more
+  RC freeForwardedSlot(FileHandle &fileHandle, const RID &rid);
+  RC updateForwardedRecord(FileHandle &fileHandle, const RecordLayout &layout, const void *data, const RID &rid,
+                           PageHandle &page);
+
   unsigned getOpenSlot(void *page);
+  unsigned placeRecord(void *page, const RecordLayout &layout, const void *data, unsigned recordSize);
 
   void markSlotDeleted(void *page, unsigned i);
 
-  void reorganizePage(void *page);
-
+  void reorganizePage(void *page, unsigned pageSize);
+
+  bool isFreeSpaceMapPage(PageNum pageNum, unsigned pageSize);
+  bool isZoneMapPage(PageNum pageNum, unsigned pageSize);
+  bool isRecordBasedPage(PageNum pageNum, unsigned pageSize);
+  PageNum getFreeSpaceMapLeafPage(unsigned leaf, unsigned pageSize);
+  uint8_t getFreeSpaceClass(unsigned freeSpace, unsigned pageSize);
+  RC findPageWithFreeSpace(FileHandle &fileHandle, unsigned size, PageHandle &page, bool &found);
+  RC updateFreeSpaceMap(FileHandle &fileHandle, PageNum pageNum, void *page);
+  RC appendRecordBasedPage(FileHandle &fileHandle, void *page, PageNum &pageNum);
+  RC finishInsertPage(FileHandle &fileHandle, PageHandle &page, void *pageData, bool newPage,
+                      const RecordLayout &layout, vector<RID> &rids, size_t first, size_t end);
+
+  PageNum getZoneMapPage(PageNum pageNum, unsigned pageSize, unsigned &entry);
+  void widenZoneMapEntry(char *entry, unsigned pageSize, const RecordLayout &layout, const char *record);
+  // Widens the zone map entry of a page with the records in slots [first, end)
+  RC updateZoneMap(FileHandle &fileHandle, PageNum pageNum, void *page, const RecordLayout &layout,
+                   unsigned first, unsigned end);
+
+  const char *findAttribute(const char *record, unsigned attrIndex, unsigned &length);
   void getAttributeFromRecord(void *page, unsigned offset, unsigned attrIndex, AttrType type,void *data);
 };
 
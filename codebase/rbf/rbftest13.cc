@@ -0,0 +1,179 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h> 
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h> 
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+int RBFTest_13(RecordBasedFileManager *rbfm) {
+    // Functions tested
+    // 1. Create Record-Based File
+    // 2. Insert Records
+    // 3. Read Records, through buffer pools of different sizes
+    // 4. Collect Counter Values, which only count pages read from disk
+    // 5. Update Records through a second handle, which writes and counts each change itself
+    // 6. Close and Destroy Record-Based File
+    cout << endl << "***** In RBF Test Case 13 *****" << endl;
+
+    RC rc;
+    string fileName = "test13";
+    rbfm->destroyFile(fileName);
+
+    rc = rbfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    FileHandle fileHandle;
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    vector<Attribute> recordDescriptor;
+    createRecordDescriptor(recordDescriptor);
+
+    void *record = malloc(200);
+    void *returnedData = malloc(200);
+    int numRecords = 3000;
+    int size = 0;
+    vector<RID> rids;
+    RID rid;
+    for (int i = 0; i < numRecords; i++) {
+        prepareIndexedRecord(i, record, &size);
+        rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+        assert(rc == success && "Inserting a record should not fail.");
+        rids.push_back(rid);
+    }
+
+    unsigned numPages = fileHandle.getNumberOfPages();
+
+    // Reads every record in each pass and counts the pages read from disk. Resizing the
+    // pool empties it, and the last two passes go through a pool too small for the file.
+    unsigned readCounts[4];
+    BufferManager *bm = BufferManager::instance();
+    for (unsigned pass = 0; pass < 4; pass++) {
+        if (pass == 0 || pass == 2) {
+            rc = bm->setNumberOfFrames(pass == 0 ? BM_DEFAULT_NUM_FRAMES : 4);
+            assert(rc == success && "Resizing the buffer pool should not fail.");
+        }
+
+        unsigned readBefore, writeBefore, appendBefore;
+        rc = fileHandle.collectCounterValues(readBefore, writeBefore, appendBefore);
+        assert(rc == success && "Collecting the counter values should not fail.");
+
+        for (int i = 0; i < numRecords; i++) {
+            rc = rbfm->readRecord(fileHandle, recordDescriptor, rids[i], returnedData);
+            assert(rc == success && "Reading a record should not fail.");
+            prepareIndexedRecord(i, record, &size);
+            if (memcmp(record, returnedData, size) != 0) {
+                cout << "[Fail] Record " << i << " doesn't read back the same." << endl;
+                cout << "Test Case 13 Failed!" << endl << endl;
+                return -1;
+            }
+        }
+
+        unsigned readAfter, writeAfter, appendAfter;
+        rc = fileHandle.collectCounterValues(readAfter, writeAfter, appendAfter);
+        assert(rc == success && "Collecting the counter values should not fail.");
+        readCounts[pass] = readAfter - readBefore;
+        if (writeAfter != writeBefore || appendAfter != appendBefore) {
+            cout << "[Fail] Reading records wrote pages." << endl;
+            cout << "Test Case 13 Failed!" << endl << endl;
+            return -1;
+        }
+    }
+    rc = bm->setNumberOfFrames(BM_DEFAULT_NUM_FRAMES);
+    assert(rc == success && "Resizing the buffer pool should not fail.");
+    cout << "Pages read from disk in each pass over " << numPages << " pages: " << readCounts[0] << " " << readCounts[1]
+         << " " << readCounts[2] << " " << readCounts[3] << endl;
+
+    // Once cached, pages are not read again, unless the pool can't keep them
+    if (readCounts[0] == 0 || readCounts[0] > numPages || readCounts[1] != 0 || readCounts[3] < readCounts[0]) {
+        cout << "[Fail] The read counter doesn't count the pages read from disk." << endl;
+        cout << "Test Case 13 Failed!" << endl << endl;
+        return -1;
+    }
+
+    // Changes made through a FH_SYNC_EVERY_WRITE handle are written through it as they
+    // are made, and show up in its counters only
+    FileHandle fileHandle2;
+    rc = rbfm->openFile(fileName, fileHandle2);
+    assert(rc == success && "Opening the file should not fail.");
+    rc = fileHandle2.setWritePolicy(FH_SYNC_EVERY_WRITE);
+    assert(rc == success && "Setting the write policy should not fail.");
+
+    unsigned readBefore, writeBefore, appendBefore, writeBefore2;
+    rc = fileHandle.collectCounterValues(readBefore, writeBefore, appendBefore);
+    assert(rc == success && "Collecting the counter values should not fail.");
+    rc = fileHandle2.collectCounterValues(readBefore, writeBefore2, appendBefore);
+    assert(rc == success && "Collecting the counter values should not fail.");
+
+    int numUpdates = 100;
+    for (int i = 0; i < numUpdates; i++) {
+        prepareIndexedRecord(numRecords - 1 - i, record, &size);
+        rc = rbfm->updateRecord(fileHandle2, recordDescriptor, record, rids[i]);
+        assert(rc == success && "Updating a record should not fail.");
+    }
+
+    unsigned readAfter, writeAfter, appendAfter, writeAfter2;
+    rc = fileHandle.collectCounterValues(readAfter, writeAfter, appendAfter);
+    assert(rc == success && "Collecting the counter values should not fail.");
+    rc = fileHandle2.collectCounterValues(readAfter, writeAfter2, appendAfter);
+    assert(rc == success && "Collecting the counter values should not fail.");
+    if (writeAfter != writeBefore || writeAfter2 - writeBefore2 < (unsigned) numUpdates) {
+        cout << "[Fail] Updates through the second handle wrote " << writeAfter2 - writeBefore2
+             << " pages through it and " << writeAfter - writeBefore << " through the first." << endl;
+        cout << "Test Case 13 Failed!" << endl << endl;
+        return -1;
+    }
+
+    rc = rbfm->closeFile(fileHandle2);
+    assert(rc == success && "Closing the file should not fail.");
+
+    // Nothing was left for the pool to write, and the disk has the new records
+    rc = bm->setNumberOfFrames(BM_DEFAULT_NUM_FRAMES);
+    assert(rc == success && "Resizing the buffer pool should not fail.");
+    rc = fileHandle.collectCounterValues(readAfter, writeAfter, appendAfter);
+    assert(rc == success && "Collecting the counter values should not fail.");
+    if (writeAfter != writeBefore) {
+        cout << "[Fail] Emptying the buffer pool wrote pages changed through a FH_SYNC_EVERY_WRITE handle." << endl;
+        cout << "Test Case 13 Failed!" << endl << endl;
+        return -1;
+    }
+    for (int i = 0; i < numUpdates; i++) {
+        rc = rbfm->readRecord(fileHandle, recordDescriptor, rids[i], returnedData);
+        assert(rc == success && "Reading a record should not fail.");
+        prepareIndexedRecord(numRecords - 1 - i, record, &size);
+        if (memcmp(record, returnedData, size) != 0) {
+            cout << "[Fail] Updated record " << i << " doesn't read back the same." << endl;
+            cout << "Test Case 13 Failed!" << endl << endl;
+            return -1;
+        }
+    }
+
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    rc = rbfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    free(record);
+    free(returnedData);
+
+    cout << "RBF Test Case 13 Finished! The result will be examined." << endl << endl;
+    return 0;
+}
+
+int main() {
+    // To test the functionality of the record-based file manager
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
+    RC rcmain = RBFTest_13(rbfm);
+
+    return rcmain;
+}
@@ -0,0 +1,173 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h> 
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h> 
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+// Reads back every record that is left and checks it against what was last written
+int checkRecords(RecordBasedFileManager *rbfm, FileHandle &fileHandle, const vector<Attribute> &recordDescriptor,
+        const vector<RID> &rids, const vector<int> &versions)
+{
+    void *record = malloc(200);
+    void *returnedData = malloc(200);
+    int size = 0;
+    for (unsigned i = 0; i < rids.size(); i++) {
+        if (versions[i] < 0)
+            continue;
+        RC rc = rbfm->readRecord(fileHandle, recordDescriptor, rids[i], returnedData);
+        assert(rc == success && "Reading a record should not fail.");
+        if (versions[i] == 0) {
+            prepareIndexedRecord(i, record, &size);
+        } else {
+            unsigned char nullsIndicator = 0;
+            prepareRecord(4, &nullsIndicator, 0, "", 20, 150.0, i, record, &size);
+        }
+        if (memcmp(record, returnedData, size) != 0) {
+            cout << "[Fail] Record " << i << " doesn't read back the same." << endl;
+            return -1;
+        }
+    }
+    free(record);
+    free(returnedData);
+    return 0;
+}
+
+int RBFTest_14(RecordBasedFileManager *rbfm) {
+    // Functions tested
+    // 1. Create Record-Based File
+    // 2. Insert, Delete and Update Records, checking where new records go
+    // 3. Read Records
+    // 4. Close and Destroy Record-Based File
+    cout << endl << "***** In RBF Test Case 14 *****" << endl;
+
+    RC rc;
+    string fileName = "test14";
+    rbfm->destroyFile(fileName);
+
+    rc = rbfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    FileHandle fileHandle;
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    vector<Attribute> recordDescriptor;
+    createRecordDescriptor(recordDescriptor);
+
+    void *record = malloc(200);
+    int numRecords = 6000;
+    int size = 0;
+    vector<RID> rids;
+    vector<int> versions;                  // 0 as inserted, 1 shrunk by an update, -1 deleted
+    RID rid;
+    for (int i = 0; i < numRecords; i++) {
+        prepareIndexedRecord(i, record, &size);
+        rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+        assert(rc == success && "Inserting a record should not fail.");
+        rids.push_back(rid);
+        versions.push_back(0);
+    }
+    unsigned numPages = fileHandle.getNumberOfPages();
+    PageNum lastPage = rids.back().pageNum;
+
+    // Free the first half of the file, every record of some pages and every other one
+    // of the others, and shrink records in the second half
+    for (int i = 0; i < numRecords; i++) {
+        if (rids[i].pageNum < lastPage / 2 && (rids[i].pageNum % 3 == 0 || i % 2 == 0)) {
+            rc = rbfm->deleteRecord(fileHandle, recordDescriptor, rids[i]);
+            assert(rc == success && "Deleting a record should not fail.");
+            versions[i] = -1;
+        } else if (rids[i].pageNum >= lastPage / 2 && i % 3 == 0) {
+            unsigned char nullsIndicator = 0;
+            prepareRecord(4, &nullsIndicator, 0, "", 20, 150.0, i, record, &size);
+            rc = rbfm->updateRecord(fileHandle, recordDescriptor, record, rids[i]);
+            assert(rc == success && "Updating a record should not fail.");
+            versions[i] = 1;
+        }
+    }
+
+    // Records inserted now fill the space that was freed instead of growing the file. New
+    // records only fit in the gaps deletes left once their pages are reorganized.
+    int numFreed = 0;
+    for (int i = 0; i < numRecords; i++)
+        numFreed += versions[i] < 0;
+    BufferManager *bm = BufferManager::instance();
+    unsigned maxReads = 0;
+    for (int i = numRecords; i < numRecords + numFreed * 3 / 4; i++) {
+        // With nothing cached, finding a page takes a few reads rather than a pass over the file
+        if (i % 100 == 0) {
+            rc = bm->setNumberOfFrames(BM_DEFAULT_NUM_FRAMES);
+            assert(rc == success && "Resizing the buffer pool should not fail.");
+        }
+        unsigned readBefore, readAfter, writeCount, appendCount;
+        fileHandle.collectCounterValues(readBefore, writeCount, appendCount);
+
+        prepareIndexedRecord(i, record, &size);
+        rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+        assert(rc == success && "Inserting a record should not fail.");
+        rids.push_back(rid);
+        versions.push_back(0);
+
+        fileHandle.collectCounterValues(readAfter, writeCount, appendCount);
+        maxReads = max(maxReads, readAfter - readBefore);
+    }
+    cout << "The file has " << numPages << " pages before and " << fileHandle.getNumberOfPages()
+         << " after reusing freed space. An insert read at most " << maxReads << " pages." << endl;
+    if (fileHandle.getNumberOfPages() != numPages || maxReads > 4) {
+        cout << "[Fail] Freed space was not found through the free space map." << endl;
+        cout << "Test Case 14 Failed!" << endl << endl;
+        return -1;
+    }
+
+    // What the free space map says holds across closing and reopening the file
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    for (int i = 0; i < numFreed / 8; i++) {
+        prepareIndexedRecord(rids.size(), record, &size);
+        rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+        assert(rc == success && "Inserting a record should not fail.");
+        rids.push_back(rid);
+        versions.push_back(0);
+    }
+    if (fileHandle.getNumberOfPages() != numPages) {
+        cout << "[Fail] The file grew after it was reopened, with " << fileHandle.getNumberOfPages() << " pages." << endl;
+        cout << "Test Case 14 Failed!" << endl << endl;
+        return -1;
+    }
+
+    if (checkRecords(rbfm, fileHandle, recordDescriptor, rids, versions) != 0) {
+        cout << "Test Case 14 Failed!" << endl << endl;
+        return -1;
+    }
+
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    rc = rbfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    free(record);
+
+    cout << "RBF Test Case 14 Finished! The result will be examined." << endl << endl;
+    return 0;
+}
+
+int main() {
+    // To test the functionality of the record-based file manager
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
+    RC rcmain = RBFTest_14(rbfm);
+
+    return rcmain;
+}
@@ -0,0 +1,154 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h> 
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h> 
+#include <atomic>
+#include <thread>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+// Fills a page with a pattern that tells page and version apart
+void preparePage(void *page, unsigned pageNum, unsigned version)
+{
+    for (unsigned i = 0; i < PAGE_SIZE; i++)
+        ((unsigned char *) page)[i] = (pageNum * 31 + version * 7 + i) % 251;
+}
+
+int RBFTest_15(PagedFileManager *pfm) {
+    // Functions tested
+    // 1. Create File
+    // 2. Append Pages
+    // 3. Read and Write Pages from many threads through one handle, buffered and unbuffered
+    // 4. Collect Counter Values
+    // 5. Close and Destroy File
+    cout << endl << "***** In RBF Test Case 15 *****" << endl;
+
+    RC rc;
+    string fileName = "test15";
+    pfm->destroyFile(fileName);
+
+    rc = pfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    // Aligned, so unbuffered transfers can use the buffers as they are
+    void *page;
+    int ret = posix_memalign(&page, PAGE_SIZE, PAGE_SIZE);
+    assert(ret == 0 && "Allocating a page should not fail.");
+
+    unsigned numPages = 64;
+    unsigned numThreads = 8;
+    unsigned readsPerThread = 500;
+    unsigned flags[] = {PFM_OPEN_DEFAULT, PFM_OPEN_DIRECT};
+    for (unsigned f = 0; f < 2; f++) {
+        FileHandle fileHandle;
+        rc = pfm->openFile(fileName, fileHandle, flags[f]);
+        assert(rc == success && "Opening the file should not fail.");
+
+        if (f == 0) {
+            for (unsigned p = 0; p < numPages; p++) {
+                preparePage(page, p, 0);
+                rc = fileHandle.appendPage(page);
+                assert(rc == success && "Appending a page should not fail.");
+            }
+        }
+
+        // Reading a page that isn't there keeps failing
+        rc = fileHandle.readPage(numPages, page);
+        assert(rc != success && "Reading a page past the end should fail.");
+
+        unsigned readBefore, writeBefore, appendBefore;
+        fileHandle.collectCounterValues(readBefore, writeBefore, appendBefore);
+
+        // Every thread writes its own pages, then all of them read pages at random
+        atomic<unsigned> failures(0);
+        vector<thread> threads;
+        for (unsigned t = 0; t < numThreads; t++) {
+            threads.push_back(thread([&, t] {
+                void *data;
+                if (posix_memalign(&data, PAGE_SIZE, PAGE_SIZE) != 0) {
+                    failures++;
+                    return;
+                }
+                for (unsigned p = t; p < numPages; p += numThreads) {
+                    preparePage(data, p, f + 1);
+                    if (fileHandle.writePage(p, data) != success)
+                        failures++;
+                }
+                void *expected = malloc(PAGE_SIZE);
+                unsigned seed = t;
+                for (unsigned i = 0; i < readsPerThread; i++) {
+                    unsigned p = rand_r(&seed) % numPages;
+                    if (fileHandle.readPage(p, data) != success) {
+                        failures++;
+                        continue;
+                    }
+                    // A page is seen either before or after its writer got to it
+                    preparePage(expected, p, f + 1);
+                    if (memcmp(data, expected, PAGE_SIZE) == 0)
+                        continue;
+                    preparePage(expected, p, f);
+                    if (memcmp(data, expected, PAGE_SIZE) != 0)
+                        failures++;
+                }
+                free(expected);
+                free(data);
+            }));
+        }
+        for (unsigned t = 0; t < numThreads; t++)
+            threads[t].join();
+
+        unsigned readAfter, writeAfter, appendAfter;
+        fileHandle.collectCounterValues(readAfter, writeAfter, appendAfter);
+        if (failures > 0 || readAfter - readBefore != numThreads * readsPerThread || writeAfter - writeBefore != numPages) {
+            cout << "[Fail] " << failures << " transfers failed, " << readAfter - readBefore << " reads and "
+                 << writeAfter - writeBefore << " writes were counted." << endl;
+            cout << "Test Case 15 Failed!" << endl << endl;
+            return -1;
+        }
+
+        // Once the threads are done, every page holds what its writer wrote
+        void *expected = malloc(PAGE_SIZE);
+        for (unsigned p = 0; p < numPages; p++) {
+            rc = fileHandle.readPage(p, page);
+            assert(rc == success && "Reading a page should not fail.");
+            preparePage(expected, p, f + 1);
+            if (memcmp(page, expected, PAGE_SIZE) != 0) {
+                cout << "[Fail] Page " << p << " doesn't hold what was written to it." << endl;
+                cout << "Test Case 15 Failed!" << endl << endl;
+                return -1;
+            }
+        }
+        free(expected);
+
+        rc = pfm->closeFile(fileHandle);
+        assert(rc == success && "Closing the file should not fail.");
+    }
+
+    rc = pfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    rc = destroyFileShouldSucceed(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    free(page);
+
+    cout << "RBF Test Case 15 Finished! The result will be examined." << endl << endl;
+    return 0;
+}
+
+int main() {
+    // To test the functionality of the paged file manager
+    PagedFileManager *pfm = PagedFileManager::instance();
+
+    RC rcmain = RBFTest_15(pfm);
+
+    return rcmain;
+}
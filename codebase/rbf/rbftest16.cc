@@ -0,0 +1,108 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h> 
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h> 
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+int RBFTest_16(PagedFileManager *pfm) {
+    // Functions tested
+    // 1. Create File
+    // 2. Open the File through two Handles
+    // 3. Append Pages through one, and Get and Refresh the Number of Pages of both
+    // 4. Read Pages through the other
+    // 5. Close and Destroy File
+    cout << endl << "***** In RBF Test Case 16 *****" << endl;
+
+    RC rc;
+    string fileName = "test16";
+    pfm->destroyFile(fileName);
+
+    rc = pfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    FileHandle appender;
+    FileHandle reader;
+    rc = pfm->openFile(fileName, appender);
+    assert(rc == success && "Opening the file should not fail.");
+    rc = pfm->openFile(fileName, reader);
+    assert(rc == success && "Opening the file should not fail.");
+
+    void *page = malloc(PAGE_SIZE);
+    void *returnedPage = malloc(PAGE_SIZE);
+    unsigned numPages = 40;
+    for (unsigned p = 0; p < numPages; p++) {
+        memset(page, p + 1, PAGE_SIZE);
+        rc = appender.appendPage(page);
+        assert(rc == success && "Appending a page should not fail.");
+        if (appender.getNumberOfPages() != p + 1) {
+            cout << "[Fail] The appending handle counts " << appender.getNumberOfPages() << " pages after appending " << p + 1 << endl;
+            cout << "Test Case 16 Failed!" << endl << endl;
+            return -1;
+        }
+
+        // The other handle learns about the page once it refreshes, or reads it
+        if (p % 2 == 0) {
+            rc = reader.refreshNumberOfPages();
+            assert(rc == success && "Refreshing the number of pages should not fail.");
+        } else {
+            rc = reader.readPage(p, returnedPage);
+            assert(rc == success && "Reading a page appended through another handle should not fail.");
+            if (memcmp(page, returnedPage, PAGE_SIZE) != 0) {
+                cout << "[Fail] Page " << p << " doesn't read back through the other handle." << endl;
+                cout << "Test Case 16 Failed!" << endl << endl;
+                return -1;
+            }
+        }
+        if (reader.getNumberOfPages() != p + 1) {
+            cout << "[Fail] The other handle counts " << reader.getNumberOfPages() << " pages after " << p + 1 << " were appended." << endl;
+            cout << "Test Case 16 Failed!" << endl << endl;
+            return -1;
+        }
+    }
+
+    rc = reader.readPage(numPages, returnedPage);
+    assert(rc == FH_PAGE_DN_EXIST && "Reading a page past the end should fail.");
+
+    rc = pfm->closeFile(appender);
+    assert(rc == success && "Closing the file should not fail.");
+    rc = pfm->closeFile(reader);
+    assert(rc == success && "Closing the file should not fail.");
+
+    // And the count survives reopening the file
+    rc = pfm->openFile(fileName, reader);
+    assert(rc == success && "Opening the file should not fail.");
+    if (reader.getNumberOfPages() != numPages) {
+        cout << "[Fail] The reopened file has " << reader.getNumberOfPages() << " pages." << endl;
+        cout << "Test Case 16 Failed!" << endl << endl;
+        return -1;
+    }
+    rc = pfm->closeFile(reader);
+    assert(rc == success && "Closing the file should not fail.");
+
+    rc = pfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    free(page);
+    free(returnedPage);
+
+    cout << "RBF Test Case 16 Finished! The result will be examined." << endl << endl;
+    return 0;
+}
+
+int main() {
+    // To test the functionality of the paged file manager
+    PagedFileManager *pfm = PagedFileManager::instance();
+
+    RC rcmain = RBFTest_16(pfm);
+
+    return rcmain;
+}
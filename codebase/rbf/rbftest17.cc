@@ -0,0 +1,156 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h> 
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h> 
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+// Pages written to disk through the handle so far
+unsigned getWriteCount(FileHandle &fileHandle)
+{
+    unsigned readCount, writeCount, appendCount;
+    fileHandle.collectCounterValues(readCount, writeCount, appendCount);
+    return writeCount;
+}
+
+// Writes version "version" of pages [first, end)
+void writePages(FileHandle &fileHandle, unsigned first, unsigned end, unsigned version, vector<unsigned> &versions)
+{
+    void *page = malloc(PAGE_SIZE);
+    for (unsigned p = first; p < end; p++) {
+        memset(page, (p * 16 + version) % 256, PAGE_SIZE);
+        RC rc = fileHandle.writePage(p, page);
+        assert(rc == success && "Writing a page should not fail.");
+        versions[p] = version;
+    }
+    free(page);
+}
+
+int RBFTest_17(PagedFileManager *pfm) {
+    // Functions tested
+    // 1. Create File
+    // 2. Set the Write Policy of a File
+    // 3. Write Pages, which are queued until flushed, the dirty threshold is hit or the file is closed
+    // 4. Read Pages
+    // 5. Close and Destroy File
+    cout << endl << "***** In RBF Test Case 17 *****" << endl;
+
+    RC rc;
+    string fileName = "test17";
+    pfm->destroyFile(fileName);
+
+    rc = pfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    FileHandle fileHandle;
+    rc = pfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    unsigned numPages = 64;
+    vector<unsigned> versions(numPages, 0);
+    void *page = malloc(PAGE_SIZE);
+    for (unsigned p = 0; p < numPages; p++) {
+        memset(page, (p * 16) % 256, PAGE_SIZE);
+        rc = fileHandle.appendPage(page);
+        assert(rc == success && "Appending a page should not fail.");
+    }
+
+    // By default every write goes out right away
+    unsigned writeCount = getWriteCount(fileHandle);
+    writePages(fileHandle, 0, 4, 1, versions);
+    if (getWriteCount(fileHandle) != writeCount + 4) {
+        cout << "[Fail] Writes were held back without a write-back policy." << endl;
+        cout << "Test Case 17 Failed!" << endl << endl;
+        return -1;
+    }
+
+    rc = fileHandle.setWritePolicy(FH_WRITE_BACK, 16);
+    assert(rc == success && "Setting the write policy should not fail.");
+
+    // Rewriting a queued page doesn't add a write, and nothing goes out below the threshold
+    writeCount = getWriteCount(fileHandle);
+    for (unsigned version = 2; version < 12; version++)
+        writePages(fileHandle, 5, 6, version, versions);
+    writePages(fileHandle, 10, 20, 2, versions);
+    if (getWriteCount(fileHandle) != writeCount) {
+        cout << "[Fail] Queued pages were written before the dirty threshold was hit." << endl;
+        cout << "Test Case 17 Failed!" << endl << endl;
+        return -1;
+    }
+
+    // Hitting the threshold writes out every queued page once
+    writePages(fileHandle, 20, 25, 2, versions);
+    if (getWriteCount(fileHandle) != writeCount + 16) {
+        cout << "[Fail] Hitting the dirty threshold wrote " << getWriteCount(fileHandle) - writeCount << " pages instead of 16." << endl;
+        cout << "Test Case 17 Failed!" << endl << endl;
+        return -1;
+    }
+
+    // So does an explicit flush or sync
+    writeCount = getWriteCount(fileHandle);
+    writePages(fileHandle, 30, 40, 3, versions);
+    rc = fileHandle.flush();
+    assert(rc == success && "Flushing the file should not fail.");
+    writePages(fileHandle, 40, 42, 3, versions);
+    rc = fileHandle.sync();
+    assert(rc == success && "Syncing the file should not fail.");
+    if (getWriteCount(fileHandle) != writeCount + 12) {
+        cout << "[Fail] Flushing wrote " << getWriteCount(fileHandle) - writeCount << " pages instead of 12." << endl;
+        cout << "Test Case 17 Failed!" << endl << endl;
+        return -1;
+    }
+
+    // And closing the file, after which the pages are read back without writing anything
+    writePages(fileHandle, 50, 64, 4, versions);
+    rc = pfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    FileHandle fileHandle2;
+    rc = pfm->openFile(fileName, fileHandle2);
+    assert(rc == success && "Opening the file should not fail.");
+    void *expected = malloc(PAGE_SIZE);
+    for (unsigned p = 0; p < numPages; p++) {
+        rc = fileHandle2.readPage(p, page);
+        assert(rc == success && "Reading a page should not fail.");
+        memset(expected, (p * 16 + versions[p]) % 256, PAGE_SIZE);
+        if (memcmp(page, expected, PAGE_SIZE) != 0) {
+            cout << "[Fail] Page " << p << " doesn't hold version " << versions[p] << endl;
+            cout << "Test Case 17 Failed!" << endl << endl;
+            return -1;
+        }
+    }
+    if (getWriteCount(fileHandle2) != 0) {
+        cout << "[Fail] Pages were still queued after the file was closed." << endl;
+        cout << "Test Case 17 Failed!" << endl << endl;
+        return -1;
+    }
+
+    rc = pfm->closeFile(fileHandle2);
+    assert(rc == success && "Closing the file should not fail.");
+
+    rc = pfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    free(page);
+    free(expected);
+
+    cout << "RBF Test Case 17 Finished! The result will be examined." << endl << endl;
+    return 0;
+}
+
+int main() {
+    // To test the functionality of the paged file manager
+    PagedFileManager *pfm = PagedFileManager::instance();
+
+    RC rcmain = RBFTest_17(pfm);
+
+    return rcmain;
+}
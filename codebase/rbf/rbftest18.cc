@@ -0,0 +1,164 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h> 
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h> 
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+// Fills a page with a pattern that tells page and version apart
+void preparePage(void *page, unsigned pageNum, unsigned version)
+{
+    for (unsigned i = 0; i < PAGE_SIZE; i++)
+        ((unsigned char *) page)[i] = (pageNum * 31 + version * 7 + i) % 251;
+}
+
+// Whether a page holds the given version of its pattern
+bool pageHolds(const void *page, unsigned pageNum, unsigned version)
+{
+    for (unsigned i = 0; i < PAGE_SIZE; i++)
+        if (((const unsigned char *) page)[i] != (pageNum * 31 + version * 7 + i) % 251)
+            return false;
+    return true;
+}
+
+int RBFTest_18(PagedFileManager *pfm) {
+    // Functions tested
+    // 1. Create File
+    // 2. Open File with PFM_OPEN_MMAP
+    // 3. Borrow Pages from the mapping, which must match Read Page
+    // 4. Append Pages, which grow the mapping
+    // 5. Extend the Mapping of another handle over the whole file
+    // 6. Write Pages through another handle, which the mapping must see
+    // 7. Close and Destroy File
+    cout << endl << "***** In RBF Test Case 18 *****" << endl;
+
+    RC rc;
+    string fileName = "test18";
+    pfm->destroyFile(fileName);
+
+    rc = pfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    FileHandle fileHandle;
+    rc = pfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    void *page = malloc(PAGE_SIZE);
+    unsigned numPages = 10;
+    for (unsigned p = 0; p < numPages; p++) {
+        preparePage(page, p, 0);
+        rc = fileHandle.appendPage(page);
+        assert(rc == success && "Appending a page should not fail.");
+    }
+
+    FileHandle mappedHandle;
+    rc = pfm->openFile(fileName, mappedHandle, PFM_OPEN_MMAP);
+    assert(rc == success && "Opening the file with PFM_OPEN_MMAP should not fail.");
+
+    const void *borrowed;
+    if (fileHandle.isMapped() || fileHandle.borrowPage(0, borrowed) != FH_NOT_MAPPED) {
+        cout << "[Fail] A default handle lent out a page." << endl;
+        cout << "Test Case 18 Failed!" << endl << endl;
+        return -1;
+    }
+    if (!mappedHandle.isMapped()) {
+        cout << "[Fail] A PFM_OPEN_MMAP handle has no mapping." << endl;
+        cout << "Test Case 18 Failed!" << endl << endl;
+        return -1;
+    }
+
+    // Borrowed pages match the pages read with readPage
+    for (unsigned p = 0; p < numPages; p++) {
+        rc = mappedHandle.borrowPage(p, borrowed);
+        assert(rc == success && "Borrowing a page should not fail.");
+        rc = mappedHandle.readPage(p, page);
+        assert(rc == success && "Reading a page should not fail.");
+        if (!pageHolds(borrowed, p, 0) || memcmp(borrowed, page, PAGE_SIZE) != 0) {
+            cout << "[Fail] Borrowed page " << p << " doesn't match the file." << endl;
+            cout << "Test Case 18 Failed!" << endl << endl;
+            return -1;
+        }
+    }
+
+    // Appending through the mapped handle grows the mapping
+    for (unsigned p = numPages; p < 4 * numPages; p++) {
+        preparePage(page, p, 0);
+        rc = mappedHandle.appendPage(page);
+        assert(rc == success && "Appending a page should not fail.");
+        rc = mappedHandle.borrowPage(p, borrowed);
+        if (rc != success || !pageHolds(borrowed, p, 0)) {
+            cout << "[Fail] Appended page " << p << " can't be borrowed." << endl;
+            cout << "Test Case 18 Failed!" << endl << endl;
+            return -1;
+        }
+    }
+    numPages *= 4;
+    if (mappedHandle.borrowPage(numPages, borrowed) != FH_PAGE_DN_EXIST) {
+        cout << "[Fail] A page past the end of the file was borrowed." << endl;
+        cout << "Test Case 18 Failed!" << endl << endl;
+        return -1;
+    }
+
+    // Another mapped handle can map the whole file up front without reading a page
+    FileHandle mappedHandle2;
+    rc = pfm->openFile(fileName, mappedHandle2, PFM_OPEN_MMAP);
+    assert(rc == success && "Opening the file with PFM_OPEN_MMAP should not fail.");
+    unsigned readCount, writeCount, appendCount;
+    rc = mappedHandle2.extendMapping();
+    mappedHandle2.collectCounterValues(readCount, writeCount, appendCount);
+    if (rc != success || readCount != 0 || fileHandle.extendMapping() != FH_NOT_MAPPED) {
+        cout << "[Fail] Extending the mapping failed or counted reads." << endl;
+        cout << "Test Case 18 Failed!" << endl << endl;
+        return -1;
+    }
+    rc = pfm->closeFile(mappedHandle2);
+    assert(rc == success && "Closing the file should not fail.");
+
+    // Pages written through the other handle show up in the mapping
+    rc = fileHandle.refreshNumberOfPages();
+    assert(rc == success && "Refreshing the number of pages should not fail.");
+    for (unsigned p = 0; p < numPages; p += 3) {
+        preparePage(page, p, 1);
+        rc = fileHandle.writePage(p, page);
+        assert(rc == success && "Writing a page should not fail.");
+    }
+    for (unsigned p = 0; p < numPages; p++) {
+        rc = mappedHandle.borrowPage(p, borrowed);
+        assert(rc == success && "Borrowing a page should not fail.");
+        if (!pageHolds(borrowed, p, p % 3 == 0 ? 1 : 0)) {
+            cout << "[Fail] Borrowed page " << p << " doesn't hold the last write." << endl;
+            cout << "Test Case 18 Failed!" << endl << endl;
+            return -1;
+        }
+    }
+
+    rc = pfm->closeFile(mappedHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    rc = pfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    rc = pfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    free(page);
+
+    cout << "RBF Test Case 18 Finished! The result will be examined." << endl << endl;
+    return 0;
+}
+
+int main() {
+    // To test the functionality of the paged file manager
+    PagedFileManager *pfm = PagedFileManager::instance();
+
+    RC rcmain = RBFTest_18(pfm);
+
+    return rcmain;
+}
@@ -0,0 +1,171 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h> 
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h> 
+#include <algorithm>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+// Fills a page with a pattern that tells page and version apart
+void preparePage(void *page, unsigned pageNum, unsigned version)
+{
+    for (unsigned i = 0; i < PAGE_SIZE; i++)
+        ((unsigned char *) page)[i] = (pageNum * 31 + version * 7 + i) % 251;
+}
+
+// Reads pageNums in one batch and checks every page against its last written version
+int checkReadPages(FileHandle &fileHandle, const vector<PageNum> &pageNums, const vector<unsigned> &versions)
+{
+    vector<void *> data(pageNums.size());
+    for (unsigned i = 0; i < data.size(); i++) {
+        int ret = posix_memalign(&data[i], PAGE_SIZE, PAGE_SIZE);
+        assert(ret == 0 && "Allocating a page should not fail.");
+    }
+
+    unsigned readCount, writeCount, appendCount;
+    fileHandle.collectCounterValues(readCount, writeCount, appendCount);
+    RC rc = fileHandle.readPages(pageNums, data);
+    assert(rc == success && "Reading pages should not fail.");
+    unsigned readCountAfter;
+    fileHandle.collectCounterValues(readCountAfter, writeCount, appendCount);
+
+    int result = 0;
+    if (readCountAfter - readCount != pageNums.size()) {
+        cout << "[Fail] Reading " << pageNums.size() << " pages counted " << readCountAfter - readCount << " reads." << endl;
+        result = -1;
+    }
+
+    void *expected = malloc(PAGE_SIZE);
+    for (unsigned i = 0; i < pageNums.size() && result == 0; i++) {
+        preparePage(expected, pageNums[i], versions[pageNums[i]]);
+        if (memcmp(data[i], expected, PAGE_SIZE) != 0) {
+            cout << "[Fail] Page " << pageNums[i] << " was read wrong at position " << i << endl;
+            result = -1;
+        }
+    }
+
+    free(expected);
+    for (unsigned i = 0; i < data.size(); i++)
+        free(data[i]);
+    return result;
+}
+
+int RBFTest_19(PagedFileManager *pfm) {
+    // Functions tested
+    // 1. Create File
+    // 2. Append Pages
+    // 3. Read Pages in batches larger and smaller than the queue depth, buffered and unbuffered
+    // 4. Read Pages still queued in the buffer pool
+    // 5. Read Pages again through the thread pool
+    // 6. Close and Destroy File
+    cout << endl << "***** In RBF Test Case 19 *****" << endl;
+
+    RC rc;
+    string fileName = "test19";
+    pfm->destroyFile(fileName);
+
+    rc = pfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    void *page;
+    int ret = posix_memalign(&page, PAGE_SIZE, PAGE_SIZE);
+    assert(ret == 0 && "Allocating a page should not fail.");
+
+    unsigned numPages = 4 * PR_QUEUE_DEPTH + 5;
+    vector<unsigned> versions(numPages, 0);
+
+    unsigned flags[] = {PFM_OPEN_DEFAULT, PFM_OPEN_DIRECT};
+    for (unsigned f = 0; f < 4; f++) {
+        // The last two rounds go through the thread pool, which is what kernels
+        // without io_uring always get
+        if (f == 2)
+            PageReader::instance()->closeRing();
+
+        FileHandle fileHandle;
+        rc = pfm->openFile(fileName, fileHandle, flags[f % 2]);
+        assert(rc == success && "Opening the file should not fail.");
+
+        if (f == 0) {
+            for (unsigned p = 0; p < numPages; p++) {
+                preparePage(page, p, 0);
+                rc = fileHandle.appendPage(page);
+                assert(rc == success && "Appending a page should not fail.");
+            }
+        }
+
+        // Every page in order, in one batch past the queue depth
+        vector<PageNum> pageNums;
+        for (unsigned p = 0; p < numPages; p++)
+            pageNums.push_back(p);
+        if (checkReadPages(fileHandle, pageNums, versions) != 0) {
+            cout << "Test Case 19 Failed!" << endl << endl;
+            return -1;
+        }
+
+        // Shuffled with repeats, in batches of every size up to twice the queue depth
+        srand(19 + f);
+        for (unsigned batch = 1; batch <= 2 * PR_QUEUE_DEPTH; batch += 7) {
+            pageNums.clear();
+            for (unsigned i = 0; i < batch; i++)
+                pageNums.push_back(rand() % numPages);
+            if (checkReadPages(fileHandle, pageNums, versions) != 0) {
+                cout << "Test Case 19 Failed!" << endl << endl;
+                return -1;
+            }
+        }
+
+        // Pages still queued in the buffer pool are read at their newest version
+        rc = fileHandle.setWritePolicy(FH_WRITE_BACK);
+        assert(rc == success && "Setting the write policy should not fail.");
+        for (unsigned p = f; p < numPages; p += 5) {
+            versions[p]++;
+            preparePage(page, p, versions[p]);
+            rc = fileHandle.writePage(p, page);
+            assert(rc == success && "Writing a page should not fail.");
+        }
+        pageNums.clear();
+        for (unsigned p = numPages; p > 0; p--)
+            pageNums.push_back(p - 1);
+        if (checkReadPages(fileHandle, pageNums, versions) != 0) {
+            cout << "Test Case 19 Failed!" << endl << endl;
+            return -1;
+        }
+
+        // A page past the end fails the whole batch
+        pageNums.push_back(numPages);
+        vector<void *> data(pageNums.size(), page);
+        if (fileHandle.readPages(pageNums, data) != FH_PAGE_DN_EXIST) {
+            cout << "[Fail] Reading a page past the end of the file didn't fail." << endl;
+            cout << "Test Case 19 Failed!" << endl << endl;
+            return -1;
+        }
+
+        rc = pfm->closeFile(fileHandle);
+        assert(rc == success && "Closing the file should not fail.");
+    }
+
+    rc = pfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    free(page);
+
+    cout << "RBF Test Case 19 Finished! The result will be examined." << endl << endl;
+    return 0;
+}
+
+int main() {
+    // To test the functionality of the paged file manager
+    PagedFileManager *pfm = PagedFileManager::instance();
+
+    RC rcmain = RBFTest_19(pfm);
+
+    return rcmain;
+}
@@ -0,0 +1,179 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h> 
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h> 
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+// Size of the file on disk, in pages
+unsigned getAllocatedPages(const string &fileName)
+{
+    struct stat sb;
+    if (stat(fileName.c_str(), &sb) != 0)
+        return 0;
+    return sb.st_size / PAGE_SIZE;
+}
+
+// The header at the start of the file, as recorded on disk
+FileHeader readFileHeader(const string &fileName)
+{
+    FileHeader header;
+    memset(&header, 0, sizeof(header));
+    FILE *file = fopen(fileName.c_str(), "rb");
+    if (file != NULL) {
+        size_t read = fread(&header, sizeof(header), 1, file);
+        assert(read == 1 && "Reading the file header should not fail.");
+        fclose(file);
+    }
+    return header;
+}
+
+// Appends pages until the file has numPages of them
+void appendPages(FileHandle &fileHandle, unsigned numPages)
+{
+    void *page = malloc(PAGE_SIZE);
+    while (fileHandle.getNumberOfPages() < numPages) {
+        memset(page, fileHandle.getNumberOfPages() % 256, PAGE_SIZE);
+        RC rc = fileHandle.appendPage(page);
+        assert(rc == success && "Appending a page should not fail.");
+    }
+    free(page);
+}
+
+int RBFTest_20(PagedFileManager *pfm) {
+    // Functions tested
+    // 1. Create File
+    // 2. Set Extent Size
+    // 3. Append Pages, which grow the file an extent at a time
+    // 4. Reopen the File, which must still have the pages in its header
+    // 5. Read Pages, including preallocated ones past the end
+    // 6. Close and Destroy File
+    cout << endl << "***** In RBF Test Case 20 *****" << endl;
+
+    RC rc;
+    string fileName = "test20";
+    pfm->destroyFile(fileName);
+
+    rc = pfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    // A new file is just its header
+    FileHeader header = readFileHeader(fileName);
+    if (getAllocatedPages(fileName) != PFM_HEADER_PAGES || header.magic != PFM_MAGIC || header.numPages != 0
+            || header.extentPages != PFM_DEFAULT_EXTENT_PAGES) {
+        cout << "[Fail] A new file doesn't consist of its header." << endl;
+        cout << "Test Case 20 Failed!" << endl << endl;
+        return -1;
+    }
+
+    FileHandle fileHandle;
+    rc = pfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    if (fileHandle.setExtentSize(0) == success) {
+        cout << "[Fail] An empty extent size was accepted." << endl;
+        cout << "Test Case 20 Failed!" << endl << endl;
+        return -1;
+    }
+    unsigned extentPages = 16;
+    rc = fileHandle.setExtentSize(extentPages);
+    assert(rc == success && "Setting the extent size should not fail.");
+
+    // The file grows a whole extent at a time
+    unsigned sizes[] = {1, extentPages, extentPages + 1, 2 * extentPages + 5};
+    for (unsigned i = 0; i < 4; i++) {
+        appendPages(fileHandle, sizes[i]);
+        unsigned extents = (sizes[i] + extentPages - 1) / extentPages;
+        if (fileHandle.getNumberOfPages() != sizes[i] || getAllocatedPages(fileName) != PFM_HEADER_PAGES + extents * extentPages) {
+            cout << "[Fail] A file of " << sizes[i] << " pages takes up " << getAllocatedPages(fileName) << " pages on disk." << endl;
+            cout << "Test Case 20 Failed!" << endl << endl;
+            return -1;
+        }
+    }
+
+    // Preallocated pages aren't part of the file
+    unsigned numPages = fileHandle.getNumberOfPages();
+    void *page = malloc(PAGE_SIZE);
+    if (fileHandle.readPage(numPages, page) != FH_PAGE_DN_EXIST || fileHandle.writePage(numPages, page) != FH_PAGE_DN_EXIST) {
+        cout << "[Fail] A preallocated page past the end of the file was accessed." << endl;
+        cout << "Test Case 20 Failed!" << endl << endl;
+        return -1;
+    }
+
+    rc = pfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    // The header keeps the logical size and the extent size
+    header = readFileHeader(fileName);
+    if (header.numPages != numPages || header.extentPages != extentPages) {
+        cout << "[Fail] The header records " << header.numPages << " pages in extents of " << header.extentPages
+             << " instead of " << numPages << " in extents of " << extentPages << endl;
+        cout << "Test Case 20 Failed!" << endl << endl;
+        return -1;
+    }
+
+    FileHandle fileHandle2;
+    rc = pfm->openFile(fileName, fileHandle2);
+    assert(rc == success && "Opening the file should not fail.");
+    if (fileHandle2.getNumberOfPages() != numPages) {
+        cout << "[Fail] The reopened file has " << fileHandle2.getNumberOfPages() << " pages instead of " << numPages << endl;
+        cout << "Test Case 20 Failed!" << endl << endl;
+        return -1;
+    }
+    for (unsigned p = 0; p < numPages; p++) {
+        rc = fileHandle2.readPage(p, page);
+        assert(rc == success && "Reading a page should not fail.");
+        if (((unsigned char *) page)[0] != p % 256 || ((unsigned char *) page)[PAGE_SIZE - 1] != p % 256) {
+            cout << "[Fail] Page " << p << " was read wrong after reopening the file." << endl;
+            cout << "Test Case 20 Failed!" << endl << endl;
+            return -1;
+        }
+    }
+
+    // Appends fill the preallocated extent before the file grows again
+    appendPages(fileHandle2, 3 * extentPages);
+    if (getAllocatedPages(fileName) != PFM_HEADER_PAGES + 3 * extentPages) {
+        cout << "[Fail] Appending into the preallocated extent grew the file." << endl;
+        cout << "Test Case 20 Failed!" << endl << endl;
+        return -1;
+    }
+    appendPages(fileHandle2, 3 * extentPages + 1);
+    if (getAllocatedPages(fileName) != PFM_HEADER_PAGES + 4 * extentPages) {
+        cout << "[Fail] The reopened file didn't grow by the extent size it was given." << endl;
+        cout << "Test Case 20 Failed!" << endl << endl;
+        return -1;
+    }
+
+    rc = pfm->closeFile(fileHandle2);
+    assert(rc == success && "Closing the file should not fail.");
+    if (readFileHeader(fileName).numPages != 3 * extentPages + 1) {
+        cout << "[Fail] The header wasn't updated when the file was closed." << endl;
+        cout << "Test Case 20 Failed!" << endl << endl;
+        return -1;
+    }
+
+    rc = pfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    free(page);
+
+    cout << "RBF Test Case 20 Finished! The result will be examined." << endl << endl;
+    return 0;
+}
+
+int main() {
+    // To test the functionality of the paged file manager
+    PagedFileManager *pfm = PagedFileManager::instance();
+
+    RC rcmain = RBFTest_20(pfm);
+
+    return rcmain;
+}
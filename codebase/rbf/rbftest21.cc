@@ -0,0 +1,170 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h> 
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h> 
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+// Record with an id and a text of textLength bytes
+void prepareTextRecord(int id, unsigned textLength, void *buffer, int *recordSize)
+{
+    char *data = (char *) buffer;
+    int offset = 0;
+    data[offset] = 0;
+    offset += 1;
+    memcpy(data + offset, &id, sizeof(int));
+    offset += sizeof(int);
+    memcpy(data + offset, &textLength, sizeof(int));
+    offset += sizeof(int);
+    for (unsigned i = 0; i < textLength; i++)
+        data[offset + i] = 'a' + (id + i) % 26;
+    offset += textLength;
+    *recordSize = offset;
+}
+
+int RBFTest_21(RecordBasedFileManager *rbfm) {
+    // Functions tested
+    // 1. Create Record-Based Files with every page size
+    // 2. Insert Records, some larger than a 4 KB page
+    // 3. Read Records
+    // 4. Reopen the Files, which must keep their page size
+    // 5. Scan
+    // 6. Create Files with invalid page sizes
+    // 7. Close and Destroy Files
+    cout << endl << "***** In RBF Test Case 21 *****" << endl;
+
+    RC rc;
+    string fileName = "test21";
+    PagedFileManager *pfm = PagedFileManager::instance();
+
+    unsigned badPageSizes[] = {0, PAGE_SIZE / 2, 3 * PAGE_SIZE, 2 * PFM_MAX_PAGE_SIZE};
+    for (unsigned i = 0; i < 4; i++) {
+        pfm->destroyFile(fileName);
+        if (pfm->createFile(fileName, badPageSizes[i]) != PFM_BAD_PAGE_SIZE || rbfm->createFile(fileName, badPageSizes[i]) == success) {
+            cout << "[Fail] A file was created with a page size of " << badPageSizes[i] << endl;
+            cout << "Test Case 21 Failed!" << endl << endl;
+            return -1;
+        }
+    }
+
+    unsigned pageSizes[] = {PAGE_SIZE, 2 * PAGE_SIZE, 4 * PAGE_SIZE, PFM_MAX_PAGE_SIZE};
+    for (unsigned s = 0; s < 4; s++) {
+        unsigned pageSize = pageSizes[s];
+        rbfm->destroyFile(fileName);
+        rc = rbfm->createFile(fileName, pageSize);
+        assert(rc == success && "Creating the file should not fail.");
+
+        vector<Attribute> recordDescriptor;
+        Attribute attr;
+        attr.name = "Id";
+        attr.type = TypeInt;
+        attr.length = (AttrLength) 4;
+        recordDescriptor.push_back(attr);
+        attr.name = "Text";
+        attr.type = TypeVarChar;
+        attr.length = (AttrLength) pageSize;
+        recordDescriptor.push_back(attr);
+
+        FileHandle fileHandle;
+        rc = rbfm->openFile(fileName, fileHandle);
+        assert(rc == success && "Opening the file should not fail.");
+        if (fileHandle.getPageSize() != pageSize) {
+            cout << "[Fail] A file created with " << pageSize << " byte pages has " << fileHandle.getPageSize() << " byte pages." << endl;
+            cout << "Test Case 21 Failed!" << endl << endl;
+            return -1;
+        }
+
+        // Texts of up to half a page, so large pages hold records that don't fit a small one
+        int numRecords = 400;
+        vector<RID> rids;
+        void *record = malloc(PFM_MAX_PAGE_SIZE);
+        void *returnedData = malloc(PFM_MAX_PAGE_SIZE);
+        int recordSize;
+        for (int i = 0; i < numRecords; i++) {
+            RID rid;
+            prepareTextRecord(i, (i * 37) % (pageSize / 2), record, &recordSize);
+            rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+            assert(rc == success && "Inserting a record should not fail.");
+            rids.push_back(rid);
+        }
+
+        rc = rbfm->closeFile(fileHandle);
+        assert(rc == success && "Closing the file should not fail.");
+        rc = rbfm->openFile(fileName, fileHandle);
+        assert(rc == success && "Opening the file should not fail.");
+        if (fileHandle.getPageSize() != pageSize) {
+            cout << "[Fail] The reopened file has " << fileHandle.getPageSize() << " byte pages instead of " << pageSize << endl;
+            cout << "Test Case 21 Failed!" << endl << endl;
+            return -1;
+        }
+
+        for (int i = 0; i < numRecords; i++) {
+            rc = rbfm->readRecord(fileHandle, recordDescriptor, rids[i], returnedData);
+            assert(rc == success && "Reading a record should not fail.");
+            prepareTextRecord(i, (i * 37) % (pageSize / 2), record, &recordSize);
+            if (memcmp(record, returnedData, recordSize) != 0) {
+                cout << "[Fail] Record " << i << " was read wrong from a file with " << pageSize << " byte pages." << endl;
+                cout << "Test Case 21 Failed!" << endl << endl;
+                return -1;
+            }
+        }
+
+        // A scan returns every record once
+        RBFM_ScanIterator rbfmScanIterator;
+        vector<string> attributes;
+        attributes.push_back("Id");
+        attributes.push_back("Text");
+        rc = rbfm->scan(fileHandle, recordDescriptor, "", NO_OP, NULL, attributes, rbfmScanIterator);
+        assert(rc == success && "Scanning the file should not fail.");
+        vector<bool> seen(numRecords, false);
+        RID rid;
+        int numScanned = 0;
+        while (rbfmScanIterator.getNextRecord(rid, returnedData) != RBFM_EOF) {
+            int id;
+            memcpy(&id, (char *) returnedData + 1, sizeof(int));
+            prepareTextRecord(id, (id * 37) % (pageSize / 2), record, &recordSize);
+            if (id < 0 || id >= numRecords || seen[id] || memcmp(record, returnedData, recordSize) != 0) {
+                cout << "[Fail] The scan returned a wrong record from a file with " << pageSize << " byte pages." << endl;
+                cout << "Test Case 21 Failed!" << endl << endl;
+                return -1;
+            }
+            seen[id] = true;
+            numScanned++;
+        }
+        rbfmScanIterator.close();
+        if (numScanned != numRecords) {
+            cout << "[Fail] The scan returned " << numScanned << " records instead of " << numRecords << endl;
+            cout << "Test Case 21 Failed!" << endl << endl;
+            return -1;
+        }
+
+        rc = rbfm->closeFile(fileHandle);
+        assert(rc == success && "Closing the file should not fail.");
+
+        rc = rbfm->destroyFile(fileName);
+        assert(rc == success && "Destroying the file should not fail.");
+
+        free(record);
+        free(returnedData);
+    }
+
+    cout << "RBF Test Case 21 Finished! The result will be examined." << endl << endl;
+    return 0;
+}
+
+int main() {
+    // To test the functionality of the record-based file manager
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
+    RC rcmain = RBFTest_21(rbfm);
+
+    return rcmain;
+}
@@ -0,0 +1,233 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h> 
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h> 
+#include <algorithm>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+#define NUM_WIDE_ATTRIBUTES 13
+
+// Attributes A0..A12 cycling through int, real and varchar, so the null indicator takes two bytes
+void createWideRecordDescriptor(vector<Attribute> &recordDescriptor)
+{
+    AttrType types[] = {TypeInt, TypeReal, TypeVarChar};
+    for (int k = 0; k < NUM_WIDE_ATTRIBUTES; k++) {
+        Attribute attr;
+        attr.name = "A" + to_string(k);
+        attr.type = types[k % 3];
+        attr.length = (AttrLength) (attr.type == TypeVarChar ? 30 : 4);
+        recordDescriptor.push_back(attr);
+    }
+}
+
+// Encodes the attributes "indexes" of wide record i, in that order. Attribute k of record i
+// is null when (i + k) % 5 == 0 and the whole record is nulls when i % 17 == 0.
+void prepareWideRecord(int i, const vector<int> &indexes, void *buffer, int *recordSize)
+{
+    char *data = (char *) buffer;
+    int nullIndicatorSize = (indexes.size() + 7) / 8;
+    memset(data, 0, nullIndicatorSize);
+    int offset = nullIndicatorSize;
+    for (unsigned j = 0; j < indexes.size(); j++) {
+        int k = indexes[j];
+        if ((i + k) % 5 == 0 || i % 17 == 0) {
+            data[j / 8] |= 1 << (7 - j % 8);
+            continue;
+        }
+        if (k % 3 == 0) {
+            int value = i * k;
+            memcpy(data + offset, &value, sizeof(int));
+            offset += sizeof(int);
+        } else if (k % 3 == 1) {
+            float value = i + k / 4.0;
+            memcpy(data + offset, &value, sizeof(float));
+            offset += sizeof(float);
+        } else {
+            int length = (i + k) % 20;
+            memcpy(data + offset, &length, sizeof(int));
+            offset += sizeof(int);
+            for (int c = 0; c < length; c++)
+                data[offset + c] = 'a' + (i + c) % 26;
+            offset += length;
+        }
+    }
+    *recordSize = offset;
+}
+
+int RBFTest_22(RecordBasedFileManager *rbfm) {
+    // Functions tested
+    // 1. Create Record-Based File
+    // 2. Insert, Read and Update Records with more than 8 attributes, through a descriptor and a RecordLayout
+    // 3. Read Attributes
+    // 4. Scan with projections out of descriptor order
+    // 5. Close and Destroy Record-Based File
+    cout << endl << "***** In RBF Test Case 22 *****" << endl;
+
+    RC rc;
+    string fileName = "test22";
+    rbfm->destroyFile(fileName);
+
+    rc = rbfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    FileHandle fileHandle;
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    vector<Attribute> recordDescriptor;
+    createWideRecordDescriptor(recordDescriptor);
+    RecordLayout layout(recordDescriptor);
+    if (layout.getNumberOfAttributes() != NUM_WIDE_ATTRIBUTES || layout.getNullIndicatorSize() != 2
+            || layout.getAttributeIndex("A7") != 7 || layout.getAttributeIndex("B") != NUM_WIDE_ATTRIBUTES
+            || !layout.describes(recordDescriptor)) {
+        cout << "[Fail] The layout doesn't describe the record descriptor it was compiled from." << endl;
+        cout << "Test Case 22 Failed!" << endl << endl;
+        return -1;
+    }
+
+    vector<int> allIndexes;
+    for (int k = 0; k < NUM_WIDE_ATTRIBUTES; k++)
+        allIndexes.push_back(k);
+
+    void *record = malloc(1000);
+    void *returnedData = malloc(1000);
+    int numRecords = 2000;
+    int size = 0;
+    vector<RID> rids;
+    RID rid;
+
+    // Every other record goes through the layout, the rest through the descriptor
+    for (int i = 0; i < numRecords; i++) {
+        prepareWideRecord(i, allIndexes, record, &size);
+        if (i % 2 == 0)
+            rc = rbfm->insertRecord(fileHandle, layout, record, rid);
+        else
+            rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+        assert(rc == success && "Inserting a record should not fail.");
+        rids.push_back(rid);
+    }
+
+    // Shift some records to other values, which for varchars also changes their size
+    vector<int> values(numRecords);
+    for (int i = 0; i < numRecords; i++) {
+        values[i] = i % 3 == 0 ? i + 7 : i;
+        if (values[i] == i)
+            continue;
+        prepareWideRecord(values[i], allIndexes, record, &size);
+        rc = rbfm->updateRecord(fileHandle, layout, record, rids[i]);
+        assert(rc == success && "Updating a record should not fail.");
+    }
+
+    void *attribute = malloc(100);
+    for (int i = 0; i < numRecords; i++) {
+        prepareWideRecord(values[i], allIndexes, record, &size);
+        rc = i % 2 == 0 ? rbfm->readRecord(fileHandle, layout, rids[i], returnedData)
+                        : rbfm->readRecord(fileHandle, recordDescriptor, rids[i], returnedData);
+        assert(rc == success && "Reading a record should not fail.");
+        if (memcmp(record, returnedData, size) != 0) {
+            cout << "[Fail] Record " << i << " was read wrong." << endl;
+            cout << "Test Case 22 Failed!" << endl << endl;
+            return -1;
+        }
+
+        // readAttribute returns a one-byte null indicator and the value
+        for (int k = 0; k < NUM_WIDE_ATTRIBUTES; k++) {
+            vector<int> index(1, k);
+            prepareWideRecord(values[i], index, record, &size);
+            string name = "A" + to_string(k);
+            rc = k % 2 == 0 ? rbfm->readAttribute(fileHandle, layout, rids[i], name, attribute)
+                            : rbfm->readAttribute(fileHandle, recordDescriptor, rids[i], name, attribute);
+            assert(rc == success && "Reading an attribute should not fail.");
+            if (memcmp(record, attribute, size) != 0) {
+                cout << "[Fail] Attribute " << name << " of record " << i << " was read wrong." << endl;
+                cout << "Test Case 22 Failed!" << endl << endl;
+                return -1;
+            }
+        }
+    }
+
+    // Projections shorter and longer than 8 attributes, out of descriptor order
+    vector<vector<int> > projections;
+    projections.push_back(vector<int>(1, 12));
+    int shortProjection[] = {11, 2, 7};
+    projections.push_back(vector<int>(shortProjection, shortProjection + 3));
+    int longProjection[] = {12, 0, 9, 5, 8, 1, 10, 3, 2, 6};
+    projections.push_back(vector<int>(longProjection, longProjection + 10));
+
+    for (unsigned p = 0; p < projections.size() * 2; p++) {
+        const vector<int> &projection = projections[p / 2];
+        vector<string> attributeNames;
+        for (unsigned j = 0; j < projection.size(); j++)
+            attributeNames.push_back("A" + to_string(projection[j]));
+
+        // Records with an int A3 above 3000
+        int threshold = 3000;
+        RBFM_ScanIterator rbfmScanIterator;
+        RecordLayout projectedLayout(recordDescriptor, attributeNames);
+        if (p % 2 == 0)
+            rc = rbfm->scan(fileHandle, projectedLayout, "A3", GT_OP, &threshold, rbfmScanIterator);
+        else
+            rc = rbfm->scan(fileHandle, recordDescriptor, "A3", GT_OP, &threshold, attributeNames, rbfmScanIterator);
+        assert(rc == success && "Scanning the file should not fail.");
+
+        // The scan returns the projection of every record with a non-null A3 above it, in any order
+        vector<string> expected;
+        for (int i = 0; i < numRecords; i++) {
+            if ((values[i] + 3) % 5 == 0 || values[i] % 17 == 0 || values[i] * 3 <= threshold)
+                continue;
+            prepareWideRecord(values[i], projection, record, &size);
+            expected.push_back(string((char *) record, size));
+        }
+
+        vector<string> scanned;
+        while (rbfmScanIterator.getNextRecord(rid, returnedData) != RBFM_EOF) {
+            // The returned data doesn't carry its size, so look it up among the expected encodings
+            string found;
+            for (unsigned e = 0; e < expected.size() && found.empty(); e++)
+                if (memcmp(expected[e].data(), returnedData, expected[e].size()) == 0)
+                    found = expected[e];
+            scanned.push_back(found.empty() ? string("?") : found);
+        }
+        rbfmScanIterator.close();
+
+        sort(expected.begin(), expected.end());
+        sort(scanned.begin(), scanned.end());
+        if (expected != scanned) {
+            cout << "[Fail] Scanning with a projection of " << projection.size() << " attributes returned " << scanned.size()
+                 << " records instead of " << expected.size() << ", or projected them wrong." << endl;
+            cout << "Test Case 22 Failed!" << endl << endl;
+            return -1;
+        }
+    }
+
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    rc = rbfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    free(record);
+    free(returnedData);
+    free(attribute);
+
+    cout << "RBF Test Case 22 Finished! The result will be examined." << endl << endl;
+    return 0;
+}
+
+int main() {
+    // To test the functionality of the record-based file manager
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
+    RC rcmain = RBFTest_22(rbfm);
+
+    return rcmain;
+}
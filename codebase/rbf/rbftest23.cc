@@ -0,0 +1,148 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h> 
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h> 
+#include <algorithm>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+int RBFTest_23(RecordBasedFileManager *rbfm) {
+    // Functions tested
+    // 1. Create Record-Based File
+    // 2. Insert, Delete and Update Records
+    // 3. Scan with a condition on every attribute, for every operator
+    // 4. Read Attribute, to check each scan one record at a time
+    // 5. Close and Destroy Record-Based File
+    cout << endl << "***** In RBF Test Case 23 *****" << endl;
+
+    RC rc;
+    string fileName = "test23";
+    rbfm->destroyFile(fileName);
+
+    rc = rbfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    FileHandle fileHandle;
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    vector<Attribute> recordDescriptor;
+    createRecordDescriptor(recordDescriptor);
+
+    void *record = malloc(200);
+    void *returnedData = malloc(200);
+    int numRecords = 3000;
+    int size = 0;
+    vector<RID> rids;
+    RID rid;
+
+    for (int i = 0; i < numRecords; i++) {
+        prepareIndexedRecord(i, record, &size);
+        rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+        assert(rc == success && "Inserting a record should not fail.");
+        rids.push_back(rid);
+    }
+
+    // Leave deleted slots behind, and grow some records so that they get forwarded
+    vector<RID> liveRids;
+    for (int i = 0; i < numRecords; i++) {
+        if (i % 13 == 5) {
+            rc = rbfm->deleteRecord(fileHandle, recordDescriptor, rids[i]);
+            assert(rc == success && "Deleting a record should not fail.");
+            continue;
+        }
+        if (i % 9 == 4) {
+            unsigned char nullsIndicator = 0;
+            string name = string("Emp") + string(25, (char) ('a' + i % 26));
+            prepareRecord(4, &nullsIndicator, name.length(), name, 20 + i % 50, 150.0 + (i % 60) / 2.0, i, record, &size);
+            rc = rbfm->updateRecord(fileHandle, recordDescriptor, record, rids[i]);
+            assert(rc == success && "Updating a record should not fail.");
+        }
+        liveRids.push_back(rids[i]);
+    }
+
+    int ageValue = 40;
+    float heightValue = 165.0;
+    int salaryValue = 1500;
+    string nameValue = string("Emp") + string(10, 'k');
+    char *varCharValue = (char *) malloc(100);
+    int nameLength = nameValue.length();
+    memcpy(varCharValue, &nameLength, sizeof(int));
+    memcpy(varCharValue + sizeof(int), nameValue.c_str(), nameLength);
+
+    const void *values[] = {varCharValue, &ageValue, &heightValue, &salaryValue};
+    vector<string> attributes;
+    attributes.push_back("Salary");
+
+    for (unsigned a = 0; a < recordDescriptor.size(); a++) {
+        for (int op = EQ_OP; op <= NO_OP; op++) {
+            CompOp compOp = (CompOp) op;
+
+            // The salaries of the records satisfying the condition, one record at a time
+            vector<int> expected;
+            for (unsigned i = 0; i < liveRids.size(); i++) {
+                rc = rbfm->readAttribute(fileHandle, recordDescriptor, liveRids[i], recordDescriptor[a].name, returnedData);
+                assert(rc == success && "Reading an attribute should not fail.");
+                if (!attributeSatisfies(recordDescriptor[a].type, returnedData, compOp, values[a]))
+                    continue;
+
+                int salary;
+                rc = rbfm->readAttribute(fileHandle, recordDescriptor, liveRids[i], "Salary", returnedData);
+                assert(rc == success && "Reading an attribute should not fail.");
+                memcpy(&salary, (char *) returnedData + 1, sizeof(int));
+                expected.push_back(salary);
+            }
+
+            // And the ones the scan returns
+            vector<int> scanned;
+            RBFM_ScanIterator rbfmScanIterator;
+            rc = rbfm->scan(fileHandle, recordDescriptor, recordDescriptor[a].name, compOp, values[a], attributes, rbfmScanIterator);
+            assert(rc == success && "Starting a scan should not fail.");
+            while (rbfmScanIterator.getNextRecord(rid, returnedData) != RBFM_EOF) {
+                int salary;
+                memcpy(&salary, (char *) returnedData + 1, sizeof(int));
+                scanned.push_back(salary);
+            }
+            rbfmScanIterator.close();
+
+            sort(expected.begin(), expected.end());
+            sort(scanned.begin(), scanned.end());
+            if (expected != scanned) {
+                cout << "[Fail] Scanning on " << recordDescriptor[a].name << " with operator " << op << " returned " << scanned.size()
+                     << " records instead of " << expected.size() << endl;
+                cout << "Test Case 23 Failed!" << endl << endl;
+                return -1;
+            }
+        }
+    }
+
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    rc = rbfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    free(record);
+    free(returnedData);
+    free(varCharValue);
+
+    cout << "RBF Test Case 23 Finished! The result will be examined." << endl << endl;
+    return 0;
+}
+
+int main() {
+    // To test the functionality of the record-based file manager
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
+    RC rcmain = RBFTest_23(rbfm);
+
+    return rcmain;
+}
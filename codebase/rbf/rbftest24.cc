@@ -0,0 +1,162 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h> 
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h> 
+#include <algorithm>
+#include <mutex>
+#include <atomic>
+#include <thread>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+// Salaries of the records a parallel scan returns, sorted
+RC parallelScanSalaries(RecordBasedFileManager *rbfm, FileHandle &fileHandle, const vector<Attribute> &recordDescriptor,
+        const vector<vector<ScanCondition> > &conditions, unsigned numThreads, vector<int> &salaries)
+{
+    vector<string> attributes;
+    attributes.push_back("Salary");
+    mutex salariesMutex;
+
+    RC rc = rbfm->parallelScan(fileHandle, recordDescriptor, conditions, attributes, numThreads,
+        [&](unsigned worker, const RecordBatch &batch) -> RC {
+            lock_guard<mutex> lock(salariesMutex);
+            for (unsigned row = 0; row < batch.getNumberOfRows(); row++)
+                salaries.push_back(batch.getInts(0)[row]);
+            return 0;
+        });
+    sort(salaries.begin(), salaries.end());
+    return rc;
+}
+
+int RBFTest_24(RecordBasedFileManager *rbfm) {
+    // Functions tested
+    // 1. Create Record-Based File
+    // 2. Insert and Delete Records
+    // 3. Parallel Scan, through the buffer pool and through a mapping of the file
+    // 4. Scan, to check the parallel scans against
+    // 5. Stop a Parallel Scan from its callback
+    // 6. Close and Destroy Record-Based File
+    cout << endl << "***** In RBF Test Case 24 *****" << endl;
+
+    RC rc;
+    string fileName = "test24";
+    rbfm->destroyFile(fileName);
+
+    rc = rbfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    FileHandle fileHandle;
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    vector<Attribute> recordDescriptor;
+    createRecordDescriptor(recordDescriptor);
+
+    // Enough records for many morsels
+    void *record = malloc(200);
+    int numRecords = 40000;
+    int size = 0;
+    RID rid;
+    for (int i = 0; i < numRecords; i++) {
+        prepareIndexedRecord(i, record, &size);
+        rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+        assert(rc == success && "Inserting a record should not fail.");
+        if (i % 8 == 1) {
+            rc = rbfm->deleteRecord(fileHandle, recordDescriptor, rid);
+            assert(rc == success && "Deleting a record should not fail.");
+        }
+    }
+    cout << "Records take " << fileHandle.getNumberOfPages() << " pages." << endl;
+
+    int age = 45;
+    float height = 160.0;
+    vector<vector<vector<ScanCondition> > > tests;
+    tests.push_back(vector<vector<ScanCondition> >());
+    tests.push_back(vector<vector<ScanCondition> >(1));
+    tests.back()[0].push_back(ScanCondition{"Age", LT_OP, &age});
+    tests.back()[0].push_back(ScanCondition{"Height", GE_OP, &height});
+
+    vector<string> attributes;
+    attributes.push_back("Salary");
+    unsigned threadCounts[] = {1, 4, 0};
+    for (unsigned t = 0; t < tests.size(); t++) {
+        vector<int> expected;
+        RBFM_ScanIterator rbfmScanIterator;
+        rc = rbfm->scan(fileHandle, recordDescriptor, tests[t], attributes, rbfmScanIterator);
+        assert(rc == success && "Starting a scan should not fail.");
+        while (rbfmScanIterator.getNextRecord(rid, record) != RBFM_EOF) {
+            int salary;
+            memcpy(&salary, (char *) record + 1, sizeof(int));
+            expected.push_back(salary);
+        }
+        rbfmScanIterator.close();
+        sort(expected.begin(), expected.end());
+
+        for (unsigned n = 0; n < sizeof(threadCounts) / sizeof(threadCounts[0]); n++) {
+            // The same file opened through the buffer pool and mapped
+            for (unsigned flags = PFM_OPEN_DEFAULT; flags <= PFM_OPEN_MMAP; flags += PFM_OPEN_MMAP) {
+                FileHandle scanHandle;
+                rc = rbfm->openFile(fileName, scanHandle, flags);
+                assert(rc == success && "Opening the file should not fail.");
+
+                vector<int> salaries;
+                rc = parallelScanSalaries(rbfm, scanHandle, recordDescriptor, tests[t], threadCounts[n], salaries);
+                assert(rc == success && "A parallel scan should not fail.");
+                if (salaries != expected) {
+                    cout << "[Fail] Parallel scan " << t << " with " << threadCounts[n] << " threads and flags " << flags
+                         << " returned " << salaries.size() << " records instead of " << expected.size() << endl;
+                    cout << "Test Case 24 Failed!" << endl << endl;
+                    return -1;
+                }
+
+                rc = rbfm->closeFile(scanHandle);
+                assert(rc == success && "Closing the file should not fail.");
+            }
+        }
+    }
+
+    // A callback that returns anything but success stops every worker, and the scan returns it
+    for (unsigned n = 0; n < sizeof(threadCounts) / sizeof(threadCounts[0]); n++) {
+        atomic<unsigned> calls(0);
+        rc = rbfm->parallelScan(fileHandle, recordDescriptor, tests[0], attributes, threadCounts[n],
+            [&](unsigned worker, const RecordBatch &batch) -> RC {
+                calls++;
+                return RBFM_EOF;
+            });
+        unsigned numThreads = threadCounts[n] == 0 ? max(thread::hardware_concurrency(), 1u) : threadCounts[n];
+        if (rc != RBFM_EOF || calls == 0 || calls > numThreads) {
+            cout << "[Fail] A parallel scan with " << threadCounts[n] << " threads whose callback stopped it returned " << rc
+                 << " after " << calls << " batches." << endl;
+            cout << "Test Case 24 Failed!" << endl << endl;
+            return -1;
+        }
+    }
+
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    rc = rbfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    free(record);
+
+    cout << "RBF Test Case 24 Finished! The result will be examined." << endl << endl;
+    return 0;
+}
+
+int main() {
+    // To test the functionality of the record-based file manager
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
+    RC rcmain = RBFTest_24(rbfm);
+
+    return rcmain;
+}
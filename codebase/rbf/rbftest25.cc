@@ -0,0 +1,174 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h> 
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h> 
+#include <algorithm>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+int RBFTest_25(RecordBasedFileManager *rbfm) {
+    // Functions tested
+    // 1. Create Record-Based File
+    // 2. Insert and Delete Records
+    // 3. Scan with conditions on ints and reals, compared a page at a time
+    // 4. Read Attribute, to check each scan one record at a time
+    // 5. Update Records on the page a scan is on
+    // 6. Close and Destroy Record-Based File
+    cout << endl << "***** In RBF Test Case 25 *****" << endl;
+
+    RC rc;
+    string fileName = "test25";
+    rbfm->destroyFile(fileName);
+
+    rc = rbfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    FileHandle fileHandle;
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    vector<Attribute> recordDescriptor;
+    createRecordDescriptor(recordDescriptor);
+
+    void *record = malloc(200);
+    void *returnedData = malloc(200);
+    int numRecords = 10000;
+    int size = 0;
+    vector<RID> rids;
+    RID rid;
+    for (int i = 0; i < numRecords; i++) {
+        prepareIndexedRecord(i, record, &size);
+        rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+        assert(rc == success && "Inserting a record should not fail.");
+        rids.push_back(rid);
+    }
+    vector<RID> liveRids;
+    for (int i = 0; i < numRecords; i++) {
+        if (i % 6 == 2) {
+            rc = rbfm->deleteRecord(fileHandle, recordDescriptor, rids[i]);
+            assert(rc == success && "Deleting a record should not fail.");
+            continue;
+        }
+        liveRids.push_back(rids[i]);
+    }
+
+    // Values below, at and above the ends of the ranges of Age and Height
+    int ages[] = {19, 20, 35, 69, 70};
+    float heights[] = {149.5, 150.0, 165.5, 179.5, 180.0};
+    vector<string> attributes;
+    attributes.push_back("Salary");
+
+    for (unsigned a = 1; a <= 2; a++) {
+        for (unsigned v = 0; v < 5; v++) {
+            const void *value = a == 1 ? (const void *) &ages[v] : (const void *) &heights[v];
+            for (int op = EQ_OP; op < NO_OP; op++) {
+                CompOp compOp = (CompOp) op;
+
+                vector<int> expected;
+                for (unsigned i = 0; i < liveRids.size(); i++) {
+                    rc = rbfm->readAttribute(fileHandle, recordDescriptor, liveRids[i], recordDescriptor[a].name, returnedData);
+                    assert(rc == success && "Reading an attribute should not fail.");
+                    if (!attributeSatisfies(recordDescriptor[a].type, returnedData, compOp, value))
+                        continue;
+
+                    int salary;
+                    rc = rbfm->readAttribute(fileHandle, recordDescriptor, liveRids[i], "Salary", returnedData);
+                    assert(rc == success && "Reading an attribute should not fail.");
+                    memcpy(&salary, (char *) returnedData + 1, sizeof(int));
+                    expected.push_back(salary);
+                }
+
+                vector<int> scanned;
+                RBFM_ScanIterator rbfmScanIterator;
+                rc = rbfm->scan(fileHandle, recordDescriptor, recordDescriptor[a].name, compOp, value, attributes, rbfmScanIterator);
+                assert(rc == success && "Starting a scan should not fail.");
+                while (rbfmScanIterator.getNextRecord(rid, returnedData) != RBFM_EOF) {
+                    int salary;
+                    memcpy(&salary, (char *) returnedData + 1, sizeof(int));
+                    scanned.push_back(salary);
+                }
+                rbfmScanIterator.close();
+
+                sort(expected.begin(), expected.end());
+                sort(scanned.begin(), scanned.end());
+                if (expected != scanned) {
+                    cout << "[Fail] Scanning on " << recordDescriptor[a].name << " with operator " << op << " and value " << v
+                         << " returned " << scanned.size() << " records instead of " << expected.size() << endl;
+                    cout << "Test Case 25 Failed!" << endl << endl;
+                    return -1;
+                }
+            }
+        }
+    }
+
+    // Records updated on the page the scan is on so that they no longer match are not returned
+    int age = 25;
+    RBFM_ScanIterator rbfmScanIterator;
+    rc = rbfm->scan(fileHandle, recordDescriptor, "Age", EQ_OP, &age, attributes, rbfmScanIterator);
+    assert(rc == success && "Starting a scan should not fail.");
+
+    vector<int> updated;
+    int count = 0;
+    while (rbfmScanIterator.getNextRecord(rid, returnedData) != RBFM_EOF) {
+        int salary;
+        memcpy(&salary, (char *) returnedData + 1, sizeof(int));
+        if (find(updated.begin(), updated.end(), salary) != updated.end()) {
+            cout << "[Fail] The scan returned record " << salary << " after it was updated not to match." << endl;
+            cout << "Test Case 25 Failed!" << endl << endl;
+            return -1;
+        }
+
+        if (count++ % 10 == 0) {
+            for (int i = salary + 1; i < numRecords && rids[i].pageNum == rid.pageNum; i++) {
+                if (i % 6 == 2 || 20 + i % 50 != age)
+                    continue;
+
+                unsigned char nullsIndicator = 0;
+                if (i % 11 == 0)
+                    nullsIndicator |= 1 << 7;
+                if (i % 7 == 0)
+                    nullsIndicator |= 1 << 5;
+                string name = string("Emp") + string(i % 23, (char) ('a' + i % 26));
+                prepareRecord(4, &nullsIndicator, name.length(), name, age + 1, 150.0 + (i % 60) / 2.0, i, record, &size);
+                rc = rbfm->updateRecord(fileHandle, recordDescriptor, record, rids[i]);
+                assert(rc == success && "Updating a record should not fail.");
+                updated.push_back(i);
+            }
+        }
+    }
+    rbfmScanIterator.close();
+    if (updated.empty()) {
+        cout << "[Fail] No records were updated during the scan." << endl;
+        cout << "Test Case 25 Failed!" << endl << endl;
+        return -1;
+    }
+
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    rc = rbfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    free(record);
+    free(returnedData);
+
+    cout << "RBF Test Case 25 Finished! The result will be examined." << endl << endl;
+    return 0;
+}
+
+int main() {
+    // To test the functionality of the record-based file manager
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
+    RC rcmain = RBFTest_25(rbfm);
+
+    return rcmain;
+}
@@ -0,0 +1,228 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h> 
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h> 
+#include <algorithm>
+#include <math.h>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+// Runs a set of range scans, which zone maps let skip pages, through a default and a
+// mapped handle of the file, and compares them with readAttribute() one record at a time
+int checkZoneMapScans(RecordBasedFileManager *rbfm, const string &fileName, const vector<Attribute> &recordDescriptor, const vector<RID> &rids)
+{
+    int salaryLow = 5000, salaryHigh = 5100, salaryOut = 100500, salaryTop = 24990;
+    int age = 21;
+    float height = 175.0;
+    float nan = NAN;
+    char name[20];
+    int nameLength = 4;
+    memcpy(name, &nameLength, sizeof(int));
+    memcpy(name + sizeof(int), "Empy", nameLength);
+
+    vector<vector<vector<ScanCondition> > > tests(8, vector<vector<ScanCondition> >(1));
+    tests[0][0].push_back(ScanCondition{"Salary", GE_OP, &salaryLow});
+    tests[0][0].push_back(ScanCondition{"Salary", LE_OP, &salaryHigh});
+    tests[1][0].push_back(ScanCondition{"Salary", EQ_OP, &salaryOut});
+    tests[2][0].push_back(ScanCondition{"Salary", GT_OP, &salaryTop});
+    tests[3][0].push_back(ScanCondition{"Salary", LT_OP, &salaryLow});
+    tests[3][0].push_back(ScanCondition{"Age", LE_OP, &age});
+    tests[4][0].push_back(ScanCondition{"Height", GT_OP, &height});
+    tests[4][0].push_back(ScanCondition{"Salary", GE_OP, &salaryHigh});
+    tests[5][0].push_back(ScanCondition{"EmpName", GE_OP, name});
+    tests[5][0].push_back(ScanCondition{"Salary", LT_OP, &salaryHigh});
+    tests[6][0].push_back(ScanCondition{"Salary", LT_OP, &salaryLow});
+    tests[6].push_back(vector<ScanCondition>());
+    tests[6][1].push_back(ScanCondition{"Salary", EQ_OP, &salaryOut});
+    tests[7][0].push_back(ScanCondition{"Height", NE_OP, &nan});
+
+    void *data = malloc(200);
+    vector<string> attributes;
+    attributes.push_back("Salary");
+    RID rid;
+    RC rc;
+    for (unsigned flags = PFM_OPEN_DEFAULT; flags <= PFM_OPEN_MMAP; flags += PFM_OPEN_MMAP) {
+        FileHandle fileHandle;
+        rc = rbfm->openFile(fileName, fileHandle, flags);
+        assert(rc == success && "Opening the file should not fail.");
+
+        for (unsigned t = 0; t < tests.size(); t++) {
+            vector<int> expected;
+            for (unsigned i = 0; i < rids.size(); i++) {
+                bool matches = false;
+                for (unsigned c = 0; c < tests[t].size() && !matches; c++) {
+                    matches = true;
+                    for (unsigned p = 0; p < tests[t][c].size() && matches; p++) {
+                        const ScanCondition &condition = tests[t][c][p];
+                        unsigned a = 0;
+                        while (recordDescriptor[a].name != condition.attribute)
+                            a++;
+                        rc = rbfm->readAttribute(fileHandle, recordDescriptor, rids[i], condition.attribute, data);
+                        assert(rc == success && "Reading an attribute should not fail.");
+                        matches = attributeSatisfies(recordDescriptor[a].type, data, condition.compOp, condition.value);
+                    }
+                }
+                if (!matches)
+                    continue;
+
+                int salary;
+                rc = rbfm->readAttribute(fileHandle, recordDescriptor, rids[i], "Salary", data);
+                assert(rc == success && "Reading an attribute should not fail.");
+                memcpy(&salary, (char *) data + 1, sizeof(int));
+                expected.push_back(salary);
+            }
+
+            vector<int> scanned;
+            RBFM_ScanIterator rbfmScanIterator;
+            rc = rbfm->scan(fileHandle, recordDescriptor, tests[t], attributes, rbfmScanIterator);
+            assert(rc == success && "Starting a scan should not fail.");
+            while (rbfmScanIterator.getNextRecord(rid, data) != RBFM_EOF) {
+                int salary;
+                memcpy(&salary, (char *) data + 1, sizeof(int));
+                scanned.push_back(salary);
+            }
+            rbfmScanIterator.close();
+
+            sort(expected.begin(), expected.end());
+            sort(scanned.begin(), scanned.end());
+            if (expected != scanned) {
+                cout << "[Fail] Scan " << t << " with flags " << flags << " returned " << scanned.size()
+                     << " records instead of " << expected.size() << endl;
+                return -1;
+            }
+        }
+
+        rc = rbfm->closeFile(fileHandle);
+        assert(rc == success && "Closing the file should not fail.");
+    }
+
+    free(data);
+    return 0;
+}
+
+int RBFTest_26(RecordBasedFileManager *rbfm) {
+    // Functions tested
+    // 1. Create Record-Based File
+    // 2. Insert, Update and Delete Records, and Bulk Load more
+    // 3. Scan with ranges that zone maps rule pages out for
+    // 4. Read Attribute, to check each scan one record at a time
+    // 5. Close and Destroy Record-Based File
+    cout << endl << "***** In RBF Test Case 26 *****" << endl;
+
+    RC rc;
+    string fileName = "test26";
+    rbfm->destroyFile(fileName);
+
+    rc = rbfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    FileHandle fileHandle;
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    vector<Attribute> recordDescriptor;
+    createRecordDescriptor(recordDescriptor);
+
+    // Salaries go up with the page number, so a range of them is on a few pages only
+    void *record = malloc(200);
+    int numRecords = 20000;
+    int size = 0;
+    vector<RID> rids;
+    RID rid;
+    for (int i = 0; i < numRecords; i++) {
+        prepareIndexedRecord(i, record, &size);
+        rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+        assert(rc == success && "Inserting a record should not fail.");
+        rids.push_back(rid);
+    }
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    if (checkZoneMapScans(rbfm, fileName, recordDescriptor, rids) != 0) {
+        cout << "Test Case 26 Failed after inserting records!" << endl << endl;
+        return -1;
+    }
+
+    // Move values out of the range of their pages, in place and by forwarding records
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    for (int i = 500; i < numRecords; i += 1000) {
+        unsigned char nullsIndicator = 0;
+        string name = i % 2000 == 500 ? string("Empzz") : string("Empzz") + string(60, 'z');
+        prepareRecord(4, &nullsIndicator, name.length(), name, 20, 150.0, 100000 + i, record, &size);
+        rc = rbfm->updateRecord(fileHandle, recordDescriptor, record, rids[i]);
+        assert(rc == success && "Updating a record should not fail.");
+    }
+
+    // A delete leaves the zone maps as they are
+    vector<RID> liveRids;
+    for (int i = 0; i < numRecords; i++) {
+        if (i % 5 == 0 && i % 1000 != 500) {
+            rc = rbfm->deleteRecord(fileHandle, recordDescriptor, rids[i]);
+            assert(rc == success && "Deleting a record should not fail.");
+            continue;
+        }
+        liveRids.push_back(rids[i]);
+    }
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    if (checkZoneMapScans(rbfm, fileName, recordDescriptor, liveRids) != 0) {
+        cout << "Test Case 26 Failed after updating and deleting records!" << endl << endl;
+        return -1;
+    }
+
+    // Bulk loaded pages get zone maps too, and a NaN has no range
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    RBFM_BulkLoader loader;
+    rc = rbfm->bulkLoad(fileHandle, recordDescriptor, loader);
+    assert(rc == success && "Starting a bulk load should not fail.");
+    for (int i = numRecords; i < numRecords + 5000; i++) {
+        prepareIndexedRecord(i, record, &size);
+        rc = loader.insertRecord(record, rid);
+        assert(rc == success && "Loading a record should not fail.");
+        liveRids.push_back(rid);
+    }
+    rc = loader.close();
+    assert(rc == success && "Closing a bulk load should not fail.");
+
+    unsigned char nullsIndicator = 0;
+    prepareRecord(4, &nullsIndicator, 3, "Emp", 30, NAN, 5050, record, &size);
+    rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+    assert(rc == success && "Inserting a record should not fail.");
+    liveRids.push_back(rid);
+
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    if (checkZoneMapScans(rbfm, fileName, recordDescriptor, liveRids) != 0) {
+        cout << "Test Case 26 Failed after bulk loading records!" << endl << endl;
+        return -1;
+    }
+
+    rc = rbfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    free(record);
+
+    cout << "RBF Test Case 26 Finished! The result will be examined." << endl << endl;
+    return 0;
+}
+
+int main() {
+    // To test the functionality of the record-based file manager
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
+    RC rcmain = RBFTest_26(rbfm);
+
+    return rcmain;
+}
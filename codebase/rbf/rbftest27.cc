@@ -0,0 +1,168 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h> 
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h> 
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+// Record "index" of prepareIndexedRecord() grown by a name six bytes longer, or a name
+// where it had none
+void prepareGrownRecord(const int index, void *buffer, int *recordSize)
+{
+    unsigned char nullsIndicator = 0;
+    if (index % 7 == 0)
+        nullsIndicator |= 1 << 5;
+
+    string name = string("Emp") + string(index % 23, (char) ('a' + index % 26)) + "xxxxxx";
+    prepareRecord(4, &nullsIndicator, name.length(), name, 20 + index % 50, 150.0 + (index % 60) / 2.0, index, buffer, recordSize);
+}
+
+int RBFTest_27(RecordBasedFileManager *rbfm) {
+    // Functions tested
+    // 1. Create Record-Based File, with a fill factor
+    // 2. Get and Set the Fill Factor of a File
+    // 3. Insert and Bulk Load Records, then Update them to grow
+    // 4. Read Records
+    // 5. Close and Destroy Record-Based File
+    cout << endl << "***** In RBF Test Case 27 *****" << endl;
+
+    RC rc;
+    string fileNames[] = {"test27a", "test27b", "test27c"};
+    unsigned fillFactors[] = {100, 80, 80};
+    bool bulkLoads[] = {false, false, true};
+    for (unsigned f = 0; f < 3; f++)
+        rbfm->destroyFile(fileNames[f]);
+
+    // Fill factors out of (0, 100] are refused, and leave no file behind
+    rc = rbfm->createFile(fileNames[0], PAGE_SIZE, 0);
+    assert(rc != success && "Creating a file with a fill factor of 0 should fail.");
+    rc = rbfm->createFile(fileNames[0], PAGE_SIZE, 101);
+    assert(rc != success && "Creating a file with a fill factor over 100 should fail.");
+    if (FileExists(fileNames[0])) {
+        cout << "[Fail] A file was left behind by a bad fill factor." << endl;
+        cout << "Test Case 27 Failed!" << endl << endl;
+        return -1;
+    }
+
+    vector<Attribute> recordDescriptor;
+    createRecordDescriptor(recordDescriptor);
+    void *record = malloc(200);
+    void *returnedData = malloc(200);
+    int numRecords = 5000;
+    int size = 0;
+    unsigned pagesBefore[3], pagesAfter[3];
+
+    for (unsigned f = 0; f < 3; f++) {
+        rc = rbfm->createFile(fileNames[f], PAGE_SIZE, fillFactors[f]);
+        assert(rc == success && "Creating the file should not fail.");
+
+        FileHandle fileHandle;
+        rc = rbfm->openFile(fileNames[f], fileHandle);
+        assert(rc == success && "Opening the file should not fail.");
+        if (fileHandle.getFillFactor() != fillFactors[f]) {
+            cout << "[Fail] " << fileNames[f] << " has a fill factor of " << fileHandle.getFillFactor() << endl;
+            cout << "Test Case 27 Failed!" << endl << endl;
+            return -1;
+        }
+
+        vector<RID> rids;
+        RID rid;
+        RBFM_BulkLoader loader;
+        if (bulkLoads[f]) {
+            rc = rbfm->bulkLoad(fileHandle, recordDescriptor, loader);
+            assert(rc == success && "Starting a bulk load should not fail.");
+        }
+        for (int i = 0; i < numRecords; i++) {
+            prepareIndexedRecord(i, record, &size);
+            if (bulkLoads[f])
+                rc = loader.insertRecord(record, rid);
+            else
+                rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+            assert(rc == success && "Inserting a record should not fail.");
+            rids.push_back(rid);
+        }
+        if (bulkLoads[f]) {
+            rc = loader.close();
+            assert(rc == success && "Closing a bulk load should not fail.");
+        }
+        pagesBefore[f] = fileHandle.getNumberOfPages();
+
+        // Growing every record fits in the space left on each page, unless there is none
+        for (int i = 0; i < numRecords; i++) {
+            prepareGrownRecord(i, record, &size);
+            rc = rbfm->updateRecord(fileHandle, recordDescriptor, record, rids[i]);
+            assert(rc == success && "Updating a record should not fail.");
+        }
+        pagesAfter[f] = fileHandle.getNumberOfPages();
+
+        for (int i = 0; i < numRecords; i++) {
+            rc = rbfm->readRecord(fileHandle, recordDescriptor, rids[i], returnedData);
+            assert(rc == success && "Reading a record should not fail.");
+            prepareGrownRecord(i, record, &size);
+            if (memcmp(returnedData, record, size) != 0) {
+                cout << "[Fail] Record " << i << " of " << fileNames[f] << " doesn't read back the same." << endl;
+                cout << "Test Case 27 Failed!" << endl << endl;
+                return -1;
+            }
+        }
+
+        rc = rbfm->closeFile(fileHandle);
+        assert(rc == success && "Closing the file should not fail.");
+        cout << fileNames[f] << ": " << pagesBefore[f] << " pages after inserting, " << pagesAfter[f] << " after updating." << endl;
+    }
+
+    if (pagesBefore[1] <= pagesBefore[0] || pagesAfter[1] != pagesBefore[1] || pagesAfter[2] != pagesBefore[2] || pagesAfter[0] <= pagesBefore[0]) {
+        cout << "[Fail] The fill factor didn't leave room on the pages for the records to grow." << endl;
+        cout << "Test Case 27 Failed!" << endl << endl;
+        return -1;
+    }
+
+    // The fill factor is kept in the file
+    FileHandle fileHandle;
+    rc = rbfm->openFile(fileNames[1], fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    rc = fileHandle.setFillFactor(0);
+    assert(rc != success && "Setting a fill factor of 0 should fail.");
+    rc = fileHandle.setFillFactor(90);
+    assert(rc == success && "Setting the fill factor should not fail.");
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    rc = rbfm->openFile(fileNames[1], fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    if (fileHandle.getFillFactor() != 90) {
+        cout << "[Fail] The fill factor read back as " << fileHandle.getFillFactor() << " instead of 90." << endl;
+        cout << "Test Case 27 Failed!" << endl << endl;
+        return -1;
+    }
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    for (unsigned f = 0; f < 3; f++) {
+        rc = rbfm->destroyFile(fileNames[f]);
+        assert(rc == success && "Destroying the file should not fail.");
+    }
+
+    free(record);
+    free(returnedData);
+
+    cout << "RBF Test Case 27 Finished! The result will be examined." << endl << endl;
+    return 0;
+}
+
+int main() {
+    // To test the functionality of the record-based file manager
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
+    RC rcmain = RBFTest_27(rbfm);
+
+    return rcmain;
+}
@@ -279,3 +279,67 @@ void createLargeRecordDescriptor2(vector<Attribute> &recordDescriptor) {
     }
     free(suffix);
 }
+
+// Prepares record "index" in the format of createRecordDescriptor(). Salary holds the
+// index, so records can be told apart whatever order a scan returns them in. Every
+// eleventh record has a null EmpName and every seventh a null Height.
+void prepareIndexedRecord(const int index, void *buffer, int *recordSize)
+{
+    unsigned char nullsIndicator = 0;
+    if (index % 11 == 0)
+        nullsIndicator |= 1 << 7;
+    if (index % 7 == 0)
+        nullsIndicator |= 1 << 5;
+
+    string name = string("Emp") + string(index % 23, (char) ('a' + index % 26));
+    prepareRecord(4, &nullsIndicator, name.length(), name, 20 + index % 50, 150.0 + (index % 60) / 2.0, index, buffer, recordSize);
+}
+
+// Whether an attribute as readAttribute() returns it, a null indicator and the value,
+// satisfies "compOp value". Null attributes satisfy nothing but NO_OP. Scans are checked
+// against this, one record at a time.
+bool attributeSatisfies(AttrType type, const void *attribute, CompOp compOp, const void *value)
+{
+    if (compOp == NO_OP)
+        return true;
+    if (((const unsigned char *) attribute)[0] & (1 << 7))
+        return false;
+
+    const char *data = (const char *) attribute + 1;
+    int cmp = 0;
+    if (type == TypeInt)
+    {
+        int a, b;
+        memcpy(&a, data, sizeof(int));
+        memcpy(&b, value, sizeof(int));
+        cmp = a < b ? -1 : a > b;
+    }
+    else if (type == TypeReal)
+    {
+        float a, b;
+        memcpy(&a, data, sizeof(float));
+        memcpy(&b, value, sizeof(float));
+        // Reals compare ordered, so a NaN is only unequal
+        if (a != a || b != b)
+            return compOp == NE_OP;
+        cmp = a < b ? -1 : a > b;
+    }
+    else
+    {
+        int aLength, bLength;
+        memcpy(&aLength, data, sizeof(int));
+        memcpy(&bLength, value, sizeof(int));
+        cmp = string(data + sizeof(int), aLength).compare(string((const char *) value + sizeof(int), bLength));
+    }
+
+    switch (compOp)
+    {
+        case EQ_OP: return cmp == 0;
+        case LT_OP: return cmp < 0;
+        case LE_OP: return cmp <= 0;
+        case GT_OP: return cmp > 0;
+        case GE_OP: return cmp >= 0;
+        case NE_OP: return cmp != 0;
+        default: return true;
+    }
+}
@@ -2,7 +2,9 @@
 #include "rm.h"
 
 #include <algorithm>
+#include <cstdlib>
 #include <cstring>
+#include <sys/stat.h>
 
 RelationManager* RelationManager::_rm = 0;
 
@@ -15,17 +17,25 @@ RelationManager* RelationManager::instance()
 }
 
 RelationManager::RelationManager()
-: tableDescriptor(createTableDescriptor()), columnDescriptor(createColumnDescriptor())
+: tableDescriptor(createTableDescriptor()), columnDescriptor(createColumnDescriptor()),
+  _maxOpenTables(RM_DEFAULT_MAX_OPEN_TABLES), _catalogLoaded(false), _catalogVersion(0),
+  _catalogHeaderLoaded(false)
 {
+    // Tables kept open still have pages waiting in the buffer pool when the program ends
+    atexit(closeTablesAtExit);
 }
 
 RelationManager::~RelationManager()
 {
+    closeTables();
 }
 
 RC RelationManager::createCatalog()
 {
     RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    // The new catalog is read in on the first lookup
+    invalidateCatalog();
+
     // Create both tables and columns tables, return error if either fails
     RC rc;
     rc = rbfm->createFile(getFileName(TABLES_TABLE_NAME));
@@ -52,7 +62,8 @@ RC RelationManager::createCatalog()
     if (rc)
         return rc;
 
-    return SUCCESS;
+    // The next table gets the first ID after the two catalog tables
+    return createCatalogHeader(COLUMNS_TABLE_ID + 1, 2);
 }
 
 // Just delete the the two catalog files
@@ -62,6 +73,14 @@ RC RelationManager::deleteCatalog()
 
     RC rc;
 
+    invalidateCatalog();
+    rc = closeTable(TABLES_TABLE_NAME);
+    if (rc)
+        return rc;
+    rc = closeTable(COLUMNS_TABLE_NAME);
+    if (rc)
+        return rc;
+
     rc = rbfm->destroyFile(getFileName(TABLES_TABLE_NAME));
     if (rc)
         return rc;
@@ -70,34 +89,67 @@ RC RelationManager::deleteCatalog()
     if (rc)
         return rc;
 
+    // Catalogs from before the header existed don't have one
+    rc = closeCatalogHeader();
+    if (rc)
+        return rc;
+    string headerFileName = getFileName(CATALOG_HEADER_NAME);
+    if (fileExists(headerFileName))
+        return PagedFileManager::instance()->destroyFile(headerFileName);
+
     return SUCCESS;
 }
 
-RC RelationManager::createTable(const string &tableName, const vector<Attribute> &attrs)
+RC RelationManager::createTable(const string &tableName, const vector<Attribute> &attrs, unsigned pageSize,
+                                unsigned fillFactor)
 {
     RC rc;
     RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
 
     // Create the rbfm file to store the table
-    if ((rc = rbfm->createFile(getFileName(tableName))))
+    if ((rc = rbfm->createFile(getFileName(tableName), pageSize, fillFactor)))
         return rc;
 
-    // Get the table's ID
+    // Get the table's ID. Without one the file goes again, so that a retry can create it.
     int32_t id;
     rc = getNextTableID(id);
     if (rc)
+    {
+        rbfm->destroyFile(getFileName(tableName));
         return rc;
+    }
 
-    // Insert the table into the Tables table (0 means this is not a system table)
+    // Insert the table into the Tables table (0 means this is not a system table),
+    // then the table's columns into the Columns table
     rc = insertTable(id, 0, tableName);
+    if (rc == SUCCESS)
+        rc = insertColumns(id, attrs);
     if (rc)
-        return rc;
-
-    // Insert the table's columns into the Columns table
-    rc = insertColumns(id, attrs);
-    if (rc)
-        return rc;
+    {
+        // Take back whatever part of the table made it into the catalog, along with its
+        // file, and read the catalog in again. Its ID stays used up.
+        deleteCatalogRecords(TABLES_TABLE_NAME, tableDescriptor, TABLES_COL_TABLE_ID, id);
+        deleteCatalogRecords(COLUMNS_TABLE_NAME, columnDescriptor, COLUMNS_COL_TABLE_ID, id);
+        invalidateCatalog();
+        rbfm->destroyFile(getFileName(tableName));
+
+        // A header that still counts the table is worse than the failed create
+        CatalogHeader header = _catalogHeader;
+        header.tableCount--;
+        header.version++;
+        RC headerRc = writeCatalogHeader(header);
+        return headerRc ? headerRc : rc;
+    }
 
+    // Keep the cached catalog in step
+    if (_catalogLoaded)
+    {
+        TableInfo &info = _catalog[tableName];
+        info.id = id;
+        info.system = false;
+        info.layout = RecordLayout(attrs);
+    }
+    _catalogVersion++;
     return SUCCESS;
 }
 
@@ -114,8 +166,8 @@ RC RelationManager::deleteTable(const string &tableName)
     if (isSystem)
         return RM_CANNOT_MOD_SYS_TBL;
 
-    // Delete the rbfm file holding this table's entries
-    rc = rbfm->destroyFile(getFileName(tableName));
+    // The header has to be read before the table disappears from Tables
+    rc = loadCatalogHeader();
     if (rc)
         return rc;
 
@@ -125,250 +177,226 @@ RC RelationManager::deleteTable(const string &tableName)
     if (rc)
         return rc;
 
-    // Open tables file
-    FileHandle fileHandle;
-    rc = rbfm->openFile(getFileName(TABLES_TABLE_NAME), fileHandle);
-    if (rc)
-        return rc;
-
-    // Find entry with same table ID
-    // Use empty projection because we only care about RID
-    RBFM_ScanIterator rbfm_si;
-    vector<string> projection; // Empty
-    void *value = &id;
-
-    rc = rbfm->scan(fileHandle, tableDescriptor, TABLES_COL_TABLE_ID, EQ_OP, value, projection, rbfm_si);
-
-    RID rid;
-    rc = rbfm_si.getNextRecord(rid, NULL);
+    // Close the table's file if it is kept open, while nothing has been removed yet
+    rc = closeTable(tableName);
     if (rc)
         return rc;
 
-    // Delete RID from table and close file
-    rbfm->deleteRecord(fileHandle, tableDescriptor, rid);
-    rbfm->closeFile(fileHandle);
-    rbfm_si.close();
-
-    // Delete from Columns table
-    rc = rbfm->openFile(getFileName(COLUMNS_TABLE_NAME), fileHandle);
+    // Delete the table's entry in Tables, then its entries in Columns. If either fails
+    // partway the cached catalog no longer matches, so it is read in again.
+    rc = deleteCatalogRecords(TABLES_TABLE_NAME, tableDescriptor, TABLES_COL_TABLE_ID, id);
+    if (rc == SUCCESS)
+        rc = deleteCatalogRecords(COLUMNS_TABLE_NAME, columnDescriptor, COLUMNS_COL_TABLE_ID, id);
     if (rc)
-        return rc;
-
-    // Find all of the entries whose table-id equal this table's ID
-    rbfm->scan(fileHandle, columnDescriptor, COLUMNS_COL_TABLE_ID, EQ_OP, value, projection, rbfm_si);
-
-    while((rc = rbfm_si.getNextRecord(rid, NULL)) == SUCCESS)
     {
-        // Delete each result with the returned RID
-        rc = rbfm->deleteRecord(fileHandle, columnDescriptor, rid);
-        if (rc)
-            return rc;
-    }
-    if (rc != RBFM_EOF)
+        invalidateCatalog();
         return rc;
+    }
+    _catalog.erase(tableName);
+    _catalogVersion++;
 
-    rbfm->closeFile(fileHandle);
-    rbfm_si.close();
+    CatalogHeader header = _catalogHeader;
+    header.tableCount--;
+    header.version++;
+    RC headerRc = writeCatalogHeader(header);
 
-    return SUCCESS;
+    // Nothing refers to the rbfm file holding this table's entries any more
+    rc = rbfm->destroyFile(getFileName(tableName));
+    return headerRc ? headerRc : rc;
 }
 
 // Fills the given attribute vector with the recordDescriptor of tableName
 RC RelationManager::getAttributes(const string &tableName, vector<Attribute> &attrs)
 {
-    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
     // Clear out any old values
     attrs.clear();
-    RC rc;
 
-    int32_t id;
-    rc = getTableID(tableName, id);
+    const vector<Attribute> *recordDescriptor;
+    RC rc = getAttributes(tableName, recordDescriptor);
     if (rc)
         return rc;
 
-    void *value = &id;
+    attrs = *recordDescriptor;
+    return SUCCESS;
+}
 
-    // We need to get the three values that make up an Attribute: name, type, length
-    // We also need the position of each attribute in the row
-    RBFM_ScanIterator rbfm_si;
-    vector<string> projection;
-    projection.push_back(COLUMNS_COL_COLUMN_NAME);
-    projection.push_back(COLUMNS_COL_COLUMN_TYPE);
-    projection.push_back(COLUMNS_COL_COLUMN_LENGTH);
-    projection.push_back(COLUMNS_COL_COLUMN_POSITION);
+// Points attrs at the cached recordDescriptor of tableName, which stays valid until the catalog changes
+RC RelationManager::getAttributes(const string &tableName, const vector<Attribute> *&attrs)
+{
+    const TableInfo *info;
+    RC rc = getTableInfo(tableName, info);
+    if (rc)
+        return rc;
 
-    FileHandle fileHandle;
-    rc = rbfm->openFile(getFileName(COLUMNS_TABLE_NAME), fileHandle);
+    attrs = &info->layout.getRecordDescriptor();
+    return SUCCESS;
+}
+
+unsigned RelationManager::getCatalogVersion()
+{
+    return _catalogVersion;
+}
+
+RC RelationManager::insertTuple(const string &tableName, const void *data, RID &rid)
+{
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    RC rc;
+
+    // Get recordDescriptor. If this is a system table, we cannot modify it
+    const TableInfo *info;
+    rc = getTableInfo(tableName, info);
     if (rc)
         return rc;
+    if (info->system)
+        return RM_CANNOT_MOD_SYS_TBL;
+    const RecordLayout &layout = info->layout;
 
-    // Scan through the Column table for all entries whose table-id equals tableName's table id.
-    rc = rbfm->scan(fileHandle, columnDescriptor, COLUMNS_COL_TABLE_ID, EQ_OP, value, projection, rbfm_si);
+    // And get fileHandle
+    FileHandle *fileHandle;
+    rc = openTable(tableName, fileHandle);
     if (rc)
         return rc;
 
-    RID rid;
-    void *data = malloc(COLUMNS_RECORD_DATA_SIZE);
+    // Let rbfm do all the work
+    rc = rbfm->insertRecord(*fileHandle, layout, data, rid);
+    releaseTable(tableName);
 
-    // IndexedAttr is an attr with a position. The position will be used to sort the vector
-    vector<IndexedAttr> iattrs;
-    while ((rc = rbfm_si.getNextRecord(rid, data)) == SUCCESS)
-    {
-        // For each entry, create an IndexedAttr, and fill it with the 4 results
-        IndexedAttr attr;
-        unsigned offset = 0;
+    return rc;
+}
 
-        // For the Columns table, there should never be a null column
-        char null;
-        memcpy(&null, data, 1);
-        if (null)
-            rc = RM_NULL_COLUMN;
+RC RelationManager::insertTuples(const string &tableName, const vector<const void *> &data, vector<RID> &rids)
+{
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    RC rc;
 
-        // Read in name
-        offset = 1;
-        int32_t nameLen;
-        memcpy(&nameLen, (char*) data + offset, VARCHAR_LENGTH_SIZE);
-        offset += VARCHAR_LENGTH_SIZE;
-        char name[nameLen + 1];
-        name[nameLen] = '\0';
-        memcpy(name, (char*) data + offset, nameLen);
-        offset += nameLen;
-        attr.attr.name = string(name);
+    // Get recordDescriptor. If this is a system table, we cannot modify it
+    const TableInfo *info;
+    rc = getTableInfo(tableName, info);
+    if (rc)
+        return rc;
+    if (info->system)
+        return RM_CANNOT_MOD_SYS_TBL;
 
-        // read in type
-        int32_t type;
-        memcpy(&type, (char*) data + offset, INT_SIZE);
-        offset += INT_SIZE;
-        attr.attr.type = (AttrType)type;
+    // And get fileHandle
+    FileHandle *fileHandle;
+    rc = openTable(tableName, fileHandle);
+    if (rc)
+        return rc;
 
-        // Read in length
-        int32_t length;
-        memcpy(&length, (char*) data + offset, INT_SIZE);
-        offset += INT_SIZE;
-        attr.attr.length = length;
+    // Let rbfm fill the pages
+    rc = rbfm->insertRecords(*fileHandle, info->layout, data, rids);
+    releaseTable(tableName);
 
-        // Read in position
-        int32_t pos;
-        memcpy(&pos, (char*) data + offset, INT_SIZE);
-        offset += INT_SIZE;
-        attr.pos = pos;
+    return rc;
+}
 
-        iattrs.push_back(attr);
-    }
-    // Do cleanup
-    rbfm_si.close();
-    rbfm->closeFile(fileHandle);
-    free(data);
-    // If we ended on an error, return that error
-    if (rc != RBFM_EOF)
+RC RelationManager::bulkLoad(const string &tableName, RM_BulkLoader &rm_BulkLoader)
+{
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    RC rc = rm_BulkLoader.close();
+    if (rc)
         return rc;
 
-    // Sort attributes by position ascending
-    auto comp = [](IndexedAttr first, IndexedAttr second) 
-        {return first.pos < second.pos;};
-    sort(iattrs.begin(), iattrs.end(), comp);
+    // Get recordDescriptor. If this is a system table, we cannot modify it
+    const TableInfo *info;
+    rc = getTableInfo(tableName, info);
+    if (rc)
+        return rc;
+    if (info->system)
+        return RM_CANNOT_MOD_SYS_TBL;
 
-    // Fill up our result with the Attributes in sorted order
-    for (auto attr : iattrs)
+    // The file handle is held until the loader is closed, so the table can't be deleted under it
+    FileHandle *fileHandle;
+    rc = openTable(tableName, fileHandle);
+    if (rc)
+        return rc;
+
+    rc = rbfm->bulkLoad(*fileHandle, info->layout, rm_BulkLoader.rbfm_loader);
+    if (rc)
     {
-        attrs.push_back(attr.attr);
+        releaseTable(tableName);
+        return rc;
     }
-
+    rm_BulkLoader.tableName = tableName;
     return SUCCESS;
 }
 
-RC RelationManager::insertTuple(const string &tableName, const void *data, RID &rid)
+RC RelationManager::deleteTuple(const string &tableName, const RID &rid)
 {
     RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
     RC rc;
 
-    // If this is a system table, we cannot modify it
-    bool isSystem;
-    rc = isSystemTable(isSystem, tableName);
+    // Get recordDescriptor. If this is a system table, we cannot modify it
+    const TableInfo *info;
+    rc = getTableInfo(tableName, info);
     if (rc)
         return rc;
-    if (isSystem)
+    if (info->system)
         return RM_CANNOT_MOD_SYS_TBL;
-
-    // Get recordDescriptor
-    vector<Attribute> recordDescriptor;
-    rc = getAttributes(tableName, recordDescriptor);
-    if (rc)
-        return rc;
+    const RecordLayout &layout = info->layout;
 
     // And get fileHandle
-    FileHandle fileHandle;
-    rc = rbfm->openFile(getFileName(tableName), fileHandle);
+    FileHandle *fileHandle;
+    rc = openTable(tableName, fileHandle);
     if (rc)
         return rc;
 
     // Let rbfm do all the work
-    rc = rbfm->insertRecord(fileHandle, recordDescriptor, data, rid);
-    rbfm->closeFile(fileHandle);
+    rc = rbfm->deleteRecord(*fileHandle, layout.getRecordDescriptor(), rid);
+    releaseTable(tableName);
 
     return rc;
 }
 
-RC RelationManager::deleteTuple(const string &tableName, const RID &rid)
+RC RelationManager::updateTuple(const string &tableName, const void *data, const RID &rid)
 {
     RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
     RC rc;
 
-    // If this is a system table, we cannot modify it
-    bool isSystem;
-    rc = isSystemTable(isSystem, tableName);
+    // Get recordDescriptor. If this is a system table, we cannot modify it
+    const TableInfo *info;
+    rc = getTableInfo(tableName, info);
     if (rc)
         return rc;
-    if (isSystem)
+    if (info->system)
         return RM_CANNOT_MOD_SYS_TBL;
-
-    // Get recordDescriptor
-    vector<Attribute> recordDescriptor;
-    rc = getAttributes(tableName, recordDescriptor);
-    if (rc)
-        return rc;
+    const RecordLayout &layout = info->layout;
 
     // And get fileHandle
-    FileHandle fileHandle;
-    rc = rbfm->openFile(getFileName(tableName), fileHandle);
+    FileHandle *fileHandle;
+    rc = openTable(tableName, fileHandle);
     if (rc)
         return rc;
 
     // Let rbfm do all the work
-    rc = rbfm->deleteRecord(fileHandle, recordDescriptor, rid);
-    rbfm->closeFile(fileHandle);
+    rc = rbfm->updateRecord(*fileHandle, layout, data, rid);
+    releaseTable(tableName);
 
     return rc;
 }
 
-RC RelationManager::updateTuple(const string &tableName, const void *data, const RID &rid)
+RC RelationManager::deforwardTuples(const string &tableName, PageNum &pageNum, unsigned maxPages, bool &done)
 {
     RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
     RC rc;
 
-    // If this is a system table, we cannot modify it
-    bool isSystem;
-    rc = isSystemTable(isSystem, tableName);
+    // Get recordDescriptor. If this is a system table, we cannot modify it
+    const TableInfo *info;
+    rc = getTableInfo(tableName, info);
     if (rc)
         return rc;
-    if (isSystem)
+    if (info->system)
         return RM_CANNOT_MOD_SYS_TBL;
 
-    // Get recordDescriptor
-    vector<Attribute> recordDescriptor;
-    rc = getAttributes(tableName, recordDescriptor);
-    if (rc)
-        return rc;
-
     // And get fileHandle
-    FileHandle fileHandle;
-    rc = rbfm->openFile(getFileName(tableName), fileHandle);
+    FileHandle *fileHandle;
+    rc = openTable(tableName, fileHandle);
     if (rc)
         return rc;
 
-    // Let rbfm do all the work
-    rc = rbfm->updateRecord(fileHandle, recordDescriptor, data, rid);
-    rbfm->closeFile(fileHandle);
+    rc = rbfm->deforwardRecords(*fileHandle, info->layout, pageNum, maxPages);
+    done = pageNum >= fileHandle->getNumberOfPages();
+    releaseTable(tableName);
 
     return rc;
 }
@@ -378,21 +406,42 @@ RC RelationManager::readTuple(const string &tableName, const RID &rid, void *dat
     RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
     RC rc;
 
-    // Get record descriptor
-    vector<Attribute> recordDescriptor;
-    rc = getAttributes(tableName, recordDescriptor);
+    // Get the compiled record descriptor
+    const TableInfo *info;
+    rc = getTableInfo(tableName, info);
     if (rc)
         return rc;
 
     // And get fileHandle
-    FileHandle fileHandle;
-    rc = rbfm->openFile(getFileName(tableName), fileHandle);
+    FileHandle *fileHandle;
+    rc = openTable(tableName, fileHandle);
     if (rc)
         return rc;
 
     // Let rbfm do all the work
-    rc = rbfm->readRecord(fileHandle, recordDescriptor, rid, data);
-    rbfm->closeFile(fileHandle);
+    rc = rbfm->readRecord(*fileHandle, info->layout, rid, data);
+    releaseTable(tableName);
+    return rc;
+}
+
+RC RelationManager::readTupleView(const string &tableName, const RID &rid, RecordView &view)
+{
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
+    // Only the table's existence matters, the view needs no descriptor
+    const TableInfo *info;
+    RC rc = getTableInfo(tableName, info);
+    if (rc)
+        return rc;
+
+    FileHandle *fileHandle;
+    rc = openTable(tableName, fileHandle);
+    if (rc)
+        return rc;
+
+    // The view holds its own pin on the page, so the handle can go back right away
+    rc = rbfm->readRecordView(*fileHandle, rid, view);
+    releaseTable(tableName);
     return rc;
 }
 
@@ -408,21 +457,126 @@ RC RelationManager::readAttribute(const string &tableName, const RID &rid, const
     RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
     RC rc;
 
-    vector<Attribute> recordDescriptor;
-    rc = getAttributes(tableName, recordDescriptor);
+    const TableInfo *info;
+    rc = getTableInfo(tableName, info);
     if (rc)
         return rc;
 
-    FileHandle fileHandle;
-    rc = rbfm->openFile(getFileName(tableName), fileHandle);
+    FileHandle *fileHandle;
+    rc = openTable(tableName, fileHandle);
     if (rc)
         return rc;
 
-    rc = rbfm->readAttribute(fileHandle, recordDescriptor, rid, attributeName, data);
-    rbfm->closeFile(fileHandle);
+    rc = rbfm->readAttribute(*fileHandle, info->layout, rid, attributeName, data);
+    releaseTable(tableName);
     return rc;
 }
 
+RC RelationManager::setMaxOpenTables(unsigned maxOpenTables)
+{
+    _maxOpenTables = maxOpenTables;
+    return closeIdleTables(maxOpenTables);
+}
+
+RC RelationManager::closeTables()
+{
+    RC rc = closeIdleTables(0);
+    if (rc)
+        return rc;
+    // Whatever is left is still in use
+    return _tables.empty() ? SUCCESS : RM_TABLE_IN_USE;
+}
+
+// Table handle cache ////////////////
+
+RC RelationManager::openTable(const string &tableName, FileHandle *&fileHandle)
+{
+    auto it = _tables.find(tableName);
+    if (it == _tables.end())
+    {
+        RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+        TableHandle &table = _tables[tableName];
+        RC rc = rbfm->openFile(getFileName(tableName), table.fileHandle);
+        if (rc)
+        {
+            _tables.erase(tableName);
+            return rc;
+        }
+        table.refCount = 0;
+        _tablesLRU.push_front(tableName);
+        table.lruPosition = _tablesLRU.begin();
+        it = _tables.find(tableName);
+    }
+    else
+    {
+        // Move the table to the front of the LRU list
+        _tablesLRU.splice(_tablesLRU.begin(), _tablesLRU, it->second.lruPosition);
+    }
+
+    it->second.refCount++;
+    fileHandle = &it->second.fileHandle;
+
+    // Make room for the new file now that it can't be picked itself. The table is open
+    // either way, a file that fails to close stays cached and is tried again later.
+    if (_tables.size() > _maxOpenTables)
+        closeIdleTables(_maxOpenTables);
+    return SUCCESS;
+}
+
+void RelationManager::releaseTable(const string &tableName)
+{
+    auto it = _tables.find(tableName);
+    if (it == _tables.end() || it->second.refCount == 0)
+        return;
+
+    // Close the table right away if it only stayed open because it was in use
+    if (--it->second.refCount == 0 && _tables.size() > _maxOpenTables)
+        closeIdleTables(_maxOpenTables);
+}
+
+RC RelationManager::closeTable(const string &tableName)
+{
+    auto it = _tables.find(tableName);
+    if (it == _tables.end())
+        return SUCCESS;
+    if (it->second.refCount > 0)
+        return RM_TABLE_IN_USE;
+
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    RC rc = rbfm->closeFile(it->second.fileHandle);
+    if (rc)
+        return rc;
+    _tablesLRU.erase(it->second.lruPosition);
+    _tables.erase(it);
+    return SUCCESS;
+}
+
+// Closes idle tables, least recently used first, until no more than maxOpenTables are open
+RC RelationManager::closeIdleTables(unsigned maxOpenTables)
+{
+    auto lru = _tablesLRU.end();
+    while (_tables.size() > maxOpenTables && lru != _tablesLRU.begin())
+    {
+        --lru;
+        if (_tables[*lru].refCount > 0)
+            continue;
+
+        // closeTable() drops the list entry, so step past it first
+        string tableName = *lru;
+        ++lru;
+        RC rc = closeTable(tableName);
+        if (rc)
+            return rc;
+    }
+    return SUCCESS;
+}
+
+void RelationManager::closeTablesAtExit()
+{
+    if (_rm)
+        _rm->closeTables();
+}
+
 string RelationManager::getFileName(const char *tableName)
 {
     return string(tableName) + string(TABLE_FILE_EXTENSION);
@@ -569,8 +723,8 @@ RC RelationManager::insertColumns(int32_t id, const vector<Attribute> &recordDes
 
     RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
 
-    FileHandle fileHandle;
-    rc = rbfm->openFile(getFileName(COLUMNS_TABLE_NAME), fileHandle);
+    FileHandle *fileHandle;
+    rc = openTable(COLUMNS_TABLE_NAME, fileHandle);
     if (rc)
         return rc;
 
@@ -580,44 +734,93 @@ RC RelationManager::insertColumns(int32_t id, const vector<Attribute> &recordDes
     {
         int32_t pos = i+1;
         prepareColumnsRecordData(id, pos, recordDescriptor[i], columnData);
-        rc = rbfm->insertRecord(fileHandle, columnDescriptor, columnData, rid);
+        rc = rbfm->insertRecord(*fileHandle, columnDescriptor, columnData, rid);
         if (rc)
-            return rc;
+            break;
     }
 
-    rbfm->closeFile(fileHandle);
+    releaseTable(COLUMNS_TABLE_NAME);
     free(columnData);
-    return SUCCESS;
+    return rc;
 }
 
 RC RelationManager::insertTable(int32_t id, int32_t system, const string &tableName)
 {
-    FileHandle fileHandle;
+    FileHandle *fileHandle;
     RID rid;
     RC rc;
     RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
 
-    rc = rbfm->openFile(getFileName(TABLES_TABLE_NAME), fileHandle);
+    rc = openTable(TABLES_TABLE_NAME, fileHandle);
     if (rc)
         return rc;
 
     void *tableData = malloc (TABLES_RECORD_DATA_SIZE);
     prepareTablesRecordData(id, system, tableName, tableData);
-    rc = rbfm->insertRecord(fileHandle, tableDescriptor, tableData, rid);
+    rc = rbfm->insertRecord(*fileHandle, tableDescriptor, tableData, rid);
 
-    rbfm->closeFile(fileHandle);
+    releaseTable(TABLES_TABLE_NAME);
     free (tableData);
     return rc;
 }
 
-// Get the next table ID for creating a table
+RC RelationManager::deleteCatalogRecords(const string &catalogTable, const vector<Attribute> &recordDescriptor,
+                                         const string &attributeName, int32_t id)
+{
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    FileHandle *fileHandle;
+    RC rc = openTable(catalogTable, fileHandle);
+    if (rc)
+        return rc;
+
+    // Use empty projection because we only care about RID
+    RBFM_ScanIterator rbfm_si;
+    vector<string> projection; // Empty
+    rc = rbfm->scan(*fileHandle, recordDescriptor, attributeName, EQ_OP, &id, projection, rbfm_si);
+    if (rc == SUCCESS)
+    {
+        RID rid;
+        while ((rc = rbfm_si.getNextRecord(rid, NULL)) == SUCCESS)
+        {
+            // Delete each result with the returned RID
+            rc = rbfm->deleteRecord(*fileHandle, recordDescriptor, rid);
+            if (rc)
+                break;
+        }
+        rbfm_si.close();
+        if (rc == RBFM_EOF)
+            rc = SUCCESS;
+    }
+    releaseTable(catalogTable);
+    return rc;
+}
+
+// Reserves the next table ID for creating a table and counts the new table in the catalog header
 RC RelationManager::getNextTableID(int32_t &table_id)
+{
+    RC rc = loadCatalogHeader();
+    if (rc)
+        return rc;
+
+    CatalogHeader header = _catalogHeader;
+    header.nextTableID++;
+    header.tableCount++;
+    header.version++;
+    rc = writeCatalogHeader(header);
+    if (rc)
+        return rc;
+    table_id = header.nextTableID - 1;
+    return SUCCESS;
+}
+
+// Scans the Tables table for what the catalog header holds
+RC RelationManager::scanTables(int32_t &nextTableID, uint32_t &tableCount)
 {
     RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
-    FileHandle fileHandle;
+    FileHandle *fileHandle;
     RC rc;
 
-    rc = rbfm->openFile(getFileName(TABLES_TABLE_NAME), fileHandle);
+    rc = openTable(TABLES_TABLE_NAME, fileHandle);
     if (rc)
         return rc;
 
@@ -627,11 +830,12 @@ RC RelationManager::getNextTableID(int32_t &table_id)
 
     // Scan through all tables to get largest ID value
     RBFM_ScanIterator rbfm_si;
-    rc = rbfm->scan(fileHandle, tableDescriptor, TABLES_COL_TABLE_ID, NO_OP, NULL, projection, rbfm_si);
+    rc = rbfm->scan(*fileHandle, tableDescriptor, TABLES_COL_TABLE_ID, NO_OP, NULL, projection, rbfm_si);
 
     RID rid;
     void *data = malloc (1 + INT_SIZE);
     int32_t max_table_id = 0;
+    tableCount = 0;
     while ((rc = rbfm_si.getNextRecord(rid, data)) == (SUCCESS))
     {
         // Parse out the table id, compare it with the current max
@@ -639,6 +843,7 @@ RC RelationManager::getNextTableID(int32_t &table_id)
         fromAPI(tid, data);
         if (tid > max_table_id)
             max_table_id = tid;
+        tableCount++;
     }
     // If we ended on eof, then we were successful
     if (rc == RM_EOF)
@@ -646,96 +851,336 @@ RC RelationManager::getNextTableID(int32_t &table_id)
 
     free(data);
     // Next table ID is 1 more than largest table id
-    table_id = max_table_id + 1;
-    rbfm->closeFile(fileHandle);
+    nextTableID = max_table_id + 1;
     rbfm_si.close();
-    return SUCCESS;
+    releaseTable(TABLES_TABLE_NAME);
+    return rc;
 }
 
 // Gets the table ID of the given tableName
 RC RelationManager::getTableID(const string &tableName, int32_t &tableID)
 {
-    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
-    FileHandle fileHandle;
-    RC rc;
+    const TableInfo *info;
+    RC rc = getTableInfo(tableName, info);
+    if (rc)
+        return rc;
+
+    tableID = info->id;
+    return SUCCESS;
+}
 
-    rc = rbfm->openFile(getFileName(TABLES_TABLE_NAME), fileHandle);
+// Determine if table tableName is a system table. Set the boolean argument as the result
+RC RelationManager::isSystemTable(bool &system, const string &tableName)
+{
+    // Tables that don't exist aren't system tables
+    const TableInfo *info;
+    RC rc = getTableInfo(tableName, info);
+    system = rc == SUCCESS && info->system;
+    return rc == RBFM_EOF ? SUCCESS : rc;
+}
+
+// Catalog header ///////////////
+
+RC RelationManager::loadCatalogHeader()
+{
+    if (_catalogHeaderLoaded)
+        return SUCCESS;
+
+    // Catalogs from before the header existed get one built from the Tables table
+    string fileName = getFileName(CATALOG_HEADER_NAME);
+    if (!fileExists(fileName))
+    {
+        int32_t nextTableID;
+        uint32_t tableCount;
+        RC rc = scanTables(nextTableID, tableCount);
+        if (rc)
+            return rc;
+        return createCatalogHeader(nextTableID, tableCount);
+    }
+
+    PagedFileManager *pfm = PagedFileManager::instance();
+    RC rc = pfm->openFile(fileName, _catalogHeaderFile);
     if (rc)
         return rc;
 
-    // We only care about the table ID
-    vector<string> projection;
-    projection.push_back(TABLES_COL_TABLE_ID);
+    void *page = calloc(_catalogHeaderFile.getPageSize(), 1);
+    if (page == NULL)
+    {
+        pfm->closeFile(_catalogHeaderFile);
+        return RBFM_MALLOC_FAILED;
+    }
+    rc = _catalogHeaderFile.readPage(0, page);
+    if (rc == SUCCESS)
+        memcpy(&_catalogHeader, page, sizeof(CatalogHeader));
+    free(page);
+    if (rc)
+    {
+        pfm->closeFile(_catalogHeaderFile);
+        return rc;
+    }
 
-    // Fill value with the string tablename in api format (without null indicator)
-    void *value = malloc(4 + TABLES_COL_TABLE_NAME_SIZE);
-    int32_t name_len = tableName.length();
-    memcpy(value, &name_len, INT_SIZE);
-    memcpy((char*)value + INT_SIZE, tableName.c_str(), name_len);
+    _catalogHeaderLoaded = true;
+    return SUCCESS;
+}
 
-    // Find the table entries whose table-name field matches tableName
-    RBFM_ScanIterator rbfm_si;
-    rc = rbfm->scan(fileHandle, tableDescriptor, TABLES_COL_TABLE_NAME, EQ_OP, value, projection, rbfm_si);
+// Writes header with a single page write, so it is never seen half updated. The cached
+// header only takes it on once it is on disk.
+RC RelationManager::writeCatalogHeader(const CatalogHeader &header)
+{
+    void *page = calloc(_catalogHeaderFile.getPageSize(), 1);
+    if (page == NULL)
+        return RBFM_MALLOC_FAILED;
+    memcpy(page, &header, sizeof(CatalogHeader));
+    RC rc = _catalogHeaderFile.writePage(0, page);
+    free(page);
+    if (rc)
+        return rc;
+    _catalogHeader = header;
+    return SUCCESS;
+}
 
-    // There will only be one such entry, so we use if rather than while
-    RID rid;
-    void *data = malloc (1 + INT_SIZE);
-    if ((rc = rbfm_si.getNextRecord(rid, data)) == SUCCESS)
+RC RelationManager::createCatalogHeader(int32_t nextTableID, uint32_t tableCount)
+{
+    PagedFileManager *pfm = PagedFileManager::instance();
+    RC rc = closeCatalogHeader();
+    if (rc)
+        return rc;
+
+    // A header left behind by an earlier catalog is replaced
+    string fileName = getFileName(CATALOG_HEADER_NAME);
+    if (fileExists(fileName) && (rc = pfm->destroyFile(fileName)))
+        return rc;
+    if ((rc = pfm->createFile(fileName)))
+        return rc;
+    if ((rc = pfm->openFile(fileName, _catalogHeaderFile)))
+        return rc;
+    // The file never grows past its one page
+    _catalogHeaderFile.setExtentSize(1);
+
+    CatalogHeader header;
+    header.nextTableID = nextTableID;
+    header.tableCount = tableCount;
+    header.version = 0;
+
+    void *page = calloc(_catalogHeaderFile.getPageSize(), 1);
+    if (page == NULL)
+        rc = RBFM_MALLOC_FAILED;
+    else
     {
-        int32_t tid;
-        fromAPI(tid, data);
-        tableID = tid;
+        memcpy(page, &header, sizeof(CatalogHeader));
+        rc = _catalogHeaderFile.appendPage(page);
+        free(page);
+    }
+    // The file stays open, so record its size right away
+    if (rc == SUCCESS)
+        rc = _catalogHeaderFile.flush();
+    if (rc)
+    {
+        pfm->closeFile(_catalogHeaderFile);
+        return rc;
     }
 
-    free(data);
-    free(value);
-    rbfm->closeFile(fileHandle);
-    rbfm_si.close();
-    return rc;
+    _catalogHeader = header;
+    _catalogHeaderLoaded = true;
+    return SUCCESS;
 }
 
-// Determine if table tableName is a system table. Set the boolean argument as the result
-RC RelationManager::isSystemTable(bool &system, const string &tableName)
+RC RelationManager::closeCatalogHeader()
+{
+    if (!_catalogHeaderLoaded)
+        return SUCCESS;
+
+    _catalogHeaderLoaded = false;
+    PagedFileManager *pfm = PagedFileManager::instance();
+    return pfm->closeFile(_catalogHeaderFile);
+}
+
+bool RelationManager::fileExists(const string &fileName)
+{
+    // If stat fails, we can safely assume the file doesn't exist
+    struct stat sb;
+    return stat(fileName.c_str(), &sb) == 0;
+}
+
+// Catalog cache ///////////////
+
+// Finds tableName in the catalog, reading the catalog in on first use
+RC RelationManager::getTableInfo(const string &tableName, const TableInfo *&info)
+{
+    if (!_catalogLoaded)
+    {
+        RC rc = loadCatalog();
+        if (rc)
+            return rc;
+    }
+
+    auto it = _catalog.find(tableName);
+    if (it == _catalog.end())
+        return RBFM_EOF;
+    info = &it->second;
+    return SUCCESS;
+}
+
+// Drops the cached catalog, it is read in again on the next lookup
+void RelationManager::invalidateCatalog()
+{
+    _catalog.clear();
+    _catalogLoaded = false;
+    _catalogVersion++;
+}
+
+// Reads every table from the Tables table and its columns from the Columns table
+RC RelationManager::loadCatalog()
 {
     RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
-    FileHandle fileHandle;
+    FileHandle *fileHandle;
     RC rc;
 
-    rc = rbfm->openFile(getFileName(TABLES_TABLE_NAME), fileHandle);
+    _catalog.clear();
+
+    rc = openTable(TABLES_TABLE_NAME, fileHandle);
     if (rc)
         return rc;
 
-    // We only care about system column
     vector<string> projection;
+    projection.push_back(TABLES_COL_TABLE_ID);
+    projection.push_back(TABLES_COL_TABLE_NAME);
     projection.push_back(TABLES_COL_SYSTEM);
 
-    // Set up value to be tableName in API format (without null indicator)
-    void *value = malloc(5 + TABLES_COL_TABLE_NAME_SIZE);
-    int32_t name_len = tableName.length();
-    memcpy(value, &name_len, INT_SIZE);
-    memcpy((char*)value + INT_SIZE, tableName.c_str(), name_len);
-
-    // Find table whose table-name is equal to tableName
     RBFM_ScanIterator rbfm_si;
-    rc = rbfm->scan(fileHandle, tableDescriptor, TABLES_COL_TABLE_NAME, EQ_OP, value, projection, rbfm_si);
+    rc = rbfm->scan(*fileHandle, tableDescriptor, TABLES_COL_TABLE_ID, NO_OP, NULL, projection, rbfm_si);
 
     RID rid;
-    void *data = malloc (1 + INT_SIZE);
-    if ((rc = rbfm_si.getNextRecord(rid, data)) == SUCCESS)
+    void *data = malloc(TABLES_RECORD_DATA_SIZE);
+    // Table names by ID, used to file the columns below
+    unordered_map<int32_t, string> tableNames;
+    while (rc == SUCCESS && (rc = rbfm_si.getNextRecord(rid, data)) == SUCCESS)
     {
-        // Parse the system field from that table entry
-        int32_t tmp;
-        fromAPI(tmp, data);
-        system = tmp == 1;
-    }
-    if (rc == RBFM_EOF)
-        rc = SUCCESS;
+        // Tables entries never have null columns
+        char null;
+        memcpy(&null, data, 1);
+        if (null)
+        {
+            rc = RM_NULL_COLUMN;
+            break;
+        }
+
+        unsigned offset = 1;
+        int32_t id;
+        memcpy(&id, (char*) data + offset, INT_SIZE);
+        offset += INT_SIZE;
 
+        int32_t nameLen;
+        memcpy(&nameLen, (char*) data + offset, VARCHAR_LENGTH_SIZE);
+        offset += VARCHAR_LENGTH_SIZE;
+        string name((char*) data + offset, nameLen);
+        offset += nameLen;
+
+        int32_t system;
+        memcpy(&system, (char*) data + offset, INT_SIZE);
+
+        TableInfo &info = _catalog[name];
+        info.id = id;
+        info.system = system == 1;
+        tableNames[id] = name;
+    }
+    rbfm_si.close();
+    releaseTable(TABLES_TABLE_NAME);
     free(data);
-    free(value);
-    rbfm->closeFile(fileHandle);
+    if (rc != RBFM_EOF)
+    {
+        _catalog.clear();
+        return rc;
+    }
+
+    rc = openTable(COLUMNS_TABLE_NAME, fileHandle);
+    if (rc)
+    {
+        _catalog.clear();
+        return rc;
+    }
+
+    projection.clear();
+    projection.push_back(COLUMNS_COL_TABLE_ID);
+    projection.push_back(COLUMNS_COL_COLUMN_NAME);
+    projection.push_back(COLUMNS_COL_COLUMN_TYPE);
+    projection.push_back(COLUMNS_COL_COLUMN_LENGTH);
+    projection.push_back(COLUMNS_COL_COLUMN_POSITION);
+
+    rc = rbfm->scan(*fileHandle, columnDescriptor, COLUMNS_COL_TABLE_ID, NO_OP, NULL, projection, rbfm_si);
+
+    data = malloc(COLUMNS_RECORD_DATA_SIZE);
+    // IndexedAttr is an attr with a position. The position will be used to sort each table's columns
+    unordered_map<int32_t, vector<IndexedAttr> > iattrs;
+    while (rc == SUCCESS && (rc = rbfm_si.getNextRecord(rid, data)) == SUCCESS)
+    {
+        // For the Columns table, there should never be a null column
+        char null;
+        memcpy(&null, data, 1);
+        if (null)
+        {
+            rc = RM_NULL_COLUMN;
+            break;
+        }
+
+        IndexedAttr attr;
+        unsigned offset = 1;
+        int32_t id;
+        memcpy(&id, (char*) data + offset, INT_SIZE);
+        offset += INT_SIZE;
+
+        // Read in name
+        int32_t nameLen;
+        memcpy(&nameLen, (char*) data + offset, VARCHAR_LENGTH_SIZE);
+        offset += VARCHAR_LENGTH_SIZE;
+        attr.attr.name = string((char*) data + offset, nameLen);
+        offset += nameLen;
+
+        // Read in type
+        int32_t type;
+        memcpy(&type, (char*) data + offset, INT_SIZE);
+        offset += INT_SIZE;
+        attr.attr.type = (AttrType)type;
+
+        // Read in length
+        int32_t length;
+        memcpy(&length, (char*) data + offset, INT_SIZE);
+        offset += INT_SIZE;
+        attr.attr.length = length;
+
+        // Read in position
+        int32_t pos;
+        memcpy(&pos, (char*) data + offset, INT_SIZE);
+        attr.pos = pos;
+
+        iattrs[id].push_back(attr);
+    }
     rbfm_si.close();
-    return rc;   
+    releaseTable(COLUMNS_TABLE_NAME);
+    free(data);
+    if (rc != RBFM_EOF)
+    {
+        _catalog.clear();
+        return rc;
+    }
+
+    // Sort attributes by position ascending
+    auto comp = [](IndexedAttr first, IndexedAttr second)
+        {return first.pos < second.pos;};
+    for (auto &table : iattrs)
+    {
+        auto name = tableNames.find(table.first);
+        if (name == tableNames.end())
+            continue;
+        sort(table.second.begin(), table.second.end(), comp);
+        vector<Attribute> attrs;
+        for (auto &attr : table.second)
+            attrs.push_back(attr.attr);
+        _catalog[name->second].layout = RecordLayout(attrs);
+    }
+
+    _catalogLoaded = true;
+    return SUCCESS;
 }
 
 void RelationManager::toAPI(const string &str, void *data)
@@ -820,33 +1265,82 @@ RC RelationManager::scan(const string &tableName,
       const vector<string> &attributeNames,
       RM_ScanIterator &rm_ScanIterator)
 {
-    // Open the file for the given tableName
-    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
-    RC rc = rbfm->openFile(getFileName(tableName), rm_ScanIterator.fileHandle);
+    ScanCondition condition = {conditionAttribute, compOp, value};
+    return scan(tableName, vector<vector<ScanCondition> >(1, vector<ScanCondition>(1, condition)),
+                attributeNames, rm_ScanIterator);
+}
+
+RC RelationManager::scan(const string &tableName,
+      const vector<vector<ScanCondition> > &conditions,
+      const vector<string> &attributeNames,
+      RM_ScanIterator &rm_ScanIterator)
+{
+    // grab the record descriptor for the given tableName first, so a missing table
+    // doesn't leave the iterator holding an open file
+    const TableInfo *info;
+    RC rc = getTableInfo(tableName, info);
     if (rc)
         return rc;
 
-    // grab the record descriptor for the given tableName
-    vector<Attribute> recordDescriptor;
-    rc = getAttributes(tableName, recordDescriptor);
+    // Open the file for the given tableName. The scan only reads it, so its pages
+    // can be read straight out of a mapping of the file.
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    rc = rbfm->openFile(getFileName(tableName), rm_ScanIterator.fileHandle, PFM_OPEN_MMAP);
     if (rc)
         return rc;
 
-    // Use the underlying rbfm_scaniterator to do all the work
-    rc = rbfm->scan(rm_ScanIterator.fileHandle, recordDescriptor, conditionAttribute,
-                     compOp, value, attributeNames, rm_ScanIterator.rbfm_iter);
+    // Use the underlying rbfm_scaniterator to do all the work, compiled with the projection
+    RecordLayout layout(info->layout.getRecordDescriptor(), attributeNames);
+    rc = rbfm->scan(rm_ScanIterator.fileHandle, layout, conditions, rm_ScanIterator.rbfm_iter);
     if (rc)
+    {
+        rbfm->closeFile(rm_ScanIterator.fileHandle);
         return rc;
+    }
 
     return SUCCESS;
 }
 
+RC RelationManager::parallelScan(const string &tableName,
+      const vector<vector<ScanCondition> > &conditions,
+      const vector<string> &attributeNames,
+      unsigned numThreads,
+      const ScanBatchCallback &callback)
+{
+    // Like scan(), the workers read the pages straight out of a mapping of the file
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    FileHandle fileHandle;
+    RC rc = rbfm->openFile(getFileName(tableName), fileHandle, PFM_OPEN_MMAP);
+    if (rc)
+        return rc;
+
+    const TableInfo *info;
+    rc = getTableInfo(tableName, info);
+    if (rc == SUCCESS)
+    {
+        RecordLayout layout(info->layout.getRecordDescriptor(), attributeNames);
+        rc = rbfm->parallelScan(fileHandle, layout, conditions, numThreads, callback);
+    }
+    rbfm->closeFile(fileHandle);
+    return rc;
+}
+
 // Let rbfm do all the work
 RC RM_ScanIterator::getNextTuple(RID &rid, void *data)
 {
     return rbfm_iter.getNextRecord(rid, data);
 }
 
+RC RM_ScanIterator::getNextTupleView(RID &rid, RecordView &view)
+{
+    return rbfm_iter.getNextRecordView(rid, view);
+}
+
+RC RM_ScanIterator::getNextBatch(RecordBatch &batch, unsigned maxRows)
+{
+    return rbfm_iter.getNextBatch(batch, maxRows);
+}
+
 // Close our file handle, rbfm_scaniterator
 RC RM_ScanIterator::close()
 {
@@ -854,4 +1348,28 @@ RC RM_ScanIterator::close()
     rbfm_iter.close();
     rbfm->closeFile(fileHandle);
     return SUCCESS;
+}
+
+RM_BulkLoader::~RM_BulkLoader()
+{
+    close();
+}
+
+// Let rbfm do all the work
+RC RM_BulkLoader::insertTuple(const void *data, RID &rid)
+{
+    if (tableName.empty())
+        return RBFM_WRITE_FAILED;
+    return rbfm_loader.insertRecord(data, rid);
+}
+
+// Write out the last pages and give the table file back
+RC RM_BulkLoader::close()
+{
+    if (tableName.empty())
+        return SUCCESS;
+    RC rc = rbfm_loader.close();
+    RelationManager::instance()->releaseTable(tableName);
+    tableName.clear();
+    return rc;
 }
\ No newline at end of file
@@ -4,6 +4,8 @@
 
 #include <string>
 #include <vector>
+#include <list>
+#include <unordered_map>
 
 #include "../rbf/rbfm.h"
 
@@ -41,10 +43,25 @@ using namespace std;
 // 1 null byte, 4 integer fields and a varchar
 #define COLUMNS_RECORD_DATA_SIZE 1 + 5 * INT_SIZE + COLUMNS_COL_COLUMN_NAME_SIZE
 
+// The catalog header is a one page file next to Tables and Columns. It keeps what
+// would otherwise take a scan of Tables and is rewritten on every change.
+#define CATALOG_HEADER_NAME "Catalog"
+
+typedef struct CatalogHeader
+{
+    int32_t nextTableID;
+    uint32_t tableCount;
+    uint32_t version;                                       // Bumped by every createTable/deleteTable
+} CatalogHeader;
+
 # define RM_EOF (-1)  // end of a scan operator
 
 #define RM_CANNOT_MOD_SYS_TBL 1
 #define RM_NULL_COLUMN        2
+#define RM_TABLE_IN_USE       3
+
+// Table files RelationManager keeps open unless changed with setMaxOpenTables()
+#define RM_DEFAULT_MAX_OPEN_TABLES 64
 
 typedef struct IndexedAttr
 {
@@ -60,6 +77,10 @@ public:
 
   // "data" follows the same format as RelationManager::insertTuple()
   RC getNextTuple(RID &rid, void *data);
+  // Points "view" at the tuple instead of copying it, valid until close()
+  RC getNextTupleView(RID &rid, RecordView &view);
+  // Fills "batch" with up to maxRows tuples column by column, see RecordBatch
+  RC getNextBatch(RecordBatch &batch, unsigned maxRows = RBFM_BATCH_SIZE);
   RC close();
 
   friend class RelationManager;
@@ -69,6 +90,24 @@ private:
 };
 
 
+// RM_BulkLoader fills a new table through RBFM_BulkLoader, appending tuples to
+// fresh pages at the end of its file. The table file stays open until close().
+class RM_BulkLoader {
+public:
+  RM_BulkLoader() {};
+  ~RM_BulkLoader();
+
+  // "data" follows the same format as RelationManager::insertTuple()
+  RC insertTuple(const void *data, RID &rid);
+  RC close();
+
+  friend class RelationManager;
+private:
+  RBFM_BulkLoader rbfm_loader;
+  string tableName;                                         // Empty unless a load is open
+};
+
+
 // Relation Manager
 class RelationManager
 {
@@ -79,20 +118,44 @@ public:
 
   RC deleteCatalog();
 
-  RC createTable(const string &tableName, const vector<Attribute> &attrs);
+  // Scan-heavy tables can use pages of up to PFM_MAX_PAGE_SIZE bytes
+  // and tables with growing records a fillFactor below 100, so updates find room in place
+  RC createTable(const string &tableName, const vector<Attribute> &attrs, unsigned pageSize = PAGE_SIZE,
+                 unsigned fillFactor = PFM_DEFAULT_FILL_FACTOR);
 
   RC deleteTable(const string &tableName);
 
   RC getAttributes(const string &tableName, vector<Attribute> &attrs);
+  // Same without the copy. attrs stays valid until the catalog changes.
+  RC getAttributes(const string &tableName, const vector<Attribute> *&attrs);
+  // Changes every time a table is created or deleted
+  unsigned getCatalogVersion();
 
   RC insertTuple(const string &tableName, const void *data, RID &rid);
 
+  // Inserts many tuples at once, rids[i] is set to the RID of data[i]
+  RC insertTuples(const string &tableName, const vector<const void *> &data, vector<RID> &rids);
+
+  // Starts loading tuples into a table that nothing else appends to meanwhile,
+  // typically right after createTable(). Free space in existing pages is not reused.
+  RC bulkLoad(const string &tableName, RM_BulkLoader &rm_BulkLoader);
+
   RC deleteTuple(const string &tableName, const RID &rid);
 
   RC updateTuple(const string &tableName, const void *data, const RID &rid);
 
+  // Moves tuples that updates forwarded to other pages back home where there is room
+  // again. Like RecordBasedFileManager::deforwardRecords(), it goes through at most
+  // maxPages pages from pageNum and leaves pageNum where to carry on, setting done once
+  // the whole table has been gone through.
+  RC deforwardTuples(const string &tableName, PageNum &pageNum, unsigned maxPages, bool &done);
+
   RC readTuple(const string &tableName, const RID &rid, void *data);
 
+  // Points "view" at the tuple in its page. Attribute indices follow getAttributes().
+  // The view must be released before the table is deleted.
+  RC readTupleView(const string &tableName, const RID &rid, RecordView &view);
+
   // Print a tuple that is passed to this utility method.
   // The format is the same as printRecord().
   RC printTuple(const vector<Attribute> &attrs, const void *data);
@@ -107,7 +170,28 @@ public:
       const void *value,                    // used in the comparison
       const vector<string> &attributeNames, // a list of projected attributes
       RM_ScanIterator &rm_ScanIterator);
+  // Scans for tuples satisfying any one of "conditions", each a list of conditions
+  // that must all hold. See RecordBasedFileManager::scan().
+  RC scan(const string &tableName,
+      const vector<vector<ScanCondition> > &conditions,
+      const vector<string> &attributeNames,
+      RM_ScanIterator &rm_ScanIterator);
+
+  // Scans with numThreads worker threads, handing batches of the selected tuples to
+  // "callback" from each of them. See RecordBasedFileManager::parallelScan().
+  RC parallelScan(const string &tableName,
+      const vector<vector<ScanCondition> > &conditions,
+      const vector<string> &attributeNames,
+      unsigned numThreads,
+      const ScanBatchCallback &callback);
 
+  // Limit the number of table files kept open between calls, closing idle ones if needed
+  RC setMaxOpenTables(unsigned maxOpenTables);
+  // Close every table file kept open between calls, writing back their pages
+  RC closeTables();
+
+
+  friend class RM_BulkLoader;
 
 protected:
   RelationManager();
@@ -118,6 +202,55 @@ private:
   const vector<Attribute> tableDescriptor;
   const vector<Attribute> columnDescriptor;
 
+  // Table files are kept open between calls, so tuple operations don't open and
+  // close a file each time. Tables in use are never closed, idle ones are closed
+  // least recently used first once more than _maxOpenTables are open.
+  typedef struct TableHandle
+  {
+      FileHandle fileHandle;
+      unsigned refCount;
+      list<string>::iterator lruPosition;
+  } TableHandle;
+  unordered_map<string, TableHandle> _tables;
+  list<string> _tablesLRU;                                  // Most recently used first
+  unsigned _maxOpenTables;
+
+  // Get a table's open file handle, which stays valid until releaseTable()
+  RC openTable(const string &tableName, FileHandle *&fileHandle);
+  void releaseTable(const string &tableName);
+  // Close a table's file ahead of destroying it
+  RC closeTable(const string &tableName);
+  RC closeIdleTables(unsigned maxOpenTables);
+  static void closeTablesAtExit();
+
+  // The catalog is read into memory on first use and kept in step by
+  // createTable()/deleteTable(), so tuple operations never scan it.
+  typedef struct TableInfo
+  {
+      int32_t id;
+      bool system;
+      RecordLayout layout;                                  // Compiled record descriptor
+  } TableInfo;
+  unordered_map<string, TableInfo> _catalog;
+  bool _catalogLoaded;
+  unsigned _catalogVersion;
+
+  RC getTableInfo(const string &tableName, const TableInfo *&info);
+  RC loadCatalog();
+  void invalidateCatalog();
+
+  // Catalog header, read in on first use and kept open
+  FileHandle _catalogHeaderFile;
+  CatalogHeader _catalogHeader;
+  bool _catalogHeaderLoaded;
+
+  RC loadCatalogHeader();
+  RC writeCatalogHeader(const CatalogHeader &header);
+  RC createCatalogHeader(int32_t nextTableID, uint32_t tableCount);
+  RC closeCatalogHeader();
+  RC scanTables(int32_t &nextTableID, uint32_t &tableCount);
+  static bool fileExists(const string &fileName);
+
   // Convert tableName to file name (append extension)
   static string getFileName(const char *tableName);
   static string getFileName(const string &tableName);
@@ -134,8 +267,11 @@ private:
   RC insertColumns(int32_t id, const vector<Attribute> &recordDescriptor);
   // Given table ID, system flag, and table name, creates entry in Table table
   RC insertTable(int32_t id, int32_t system, const string &tableName);
+  // Deletes every record of the Tables or Columns table whose attribute holds table ID id
+  RC deleteCatalogRecords(const string &catalogTable, const vector<Attribute> &recordDescriptor,
+                          const string &attributeName, int32_t id);
 
-  // Get next table ID for creating table
+  // Reserve the next table ID for creating a table
   RC getNextTableID(int32_t &table_id);
   // Get table ID of table with name tableName
   RC getTableID(const string &tableName, int32_t &tableID);
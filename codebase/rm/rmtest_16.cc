@@ -0,0 +1,158 @@
+#include "rm_test_util.h"
+#include <dirent.h>
+
+// Number of file descriptors the process has open
+int countOpenFiles()
+{
+    int count = 0;
+    DIR *dir = opendir("/proc/self/fd");
+    if (dir == NULL)
+        return -1;
+    while (readdir(dir) != NULL)
+        count++;
+    closedir(dir);
+    return count;
+}
+
+RC TEST_RM_16(const string &tablePrefix)
+{
+    // Functions Tested:
+    // 1. Insert and Read Tuples round-robin over more tables than are kept open
+    // 2. Set Max Open Tables / Close Tables
+    // 3. Delete Table while its file is kept open
+    // 4. Create Table again under the same name
+    cout << endl << "***** In RM Test Case 16 *****" << endl;
+
+    int numTables = 6;
+    vector<string> tableNames;
+    for (int t = 0; t < numTables; t++)
+    {
+        tableNames.push_back(tablePrefix + to_string(t));
+        rm->deleteTable(tableNames[t]);
+        createTable(tableNames[t]);
+    }
+
+    // Only files in use and up to two idle ones stay open
+    RC rc = rm->setMaxOpenTables(2);
+    assert(rc == success && "RelationManager::setMaxOpenTables() should not fail.");
+    rc = rm->closeTables();
+    assert(rc == success && "RelationManager::closeTables() should not fail.");
+    int baseFiles = countOpenFiles();
+
+    int numTuples = 600;
+    vector<vector<RID> > rids(numTables);
+    void *tuple = malloc(100);
+    void *returnedData = malloc(100);
+    int size = 0;
+    RID rid;
+    for (int i = 0; i < numTuples; i++)
+    {
+        int t = i % numTables;
+        prepareIndexedRecord(i, tuple, &size);
+        rc = rm->insertTuple(tableNames[t], tuple, rid);
+        assert(rc == success && "RelationManager::insertTuple() should not fail.");
+        rids[t].push_back(rid);
+        if (countOpenFiles() > baseFiles + 2)
+        {
+            cout << "***** [FAIL] Test Case 16 failed: " << countOpenFiles() - baseFiles << " table files were kept open instead of at most 2 *****" << endl << endl;
+            return -1;
+        }
+    }
+
+    // With more room every table stays open, until they are closed
+    rc = rm->setMaxOpenTables(RM_DEFAULT_MAX_OPEN_TABLES);
+    assert(rc == success && "RelationManager::setMaxOpenTables() should not fail.");
+    for (int i = 0; i < numTuples; i++)
+    {
+        int t = i % numTables;
+        rc = rm->readTuple(tableNames[t], rids[t][i / numTables], returnedData);
+        assert(rc == success && "RelationManager::readTuple() should not fail.");
+        prepareIndexedRecord(i, tuple, &size);
+        if (memcmp(tuple, returnedData, size) != 0)
+        {
+            cout << "***** [FAIL] Test Case 16 failed: tuple " << i << " of " << tableNames[t] << " doesn't read back the same *****" << endl << endl;
+            return -1;
+        }
+    }
+    if (countOpenFiles() < baseFiles + numTables)
+    {
+        cout << "***** [FAIL] Test Case 16 failed: table files weren't kept open between calls *****" << endl << endl;
+        return -1;
+    }
+    rc = rm->closeTables();
+    assert(rc == success && "RelationManager::closeTables() should not fail.");
+    if (countOpenFiles() > baseFiles)
+    {
+        cout << "***** [FAIL] Test Case 16 failed: closeTables() left table files open *****" << endl << endl;
+        return -1;
+    }
+
+    // A scan goes through the same tuples while the table is kept open for other calls
+    RM_ScanIterator rmsi;
+    vector<string> attributes;
+    attributes.push_back("Salary");
+    rc = rm->scan(tableNames[0], "", NO_OP, NULL, attributes, rmsi);
+    assert(rc == success && "RelationManager::scan() should not fail.");
+    rc = rm->readTuple(tableNames[0], rids[0][0], returnedData);
+    assert(rc == success && "RelationManager::readTuple() should not fail.");
+    int count = 0;
+    while (rmsi.getNextTuple(rid, returnedData) != RM_EOF)
+        count++;
+    rmsi.close();
+    if (count != numTuples / numTables)
+    {
+        cout << "***** [FAIL] Test Case 16 failed: the scan returned " << count << " tuples *****" << endl << endl;
+        return -1;
+    }
+
+    // The open table can be deleted, and a new one of the same name starts out empty
+    rc = rm->deleteTable(tableNames[0]);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+    if (rm->readTuple(tableNames[0], rids[0][0], returnedData) == success)
+    {
+        cout << "***** [FAIL] Test Case 16 failed: a tuple was read from a deleted table *****" << endl << endl;
+        return -1;
+    }
+    createTable(tableNames[0]);
+    rc = rm->scan(tableNames[0], "", NO_OP, NULL, attributes, rmsi);
+    assert(rc == success && "RelationManager::scan() should not fail.");
+    count = 0;
+    while (rmsi.getNextTuple(rid, returnedData) != RM_EOF)
+        count++;
+    rmsi.close();
+    if (count != 0)
+    {
+        cout << "***** [FAIL] Test Case 16 failed: the recreated table holds " << count << " tuples of the deleted one *****" << endl << endl;
+        return -1;
+    }
+    prepareIndexedRecord(numTuples, tuple, &size);
+    rc = rm->insertTuple(tableNames[0], tuple, rid);
+    assert(rc == success && "RelationManager::insertTuple() should not fail.");
+    rc = rm->readTuple(tableNames[0], rid, returnedData);
+    assert(rc == success && "RelationManager::readTuple() should not fail.");
+    if (memcmp(tuple, returnedData, size) != 0)
+    {
+        cout << "***** [FAIL] Test Case 16 failed: the recreated table doesn't read back its tuple *****" << endl << endl;
+        return -1;
+    }
+
+    for (int t = 0; t < numTables; t++)
+    {
+        rc = rm->deleteTable(tableNames[t]);
+        assert(rc == success && "RelationManager::deleteTable() should not fail.");
+    }
+
+    free(tuple);
+    free(returnedData);
+
+    cout << "***** RM Test Case 16 Finished. The result will be examined. *****" << endl << endl;
+    return success;
+}
+
+int main()
+{
+    // Table Handle Cache
+    RC rcmain = TEST_RM_16("tbl_cache_");
+
+    return rcmain;
+}
@@ -0,0 +1,158 @@
+#include "rm_test_util.h"
+
+RC TEST_RM_17(const string &tableName, const string &otherTableName)
+{
+    // Functions Tested:
+    // 1. Create Table / Delete Table, which change the catalog version
+    // 2. Get Attributes, copied and in place, after every change
+    // 3. Create Table again under the same name with other attributes
+    cout << endl << "***** In RM Test Case 17 *****" << endl;
+
+    // Start from fresh tables, an earlier run may have left them behind
+    rm->deleteTable(tableName);
+    rm->deleteTable(otherTableName);
+
+    vector<Attribute> attrs;
+    const vector<Attribute> *cachedAttrs;
+    if (rm->getAttributes(tableName, attrs) == success || rm->getAttributes(tableName, cachedAttrs) == success)
+    {
+        cout << "***** [FAIL] Test Case 17 failed: a deleted table still has attributes *****" << endl << endl;
+        return -1;
+    }
+
+    unsigned version = rm->getCatalogVersion();
+    createTable(tableName);
+    if (rm->getCatalogVersion() == version)
+    {
+        cout << "***** [FAIL] Test Case 17 failed: createTable() didn't change the catalog version *****" << endl << endl;
+        return -1;
+    }
+
+    RC rc = rm->getAttributes(tableName, attrs);
+    assert(rc == success && "RelationManager::getAttributes() should not fail.");
+    rc = rm->getAttributes(tableName, cachedAttrs);
+    assert(rc == success && "RelationManager::getAttributes() should not fail.");
+    string names[] = {"EmpName", "Age", "Height", "Salary"};
+    AttrType types[] = {TypeVarChar, TypeInt, TypeReal, TypeInt};
+    if (attrs.size() != 4 || cachedAttrs->size() != 4)
+    {
+        cout << "***** [FAIL] Test Case 17 failed: the table has " << attrs.size() << " attributes instead of 4 *****" << endl << endl;
+        return -1;
+    }
+    for (unsigned i = 0; i < 4; i++)
+    {
+        if (attrs[i].name != names[i] || attrs[i].type != types[i] || (*cachedAttrs)[i].name != names[i] || (*cachedAttrs)[i].type != types[i])
+        {
+            cout << "***** [FAIL] Test Case 17 failed: attribute " << i << " is " << attrs[i].name << " instead of " << names[i] << " *****" << endl << endl;
+            return -1;
+        }
+    }
+
+    // Failed changes leave the catalog as it is
+    version = rm->getCatalogVersion();
+    if (rm->createTable(tableName, attrs) == success || rm->deleteTable(otherTableName) == success
+        || rm->deleteTable(TABLES_TABLE_NAME) == success)
+    {
+        cout << "***** [FAIL] Test Case 17 failed: an invalid catalog change succeeded *****" << endl << endl;
+        return -1;
+    }
+    if (rm->getCatalogVersion() != version)
+    {
+        cout << "***** [FAIL] Test Case 17 failed: a failed catalog change changed the catalog version *****" << endl << endl;
+        return -1;
+    }
+
+    // Tuple operations don't change the catalog
+    void *tuple = malloc(100);
+    void *returnedData = malloc(100);
+    int size = 0;
+    RID rid;
+    prepareIndexedRecord(1, tuple, &size);
+    rc = rm->insertTuple(tableName, tuple, rid);
+    assert(rc == success && "RelationManager::insertTuple() should not fail.");
+    rc = rm->readTuple(tableName, rid, returnedData);
+    assert(rc == success && "RelationManager::readTuple() should not fail.");
+    if (rm->getCatalogVersion() != version)
+    {
+        cout << "***** [FAIL] Test Case 17 failed: a tuple operation changed the catalog version *****" << endl << endl;
+        return -1;
+    }
+
+    // A table created under the same name takes the new attributes
+    rc = rm->deleteTable(tableName);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+    if (rm->getCatalogVersion() == version)
+    {
+        cout << "***** [FAIL] Test Case 17 failed: deleteTable() didn't change the catalog version *****" << endl << endl;
+        return -1;
+    }
+    if (rm->getAttributes(tableName, attrs) == success || rm->readTuple(tableName, rid, returnedData) == success)
+    {
+        cout << "***** [FAIL] Test Case 17 failed: a deleted table is still in the catalog *****" << endl << endl;
+        return -1;
+    }
+
+    vector<Attribute> otherAttrs;
+    Attribute attr;
+    attr.name = "Id";
+    attr.type = TypeInt;
+    attr.length = (AttrLength) 4;
+    otherAttrs.push_back(attr);
+    attr.name = "Score";
+    attr.type = TypeReal;
+    otherAttrs.push_back(attr);
+    version = rm->getCatalogVersion();
+    rc = rm->createTable(tableName, otherAttrs);
+    assert(rc == success && "RelationManager::createTable() should not fail.");
+    createTable(otherTableName);
+    rc = rm->getAttributes(tableName, cachedAttrs);
+    assert(rc == success && "RelationManager::getAttributes() should not fail.");
+    if (rm->getCatalogVersion() == version || cachedAttrs->size() != 2 || (*cachedAttrs)[0].name != "Id" || (*cachedAttrs)[1].type != TypeReal)
+    {
+        cout << "***** [FAIL] Test Case 17 failed: the recreated table doesn't have its new attributes *****" << endl << endl;
+        return -1;
+    }
+    rc = rm->getAttributes(otherTableName, attrs);
+    assert(rc == success && "RelationManager::getAttributes() should not fail.");
+    if (attrs.size() != 4 || attrs[0].name != "EmpName")
+    {
+        cout << "***** [FAIL] Test Case 17 failed: the other table doesn't have its attributes *****" << endl << endl;
+        return -1;
+    }
+
+    // Tuples of the new layout go through the cached descriptor
+    char otherTuple[9];
+    otherTuple[0] = 0;
+    int id = 17;
+    float score = 2.5;
+    memcpy(otherTuple + 1, &id, sizeof(int));
+    memcpy(otherTuple + 5, &score, sizeof(float));
+    rc = rm->insertTuple(tableName, otherTuple, rid);
+    assert(rc == success && "RelationManager::insertTuple() should not fail.");
+    rc = rm->readAttribute(tableName, rid, "Score", returnedData);
+    assert(rc == success && "RelationManager::readAttribute() should not fail.");
+    if (memcmp((char *) returnedData + 1, &score, sizeof(float)) != 0)
+    {
+        cout << "***** [FAIL] Test Case 17 failed: the recreated table read back a wrong attribute *****" << endl << endl;
+        return -1;
+    }
+
+    rc = rm->deleteTable(tableName);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+    rc = rm->deleteTable(otherTableName);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+
+    free(tuple);
+    free(returnedData);
+
+    cout << "***** RM Test Case 17 Finished. The result will be examined. *****" << endl << endl;
+    return success;
+}
+
+int main()
+{
+    // Catalog Cache
+    RC rcmain = TEST_RM_17("tbl_employee5", "tbl_employee6");
+
+    return rcmain;
+}
@@ -0,0 +1,116 @@
+#include "rm_test_util.h"
+#include <map>
+
+// Every table in the catalog with its id, read from the Tables table
+void getTableIDs(map<string, int> &tableIDs)
+{
+    tableIDs.clear();
+    vector<string> attributes;
+    attributes.push_back(TABLES_COL_TABLE_ID);
+    attributes.push_back(TABLES_COL_TABLE_NAME);
+
+    RM_ScanIterator rmsi;
+    RC rc = rm->scan(TABLES_TABLE_NAME, "", NO_OP, NULL, attributes, rmsi);
+    assert(rc == success && "RelationManager::scan() should not fail.");
+    RID rid;
+    char *data = (char *) malloc(TABLES_RECORD_DATA_SIZE);
+    while (rmsi.getNextTuple(rid, data) != RM_EOF)
+    {
+        int id, length;
+        memcpy(&id, data + 1, sizeof(int));
+        memcpy(&length, data + 1 + sizeof(int), sizeof(int));
+        tableIDs[string(data + 1 + 2 * sizeof(int), length)] = id;
+    }
+    rmsi.close();
+    free(data);
+}
+
+// The catalog header as stored in the first page of its file
+bool readCatalogHeader(CatalogHeader &header)
+{
+    FILE *file = fopen((string(CATALOG_HEADER_NAME) + TABLE_FILE_EXTENSION).c_str(), "rb");
+    if (file == NULL)
+        return false;
+    bool read = fseek(file, PFM_HEADER_PAGES * PAGE_SIZE, SEEK_SET) == 0 && fread(&header, sizeof(header), 1, file) == 1;
+    fclose(file);
+    return read;
+}
+
+RC TEST_RM_18(const string &tableName, const string &otherTableName)
+{
+    // Functions Tested:
+    // 1. Create Table in a catalog without a header, which rebuilds it from the Tables table
+    // 2. Create Table / Delete Table, checking the table ids handed out and the stored header
+    cout << endl << "***** In RM Test Case 18 *****" << endl;
+
+    // Catalogs created before the header was kept don't have one
+    remove((string(CATALOG_HEADER_NAME) + TABLE_FILE_EXTENSION).c_str());
+
+    // Start from fresh tables, an earlier run may have left them behind
+    rm->deleteTable(tableName);
+    rm->deleteTable(otherTableName);
+
+    map<string, int> tableIDs;
+    getTableIDs(tableIDs);
+    int maxID = 0;
+    for (map<string, int>::iterator it = tableIDs.begin(); it != tableIDs.end(); it++)
+        maxID = max(maxID, it->second);
+
+    createTable(tableName);
+    createTable(otherTableName);
+
+    // The new tables continue after the largest id in the catalog
+    getTableIDs(tableIDs);
+    if (tableIDs[tableName] != maxID + 1 || tableIDs[otherTableName] != maxID + 2)
+    {
+        cout << "***** [FAIL] Test Case 18 failed: the new tables got ids " << tableIDs[tableName] << " and " << tableIDs[otherTableName]
+             << " instead of " << maxID + 1 << " and " << maxID + 2 << " *****" << endl << endl;
+        return -1;
+    }
+
+    // And the rebuilt header is on disk
+    CatalogHeader header;
+    if (!readCatalogHeader(header) || header.nextTableID != maxID + 3 || header.tableCount != tableIDs.size())
+    {
+        cout << "***** [FAIL] Test Case 18 failed: the catalog header wasn't rebuilt *****" << endl << endl;
+        return -1;
+    }
+    uint32_t version = header.version;
+
+    // Deleting a table gives back neither its id nor the largest one
+    RC rc = rm->deleteTable(otherTableName);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+    if (!readCatalogHeader(header) || header.nextTableID != maxID + 3 || header.tableCount != tableIDs.size() - 1 || header.version == version)
+    {
+        cout << "***** [FAIL] Test Case 18 failed: deleteTable() didn't update the catalog header *****" << endl << endl;
+        return -1;
+    }
+    createTable(otherTableName);
+    getTableIDs(tableIDs);
+    if (tableIDs[otherTableName] != maxID + 3)
+    {
+        cout << "***** [FAIL] Test Case 18 failed: the recreated table got id " << tableIDs[otherTableName] << " instead of " << maxID + 3 << " *****" << endl << endl;
+        return -1;
+    }
+    if (!readCatalogHeader(header) || header.nextTableID != maxID + 4 || header.tableCount != tableIDs.size())
+    {
+        cout << "***** [FAIL] Test Case 18 failed: createTable() didn't update the catalog header *****" << endl << endl;
+        return -1;
+    }
+
+    rc = rm->deleteTable(tableName);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+    rc = rm->deleteTable(otherTableName);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+
+    cout << "***** RM Test Case 18 Finished. The result will be examined. *****" << endl << endl;
+    return success;
+}
+
+int main()
+{
+    // Catalog Header
+    RC rcmain = TEST_RM_18("tbl_employee5", "tbl_employee6");
+
+    return rcmain;
+}
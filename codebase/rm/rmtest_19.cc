@@ -0,0 +1,127 @@
+#include "rm_test_util.h"
+
+RC TEST_RM_19(const string &tableName, const string &batchTableName)
+{
+    // Functions Tested:
+    // 1. Insert tuples in batches
+    // 2. Read Tuple, against the same tuples inserted one at a time
+    // 3. Scan
+    cout << endl << "***** In RM Test Case 19 *****" << endl;
+
+    // Start from fresh tables, an earlier run may have left them behind
+    rm->deleteTable(tableName);
+    rm->deleteTable(batchTableName);
+    createTable(tableName);
+    createTable(batchTableName);
+
+    int numTuples = 5000;
+    int batchSize = 700;
+    vector<char *> tuples;
+    vector<int> sizes;
+    for (int i = 0; i < numTuples; i++)
+    {
+        int size = 0;
+        char *tuple = (char *) malloc(100);
+        prepareIndexedRecord(i, tuple, &size);
+        tuples.push_back(tuple);
+        sizes.push_back(size);
+    }
+
+    // Insert the tuples one at a time into one table, and in batches into the other
+    vector<RID> rids;
+    RID rid;
+    RC rc;
+    for (int i = 0; i < numTuples; i++)
+    {
+        rc = rm->insertTuple(tableName, tuples[i], rid);
+        assert(rc == success && "RelationManager::insertTuple() should not fail.");
+        rids.push_back(rid);
+    }
+
+    vector<RID> batchRids;
+    for (int i = 0; i < numTuples; i += batchSize)
+    {
+        vector<const void *> batch(tuples.begin() + i, tuples.begin() + min(i + batchSize, numTuples));
+        vector<RID> ridsOfBatch;
+        rc = rm->insertTuples(batchTableName, batch, ridsOfBatch);
+        assert(rc == success && "RelationManager::insertTuples() should not fail.");
+        if (ridsOfBatch.size() != batch.size())
+        {
+            cout << "***** [FAIL] Test Case 19 failed: insertTuples() returned " << ridsOfBatch.size() << " RIDs for " << batch.size() << " tuples *****" << endl << endl;
+            return -1;
+        }
+        batchRids.insert(batchRids.end(), ridsOfBatch.begin(), ridsOfBatch.end());
+    }
+
+    // Every batch inserted tuple reads back like the one inserted on its own
+    void *returnedData = malloc(100);
+    void *batchData = malloc(100);
+    set<pair<unsigned, unsigned> > distinctRids;
+    for (int i = 0; i < numTuples; i++)
+    {
+        rc = rm->readTuple(tableName, rids[i], returnedData);
+        assert(rc == success && "RelationManager::readTuple() should not fail.");
+        rc = rm->readTuple(batchTableName, batchRids[i], batchData);
+        assert(rc == success && "RelationManager::readTuple() should not fail.");
+
+        if (memcmp(returnedData, tuples[i], sizes[i]) != 0 || memcmp(batchData, tuples[i], sizes[i]) != 0)
+        {
+            cout << "***** [FAIL] Test Case 19 failed: tuple " << i << " doesn't read back the same *****" << endl << endl;
+            return -1;
+        }
+        distinctRids.insert(make_pair(batchRids[i].pageNum, batchRids[i].slotNum));
+    }
+    if (distinctRids.size() != (unsigned) numTuples)
+    {
+        cout << "***** [FAIL] Test Case 19 failed: insertTuples() handed out the same RID twice *****" << endl << endl;
+        return -1;
+    }
+
+    // A scan of the batch inserted table returns every tuple once
+    RM_ScanIterator rmsi;
+    vector<string> attributes;
+    attributes.push_back("Salary");
+    rc = rm->scan(batchTableName, "", NO_OP, NULL, attributes, rmsi);
+    assert(rc == success && "RelationManager::scan() should not fail.");
+
+    vector<int> seen(numTuples, 0);
+    int count = 0;
+    while (rmsi.getNextTuple(rid, returnedData) != RM_EOF)
+    {
+        int salary;
+        memcpy(&salary, (char *) returnedData + 1, sizeof(int));
+        if (salary >= 0 && salary < numTuples)
+            seen[salary]++;
+        count++;
+    }
+    rmsi.close();
+    for (int i = 0; i < numTuples; i++)
+    {
+        if (seen[i] != 1 || count != numTuples)
+        {
+            cout << "***** [FAIL] Test Case 19 failed: the scan returned " << count << " tuples *****" << endl << endl;
+            return -1;
+        }
+    }
+
+    rc = rm->deleteTable(tableName);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+    rc = rm->deleteTable(batchTableName);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+
+    for (int i = 0; i < numTuples; i++)
+        free(tuples[i]);
+    free(returnedData);
+    free(batchData);
+
+    cout << "***** RM Test Case 19 Finished. The result will be examined. *****" << endl << endl;
+    return success;
+}
+
+int main()
+{
+    // Insert Tuples
+    RC rcmain = TEST_RM_19("tbl_employee5", "tbl_employee6");
+
+    return rcmain;
+}
@@ -0,0 +1,141 @@
+#include "rm_test_util.h"
+
+RC TEST_RM_20(const string &tableName, const string &loadTableName)
+{
+    // Functions Tested:
+    // 1. Bulk Load, into a table that already holds tuples
+    // 2. Insert Tuple, after the load
+    // 3. Read Tuple, against the same tuples inserted one at a time
+    // 4. Scan
+    cout << endl << "***** In RM Test Case 20 *****" << endl;
+
+    rm->deleteTable(tableName);
+    rm->deleteTable(loadTableName);
+    createTable(tableName);
+    createTable(loadTableName);
+
+    int numTuples = 6000;
+    int numLoaded = 4000;                 // Tuples [100, numLoaded) go through the loader
+    void *tuple = malloc(100);
+    void *returnedData = malloc(100);
+    void *loadedData = malloc(100);
+    vector<RID> rids;
+    vector<RID> loadRids;
+    RID rid;
+    RC rc;
+    int size = 0;
+
+    for (int i = 0; i < numTuples; i++)
+    {
+        prepareIndexedRecord(i, tuple, &size);
+        rc = rm->insertTuple(tableName, tuple, rid);
+        assert(rc == success && "RelationManager::insertTuple() should not fail.");
+        rids.push_back(rid);
+    }
+
+    // A few tuples before the load, the bulk of them through it, and the rest after it
+    RM_BulkLoader loader;
+    for (int i = 0; i < numTuples; i++)
+    {
+        if (i == 100)
+        {
+            rc = rm->bulkLoad(loadTableName, loader);
+            assert(rc == success && "RelationManager::bulkLoad() should not fail.");
+        }
+
+        prepareIndexedRecord(i, tuple, &size);
+        if (i >= 100 && i < numLoaded)
+            rc = loader.insertTuple(tuple, rid);
+        else
+            rc = rm->insertTuple(loadTableName, tuple, rid);
+        assert(rc == success && "Inserting a tuple should not fail.");
+        loadRids.push_back(rid);
+
+        if (i == numLoaded - 1)
+        {
+            rc = loader.close();
+            assert(rc == success && "RM_BulkLoader::close() should not fail.");
+        }
+    }
+
+    set<pair<unsigned, unsigned> > distinctRids;
+    for (int i = 0; i < numTuples; i++)
+    {
+        rc = rm->readTuple(tableName, rids[i], returnedData);
+        assert(rc == success && "RelationManager::readTuple() should not fail.");
+        rc = rm->readTuple(loadTableName, loadRids[i], loadedData);
+        assert(rc == success && "RelationManager::readTuple() should not fail.");
+
+        prepareIndexedRecord(i, tuple, &size);
+        if (memcmp(returnedData, tuple, size) != 0 || memcmp(loadedData, tuple, size) != 0)
+        {
+            cout << "***** [FAIL] Test Case 20 failed: tuple " << i << " doesn't read back the same *****" << endl << endl;
+            return -1;
+        }
+        distinctRids.insert(make_pair(loadRids[i].pageNum, loadRids[i].slotNum));
+    }
+    if (distinctRids.size() != (unsigned) numTuples)
+    {
+        cout << "***** [FAIL] Test Case 20 failed: the same RID was handed out twice *****" << endl << endl;
+        return -1;
+    }
+
+    // Both tables scan back the same tuples
+    vector<string> attributes;
+    attributes.push_back("Salary");
+    vector<int> seen(numTuples, 0);
+    int count = 0;
+    RM_ScanIterator rmsi;
+    rc = rm->scan(loadTableName, "", NO_OP, NULL, attributes, rmsi);
+    assert(rc == success && "RelationManager::scan() should not fail.");
+    while (rmsi.getNextTuple(rid, returnedData) != RM_EOF)
+    {
+        int salary;
+        memcpy(&salary, (char *) returnedData + 1, sizeof(int));
+        if (salary >= 0 && salary < numTuples)
+            seen[salary]++;
+        count++;
+    }
+    rmsi.close();
+
+    rc = rm->scan(tableName, "", NO_OP, NULL, attributes, rmsi);
+    assert(rc == success && "RelationManager::scan() should not fail.");
+    while (rmsi.getNextTuple(rid, returnedData) != RM_EOF)
+    {
+        int salary;
+        memcpy(&salary, (char *) returnedData + 1, sizeof(int));
+        if (salary >= 0 && salary < numTuples)
+            seen[salary]--;
+        count--;
+    }
+    rmsi.close();
+
+    for (int i = 0; i < numTuples; i++)
+    {
+        if (seen[i] != 0 || count != 0)
+        {
+            cout << "***** [FAIL] Test Case 20 failed: the scans don't return the same tuples *****" << endl << endl;
+            return -1;
+        }
+    }
+
+    rc = rm->deleteTable(tableName);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+    rc = rm->deleteTable(loadTableName);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+
+    free(tuple);
+    free(returnedData);
+    free(loadedData);
+
+    cout << "***** RM Test Case 20 Finished. The result will be examined. *****" << endl << endl;
+    return success;
+}
+
+int main()
+{
+    // Bulk Load
+    RC rcmain = TEST_RM_20("tbl_employee5", "tbl_employee6");
+
+    return rcmain;
+}
@@ -0,0 +1,164 @@
+#include "rm_test_util.h"
+
+// Whether "view" shows the same tuple as "tuple", in the format of createTable()
+bool viewMatchesTuple(RecordView &view, const void *tuple)
+{
+    const char *data = (const char *) tuple;
+    unsigned char nullsIndicator = data[0];
+    int offset = 1;
+    if (view.getNumberOfAttributes() != 4)
+        return false;
+
+    // EmpName
+    unsigned length;
+    if (nullsIndicator & (1 << 7))
+    {
+        if (!view.isNull(0) || view.getAttribute(0, length) != NULL)
+            return false;
+    }
+    else
+    {
+        int nameLength;
+        memcpy(&nameLength, data + offset, sizeof(int));
+        offset += sizeof(int);
+        const void *name = view.getAttribute(0, length);
+        if (view.isNull(0) || name == NULL || length != (unsigned) nameLength || memcmp(name, data + offset, nameLength) != 0)
+            return false;
+        offset += nameLength;
+    }
+
+    // Age, Height and Salary
+    for (unsigned i = 1; i < 4; i++)
+    {
+        if (nullsIndicator & (1 << (7 - i)))
+        {
+            if (!view.isNull(i))
+                return false;
+            continue;
+        }
+        if (view.isNull(i))
+            return false;
+        if (i == 2)
+        {
+            float height;
+            memcpy(&height, data + offset, sizeof(float));
+            if (view.getReal(i) != height)
+                return false;
+        }
+        else
+        {
+            int value;
+            memcpy(&value, data + offset, sizeof(int));
+            if (view.getInt(i) != value)
+                return false;
+        }
+        offset += 4;
+    }
+    return true;
+}
+
+RC TEST_RM_21(const string &tableName)
+{
+    // Functions Tested:
+    // 1. Insert and Update Tuples, some of which get forwarded to other pages
+    // 2. Read Tuple View, against Read Tuple
+    // 3. Scan with Get Next Tuple View
+    cout << endl << "***** In RM Test Case 21 *****" << endl;
+
+    // Start from a fresh table, an earlier run may have left it behind
+    rm->deleteTable(tableName);
+    createTable(tableName);
+
+    int numTuples = 2000;
+    void *tuple = malloc(100);
+    void *returnedData = malloc(100);
+    int size = 0;
+    vector<RID> rids;
+    RID rid;
+    RC rc;
+    for (int i = 0; i < numTuples; i++)
+    {
+        prepareIndexedRecord(i, tuple, &size);
+        rc = rm->insertTuple(tableName, tuple, rid);
+        assert(rc == success && "RelationManager::insertTuple() should not fail.");
+        rids.push_back(rid);
+    }
+
+    // Grow some tuples out of their full pages
+    unsigned char nullsIndicator = 0;
+    for (int i = 0; i < numTuples; i += 9)
+    {
+        prepareTuple(4, &nullsIndicator, 30, string(30, 'z'), i % 50, 170.5, i, tuple, &size);
+        rc = rm->updateTuple(tableName, tuple, rids[i]);
+        assert(rc == success && "RelationManager::updateTuple() should not fail.");
+    }
+
+    // Views show the same tuples readTuple copies out
+    RecordView view;
+    for (int i = 0; i < numTuples; i++)
+    {
+        rc = rm->readTuple(tableName, rids[i], returnedData);
+        assert(rc == success && "RelationManager::readTuple() should not fail.");
+        rc = rm->readTupleView(tableName, rids[i], view);
+        assert(rc == success && "RelationManager::readTupleView() should not fail.");
+        if (!viewMatchesTuple(view, returnedData))
+        {
+            cout << "***** [FAIL] Test Case 21 failed: the view of tuple " << i << " doesn't match readTuple() *****" << endl << endl;
+            return -1;
+        }
+    }
+    view.release();
+
+    // So do the views a scan hands out, whatever its projection
+    int threshold = numTuples / 2;
+    vector<string> attributes;
+    attributes.push_back("Salary");
+    RM_ScanIterator rmsi;
+    rc = rm->scan(tableName, "Salary", LT_OP, &threshold, attributes, rmsi);
+    assert(rc == success && "RelationManager::scan() should not fail.");
+    vector<int> seen(numTuples, 0);
+    while (rmsi.getNextTupleView(rid, view) != RM_EOF)
+    {
+        int salary = view.getInt(3);
+        if (salary < 0 || salary >= threshold)
+        {
+            cout << "***** [FAIL] Test Case 21 failed: the scan returned a tuple with salary " << salary << " *****" << endl << endl;
+            return -1;
+        }
+        rc = rm->readTuple(tableName, rids[salary], returnedData);
+        assert(rc == success && "RelationManager::readTuple() should not fail.");
+        if (!viewMatchesTuple(view, returnedData))
+        {
+            cout << "***** [FAIL] Test Case 21 failed: the scanned view of tuple " << salary << " doesn't match readTuple() *****" << endl << endl;
+            return -1;
+        }
+        seen[salary]++;
+    }
+    view.release();
+    rmsi.close();
+    for (int i = 0; i < threshold; i++)
+    {
+        if (seen[i] != 1)
+        {
+            cout << "***** [FAIL] Test Case 21 failed: the scan returned tuple " << i << " " << seen[i] << " times *****" << endl << endl;
+            return -1;
+        }
+    }
+
+    rc = rm->deleteTable(tableName);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+
+    free(tuple);
+    free(returnedData);
+
+    cout << "***** RM Test Case 21 Finished. The result will be examined. *****" << endl << endl;
+    return success;
+}
+
+int main()
+{
+    // Record Views
+    RC rcmain = TEST_RM_21("tbl_employee5");
+
+    return rcmain;
+}
@@ -0,0 +1,156 @@
+#include "rm_test_util.h"
+#include <algorithm>
+
+// Salaries of the tuples satisfying "conditions", found one tuple at a time
+void findMatchingSalaries(const string &tableName, const vector<RID> &rids, const vector<vector<ScanCondition> > &conditions, vector<int> &salaries)
+{
+    vector<Attribute> attrs;
+    RC rc = rm->getAttributes(tableName, attrs);
+    assert(rc == success && "RelationManager::getAttributes() should not fail.");
+
+    void *attribute = malloc(100);
+    for (unsigned i = 0; i < rids.size(); i++)
+    {
+        bool matches = conditions.empty();
+        for (unsigned c = 0; c < conditions.size() && !matches; c++)
+        {
+            matches = true;
+            for (unsigned p = 0; p < conditions[c].size() && matches; p++)
+            {
+                const ScanCondition &condition = conditions[c][p];
+                AttrType type = TypeInt;
+                for (unsigned a = 0; a < attrs.size(); a++)
+                    if (attrs[a].name == condition.attribute)
+                        type = attrs[a].type;
+
+                rc = rm->readAttribute(tableName, rids[i], condition.attribute, attribute);
+                assert(rc == success && "RelationManager::readAttribute() should not fail.");
+                matches = attributeSatisfies(type, attribute, condition.compOp, condition.value);
+            }
+        }
+        if (!matches)
+            continue;
+
+        int salary;
+        rc = rm->readAttribute(tableName, rids[i], "Salary", attribute);
+        assert(rc == success && "RelationManager::readAttribute() should not fail.");
+        memcpy(&salary, (char *) attribute + 1, sizeof(int));
+        salaries.push_back(salary);
+    }
+    free(attribute);
+    sort(salaries.begin(), salaries.end());
+}
+
+RC TEST_RM_22(const string &tableName)
+{
+    // Functions Tested:
+    // 1. Scan with an OR of ANDs of conditions
+    // 2. Read Attribute, to check each scan one tuple at a time
+    cout << endl << "***** In RM Test Case 22 *****" << endl;
+
+    rm->deleteTable(tableName);
+    createTable(tableName);
+
+    int numTuples = 4000;
+    void *tuple = malloc(100);
+    vector<RID> rids;
+    RID rid;
+    RC rc;
+    int size = 0;
+    for (int i = 0; i < numTuples; i++)
+    {
+        prepareIndexedRecord(i, tuple, &size);
+        rc = rm->insertTuple(tableName, tuple, rid);
+        assert(rc == success && "RelationManager::insertTuple() should not fail.");
+        if (i % 17 == 3)
+        {
+            rc = rm->deleteTuple(tableName, rid);
+            assert(rc == success && "RelationManager::deleteTuple() should not fail.");
+            continue;
+        }
+        rids.push_back(rid);
+    }
+
+    int age30 = 30, age40 = 40, age25 = 25;
+    int salary100 = 100, salary3900 = 3900;
+    float height170 = 170.0, height160 = 160.0;
+    char nameValue[20];
+    int nameLength = 4;
+    memcpy(nameValue, &nameLength, sizeof(int));
+    memcpy(nameValue + sizeof(int), "Empm", nameLength);
+
+    vector<vector<vector<ScanCondition> > > tests;
+    vector<vector<ScanCondition> > conditions;
+
+    // 30 <= Age <= 40 OR Salary < 100
+    conditions.push_back(vector<ScanCondition>());
+    conditions.back().push_back(ScanCondition{"Age", GE_OP, &age30});
+    conditions.back().push_back(ScanCondition{"Age", LE_OP, &age40});
+    conditions.push_back(vector<ScanCondition>());
+    conditions.back().push_back(ScanCondition{"Salary", LT_OP, &salary100});
+    tests.push_back(conditions);
+
+    // (Height > 170 AND EmpName < "Empm") OR (Age = 25 AND Height != 160) OR Salary >= 3900
+    conditions.clear();
+    conditions.push_back(vector<ScanCondition>());
+    conditions.back().push_back(ScanCondition{"Height", GT_OP, &height170});
+    conditions.back().push_back(ScanCondition{"EmpName", LT_OP, nameValue});
+    conditions.push_back(vector<ScanCondition>());
+    conditions.back().push_back(ScanCondition{"Age", EQ_OP, &age25});
+    conditions.back().push_back(ScanCondition{"Height", NE_OP, &height160});
+    conditions.push_back(vector<ScanCondition>());
+    conditions.back().push_back(ScanCondition{"Salary", GE_OP, &salary3900});
+    tests.push_back(conditions);
+
+    // Age < 30 AND Age > 40, which nothing satisfies
+    conditions.clear();
+    conditions.push_back(vector<ScanCondition>());
+    conditions.back().push_back(ScanCondition{"Age", LT_OP, &age30});
+    conditions.back().push_back(ScanCondition{"Age", GT_OP, &age40});
+    tests.push_back(conditions);
+
+    // No conditions at all, which every tuple satisfies
+    tests.push_back(vector<vector<ScanCondition> >());
+
+    vector<string> attributes;
+    attributes.push_back("Salary");
+    for (unsigned t = 0; t < tests.size(); t++)
+    {
+        vector<int> expected;
+        findMatchingSalaries(tableName, rids, tests[t], expected);
+
+        vector<int> scanned;
+        RM_ScanIterator rmsi;
+        rc = rm->scan(tableName, tests[t], attributes, rmsi);
+        assert(rc == success && "RelationManager::scan() should not fail.");
+        while (rmsi.getNextTuple(rid, tuple) != RM_EOF)
+        {
+            int salary;
+            memcpy(&salary, (char *) tuple + 1, sizeof(int));
+            scanned.push_back(salary);
+        }
+        rmsi.close();
+        sort(scanned.begin(), scanned.end());
+
+        if (scanned != expected)
+        {
+            cout << "***** [FAIL] Test Case 22 failed: scan " << t << " returned " << scanned.size() << " tuples instead of " << expected.size() << " *****" << endl << endl;
+            return -1;
+        }
+    }
+
+    rc = rm->deleteTable(tableName);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+    free(tuple);
+
+    cout << "***** RM Test Case 22 Finished. The result will be examined. *****" << endl << endl;
+    return success;
+}
+
+int main()
+{
+    // Scan with an OR of ANDs
+    RC rcmain = TEST_RM_22("tbl_employee5");
+
+    return rcmain;
+}
@@ -0,0 +1,134 @@
+#include "rm_test_util.h"
+
+// Rebuilds row "row" of the batch in the format of RM_ScanIterator::getNextTuple()
+int prepareTupleFromBatch(const RecordBatch &batch, unsigned row, void *data)
+{
+    unsigned numColumns = batch.getNumberOfColumns();
+    int nullBytes = getActualByteForNullsIndicator(numColumns);
+    memset(data, 0, nullBytes);
+    int offset = nullBytes;
+
+    for (unsigned c = 0; c < numColumns; c++)
+    {
+        if (batch.isNull(c, row))
+        {
+            ((unsigned char *) data)[c / CHAR_BIT] |= 1 << (7 - c % CHAR_BIT);
+            continue;
+        }
+        switch (batch.getColumnType(c))
+        {
+            case TypeInt:
+                memcpy((char *) data + offset, batch.getInts(c) + row, sizeof(int32_t));
+                offset += sizeof(int32_t);
+                break;
+            case TypeReal:
+                memcpy((char *) data + offset, batch.getReals(c) + row, sizeof(float));
+                offset += sizeof(float);
+                break;
+            case TypeVarChar:
+            {
+                const uint32_t *offsets = batch.getVarCharOffsets(c);
+                int length = offsets[row + 1] - offsets[row];
+                memcpy((char *) data + offset, &length, sizeof(int));
+                memcpy((char *) data + offset + sizeof(int), batch.getVarCharBytes(c) + offsets[row], length);
+                offset += sizeof(int) + length;
+                break;
+            }
+        }
+    }
+    return offset;
+}
+
+RC TEST_RM_23(const string &tableName)
+{
+    // Functions Tested:
+    // 1. Scan, a batch at a time
+    // 2. Scan, a tuple at a time, to check the batches against
+    cout << endl << "***** In RM Test Case 23 *****" << endl;
+
+    rm->deleteTable(tableName);
+    createTable(tableName);
+
+    int numTuples = 5000;
+    void *tuple = malloc(100);
+    void *batchTuple = malloc(100);
+    RID rid;
+    RC rc;
+    int size = 0;
+    for (int i = 0; i < numTuples; i++)
+    {
+        prepareIndexedRecord(i, tuple, &size);
+        rc = rm->insertTuple(tableName, tuple, rid);
+        assert(rc == success && "RelationManager::insertTuple() should not fail.");
+        if (i % 10 == 9)
+        {
+            rc = rm->deleteTuple(tableName, rid);
+            assert(rc == success && "RelationManager::deleteTuple() should not fail.");
+        }
+    }
+
+    // Projected out of order, with a varchar and a real that are sometimes null
+    vector<string> attributes;
+    attributes.push_back("Salary");
+    attributes.push_back("EmpName");
+    attributes.push_back("Height");
+    int age = 30;
+
+    unsigned batchSizes[] = {1, 100, RBFM_BATCH_SIZE};
+    for (unsigned b = 0; b < sizeof(batchSizes) / sizeof(batchSizes[0]); b++)
+    {
+        RM_ScanIterator rmsi;
+        RM_ScanIterator batchIterator;
+        rc = rm->scan(tableName, "Age", GE_OP, &age, attributes, rmsi);
+        assert(rc == success && "RelationManager::scan() should not fail.");
+        rc = rm->scan(tableName, "Age", GE_OP, &age, attributes, batchIterator);
+        assert(rc == success && "RelationManager::scan() should not fail.");
+
+        RecordBatch batch;
+        int count = 0;
+        while (batchIterator.getNextBatch(batch, batchSizes[b]) != RM_EOF)
+        {
+            if (batch.getNumberOfRows() == 0 || batch.getNumberOfRows() > batchSizes[b] || batch.getNumberOfColumns() != attributes.size())
+            {
+                cout << "***** [FAIL] Test Case 23 failed: a batch holds " << batch.getNumberOfRows() << " rows *****" << endl << endl;
+                return -1;
+            }
+
+            for (unsigned row = 0; row < batch.getNumberOfRows(); row++, count++)
+            {
+                // The batch returns the tuples the tuple at a time scan does, in the same order
+                rc = rmsi.getNextTuple(rid, tuple);
+                int batchSize = prepareTupleFromBatch(batch, row, batchTuple);
+                if (rc != success || rid.pageNum != batch.getRIDs()[row].pageNum || rid.slotNum != batch.getRIDs()[row].slotNum
+                    || memcmp(tuple, batchTuple, batchSize) != 0)
+                {
+                    cout << "***** [FAIL] Test Case 23 failed: row " << count << " of the batch scan differs *****" << endl << endl;
+                    return -1;
+                }
+            }
+        }
+        if (rmsi.getNextTuple(rid, tuple) != RM_EOF || count == 0)
+        {
+            cout << "***** [FAIL] Test Case 23 failed: the batch scan returned " << count << " tuples *****" << endl << endl;
+            return -1;
+        }
+        rmsi.close();
+        batchIterator.close();
+    }
+
+    rc = rm->deleteTable(tableName);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+    free(tuple);
+    free(batchTuple);
+
+    cout << "***** RM Test Case 23 Finished. The result will be examined. *****" << endl << endl;
+    return success;
+}
+
+int main()
+{
+    // Scan a batch at a time
+    RC rcmain = TEST_RM_23("tbl_employee5");
+
+    return rcmain;
+}
@@ -0,0 +1,192 @@
+#include "rm_test_util.h"
+
+// Tuple "index" with its name grown by "growth" bytes
+void prepareGrownTuple(const int index, const int growth, void *buffer, int *tupleSize)
+{
+    unsigned char nullsIndicator = 0;
+    if (index % 7 == 0)
+        nullsIndicator |= 1 << 5;
+
+    string name = string("Emp") + string(index % 23, (char) ('a' + index % 26)) + string(growth, 'g');
+    prepareTuple(4, &nullsIndicator, name.length(), name, 20 + index % 50, 150.0 + (index % 60) / 2.0, index, buffer, tupleSize);
+}
+
+// Checks every tuple still in the table reads back as its latest update, both by its RID
+// and through a scan, and counts the tuples the scan finds in their home slots
+int checkTuples(const string &tableName, const vector<RID> &rids, const vector<int> &growths, int &atHome)
+{
+    void *tuple = malloc(400);
+    void *returnedData = malloc(400);
+    int size = 0;
+    RC rc;
+    for (unsigned i = 0; i < rids.size(); i++)
+    {
+        if (growths[i] < 0)
+            continue;
+        rc = rm->readTuple(tableName, rids[i], returnedData);
+        assert(rc == success && "RelationManager::readTuple() should not fail.");
+        prepareGrownTuple(i, growths[i], tuple, &size);
+        if (memcmp(tuple, returnedData, size) != 0)
+        {
+            cout << "Tuple " << i << " doesn't read back as updated." << endl;
+            return -1;
+        }
+    }
+
+    vector<string> attributes;
+    attributes.push_back("EmpName");
+    attributes.push_back("Age");
+    attributes.push_back("Height");
+    attributes.push_back("Salary");
+    RM_ScanIterator rmsi;
+    rc = rm->scan(tableName, "", NO_OP, NULL, attributes, rmsi);
+    assert(rc == success && "RelationManager::scan() should not fail.");
+
+    vector<int> seen(rids.size(), 0);
+    RID rid;
+    atHome = 0;
+    while (rmsi.getNextTuple(rid, returnedData) != RM_EOF)
+    {
+        // Salary follows the name, the age and the height unless it is null
+        int nameLength, salary;
+        memcpy(&nameLength, (char *) returnedData + 1, sizeof(int));
+        int offset = 1 + sizeof(int) + nameLength + sizeof(int);
+        if (!(((unsigned char *) returnedData)[0] & (1 << 5)))
+            offset += sizeof(float);
+        memcpy(&salary, (char *) returnedData + offset, sizeof(int));
+        if (salary < 0 || salary >= (int) rids.size() || growths[salary] < 0 || seen[salary]++)
+        {
+            cout << "The scan returned tuple " << salary << " unexpectedly." << endl;
+            return -1;
+        }
+        prepareGrownTuple(salary, growths[salary], tuple, &size);
+        if (memcmp(tuple, returnedData, size) != 0)
+        {
+            cout << "The scan returned tuple " << salary << " not as updated." << endl;
+            return -1;
+        }
+        if (rid.pageNum == rids[salary].pageNum && rid.slotNum == rids[salary].slotNum)
+            atHome++;
+    }
+    rmsi.close();
+
+    for (unsigned i = 0; i < rids.size(); i++)
+    {
+        if (growths[i] >= 0 && !seen[i])
+        {
+            cout << "The scan missed tuple " << i << "." << endl;
+            return -1;
+        }
+    }
+
+    free(tuple);
+    free(returnedData);
+    return 0;
+}
+
+RC TEST_RM_24(const string &tableName)
+{
+    // Functions Tested:
+    // 1. Insert, Update and Delete Tuples, forwarding tuples that grow
+    // 2. De-forward Tuples
+    // 3. Read Tuple and Scan, before and after
+    cout << endl << "***** In RM Test Case 24 *****" << endl;
+
+    rm->deleteTable(tableName);
+    createTable(tableName);
+
+    int numTuples = 3000;
+    void *tuple = malloc(400);
+    vector<RID> rids;
+    vector<int> growths(numTuples, 0);         // -1 once a tuple is deleted
+    RID rid;
+    RC rc;
+    int size = 0;
+    for (int i = 0; i < numTuples; i++)
+    {
+        prepareGrownTuple(i, 0, tuple, &size);
+        rc = rm->insertTuple(tableName, tuple, rid);
+        assert(rc == success && "RelationManager::insertTuple() should not fail.");
+        rids.push_back(rid);
+    }
+
+    // Grow a third of the tuples out of their pages, then shrink some of them back and
+    // move others on again, and delete tuples to make room on the home pages
+    for (int round = 0; round < 2; round++)
+    {
+        for (int i = 0; i < numTuples; i += 3)
+        {
+            growths[i] = round == 0 ? 150 : (i % 6 == 0 ? 0 : 250);
+            prepareGrownTuple(i, growths[i], tuple, &size);
+            rc = rm->updateTuple(tableName, tuple, rids[i]);
+            assert(rc == success && "RelationManager::updateTuple() should not fail.");
+        }
+    }
+    for (int i = 1; i < numTuples; i += 4)
+    {
+        if (i % 3 == 0)
+            continue;
+        rc = rm->deleteTuple(tableName, rids[i]);
+        assert(rc == success && "RelationManager::deleteTuple() should not fail.");
+        growths[i] = -1;
+    }
+
+    int atHomeBefore, atHomeAfter;
+    if (checkTuples(tableName, rids, growths, atHomeBefore) != 0)
+    {
+        cout << "***** [FAIL] Test Case 24 failed before de-forwarding *****" << endl << endl;
+        return -1;
+    }
+
+    // A few pages at a time, until the whole table is gone through
+    PageNum pageNum = 0;
+    bool done = false;
+    int calls = 0;
+    while (!done)
+    {
+        rc = rm->deforwardTuples(tableName, pageNum, 4, done);
+        assert(rc == success && "RelationManager::deforwardTuples() should not fail.");
+        calls++;
+    }
+
+    if (checkTuples(tableName, rids, growths, atHomeAfter) != 0)
+    {
+        cout << "***** [FAIL] Test Case 24 failed after de-forwarding *****" << endl << endl;
+        return -1;
+    }
+    cout << "Tuples in their home slots: " << atHomeBefore << " before and " << atHomeAfter << " after " << calls << " calls." << endl;
+    if (atHomeAfter <= atHomeBefore)
+    {
+        cout << "***** [FAIL] Test Case 24 failed: no tuple was moved back home *****" << endl << endl;
+        return -1;
+    }
+
+    // De-forwarded tuples can be updated and forwarded again
+    for (int i = 0; i < numTuples; i += 3)
+    {
+        growths[i] = 200 - growths[i] / 2;
+        prepareGrownTuple(i, growths[i], tuple, &size);
+        rc = rm->updateTuple(tableName, tuple, rids[i]);
+        assert(rc == success && "RelationManager::updateTuple() should not fail.");
+    }
+    if (checkTuples(tableName, rids, growths, atHomeAfter) != 0)
+    {
+        cout << "***** [FAIL] Test Case 24 failed updating de-forwarded tuples *****" << endl << endl;
+        return -1;
+    }
+
+    rc = rm->deleteTable(tableName);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+    free(tuple);
+
+    cout << "***** RM Test Case 24 Finished. The result will be examined. *****" << endl << endl;
+    return success;
+}
+
+int main()
+{
+    // De-forward Tuples
+    RC rcmain = TEST_RM_24("tbl_employee5");
+
+    return rcmain;
+}